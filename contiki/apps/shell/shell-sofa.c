@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         SOFA MAC statistics commands of the Contiki shell
+ * \author
+ *         agent <agent@local>
+ */
+
+#include "shell.h"
+#include "net/mac/sofamac.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*---------------------------------------------------------------------------*/
+PROCESS(shell_sofastats_process, "sofastats");
+SHELL_COMMAND(sofastats_command,
+	      "sofastats",
+	      "sofastats [reset]: print the SOFA MAC statistics, reset clears them",
+	      &shell_sofastats_process);
+/*---------------------------------------------------------------------------*/
+#if SOFAMAC_STATS
+static void
+print_histogram(const char *name, const unsigned long *histogram)
+{
+  char buf[120];
+  int i, len;
+
+  len = snprintf(buf, sizeof(buf), "%s", name);
+  for(i = 0; i < SOFA_STATS_BINS && len < sizeof(buf); i++) {
+    len += snprintf(buf + len, sizeof(buf) - len, " %lu", histogram[i]);
+  }
+  shell_output_str(&sofastats_command, buf, "");
+}
+#endif /* SOFAMAC_STATS */
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_sofastats_process, ev, data)
+{
+#if SOFAMAC_STATS
+  char buf[100];
+  struct sofamac_stats *s = &sofamac_stats;
+#endif /* SOFAMAC_STATS */
+
+  PROCESS_BEGIN();
+
+#if SOFAMAC_STATS
+  if(data != NULL && strcmp(data, "reset") == 0) {
+    sofamac_stats_reset();
+    shell_output_str(&sofastats_command, "sofastats: cleared", "");
+    PROCESS_EXIT();
+  }
+
+  snprintf(buf, sizeof(buf), "exchanges %lu ok %lu noack %lu busy %lu error %lu queue full %lu",
+	   s->exchanges, s->success, s->noack, s->busy, s->error, s->queue_full);
+  shell_output_str(&sofastats_command, buf, "");
+  snprintf(buf, sizeof(buf), "strobes %lu (%lu per exchange) collisions %lu backoff aborts %lu",
+	   s->strobes, s->exchanges ? s->strobes / s->exchanges : 0,
+	   s->collisions, s->backoff_aborts);
+  shell_output_str(&sofastats_command, buf, "");
+  snprintf(buf, sizeof(buf), "responders %lu (%lu per exchange)",
+	   s->responders, s->exchanges ? s->responders / s->exchanges : 0);
+  shell_output_str(&sofastats_command, buf, "");
+  snprintf(buf, sizeof(buf), "passive %lu ok %lu error %lu not targeted %lu",
+	   s->passive, s->passive_success, s->passive_error, s->not_targeted);
+  shell_output_str(&sofastats_command, buf, "");
+  snprintf(buf, sizeof(buf), "radio on ticks idle %lu ack %lu data %lu send %lu",
+	   s->radio_on[idle],
+	   s->radio_on[wait_slave_strobe_ack],
+	   s->radio_on[wait_master_packet] + s->radio_on[wait_slave_packet] +
+	   s->radio_on[wait_master_packacket_ack],
+	   s->radio_on[wait_to_send]);
+  shell_output_str(&sofastats_command, buf, "");
+  print_histogram("ack time (log2 ms)", s->ack_time);
+  print_histogram("latency (log2 ms)", s->latency);
+#else
+  shell_output_str(&sofastats_command,
+		   "sofastats: compiled without SOFAMAC_CONF_STATS", "");
+#endif /* SOFAMAC_STATS */
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+shell_sofa_init(void)
+{
+  shell_register_command(&sofastats_command);
+}
+/*---------------------------------------------------------------------------*/
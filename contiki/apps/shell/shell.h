@@ -404,6 +404,7 @@ struct shell_input {
 #include "shell-run.h"
 #include "shell-sendtest.h"
 #include "shell-sky.h"
+#include "shell-sofa.h"
 #include "shell-tcpsend.h"
 #include "shell-text.h"
 #include "shell-time.h"
@@ -48,7 +48,7 @@
 #define IGNORE_CHAR(c) (c == 0x0d)
 #define END 0x0a
 
-static struct ringbuf rxbuf;
+static struct ringbuf_spsc rxbuf;
 static uint8_t rxbuf_data[BUFSIZE];
 
 PROCESS(serial_line_process, "Serial driver");
@@ -67,21 +67,25 @@ serial_line_input_byte(unsigned char c)
 
   if(!overflow) {
     /* Add character */
-    if(ringbuf_put(&rxbuf, c) == 0) {
+    if(ringbuf_spsc_put(&rxbuf, c) == 0) {
       /* Buffer overflow: ignore the rest of the line */
       overflow = 1;
     }
   } else {
     /* Buffer overflowed:
      * Only (try to) add terminator characters, otherwise skip */
-    if(c == END && ringbuf_put(&rxbuf, c) != 0) {
+    if(c == END && ringbuf_spsc_put(&rxbuf, c) != 0) {
       overflow = 0;
     }
   }
 
-  /* Wake up consumer process */
-  process_poll(&serial_line_process);
-  return 1;
+  /* Wake up the consumer process when a line is complete, or early
+     enough for it to make room for a long one. */
+  if(c == END || ringbuf_spsc_elements(&rxbuf) >= BUFSIZE / 2) {
+    process_poll(&serial_line_process);
+    return 1;
+  }
+  return 0;
 }
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(serial_line_process, ev, data)
@@ -96,32 +100,42 @@ PROCESS_THREAD(serial_line_process, ev, data)
 
   while(1) {
     /* Fill application buffer until newline or empty */
-    int c = ringbuf_get(&rxbuf);
-    
-    if(c == -1) {
+    uint8_t *start = (uint8_t *)&buf[ptr];
+    uint8_t *end;
+    int len;
+
+    if(ptr < BUFSIZE - 1) {
+      /* Copy as much as fits, then keep what belongs to this line */
+      len = ringbuf_spsc_peek_bulk(&rxbuf, start, BUFSIZE - 1 - ptr);
+      end = memchr(start, END, len);
+      if(end != NULL) {
+        len = end - start + 1;
+      }
+      ringbuf_spsc_get_bulk(&rxbuf, NULL, len);
+      ptr += len;
+    } else {
+      /* Ignore characters (wait for EOL) */
+      int c = ringbuf_spsc_get(&rxbuf);
+      len = c != -1;
+      end = c == END ? (uint8_t *)&buf[ptr] : NULL;
+    }
+
+    if(len == 0) {
       /* Buffer empty, wait for poll */
       PROCESS_YIELD();
-    } else {
-      if(c != END) {
-        if(ptr < BUFSIZE-1) {
-          buf[ptr++] = (uint8_t)c;
-        } else {
-          /* Ignore character (wait for EOL) */
-        }
-      } else {
-        /* Terminate */
-        buf[ptr++] = (uint8_t)'\0';
-
-        /* Broadcast event */
-        process_post(PROCESS_BROADCAST, serial_line_event_message, buf);
-
-        /* Wait until all processes have handled the serial line event */
-        if(PROCESS_ERR_OK ==
-          process_post(PROCESS_CURRENT(), PROCESS_EVENT_CONTINUE, NULL)) {
-          PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE);
-        }
-        ptr = 0;
+    } else if(end != NULL) {
+      /* Terminate */
+      *end = (uint8_t)'\0';
+
+      /* Broadcast event */
+      process_post(PROCESS_BROADCAST, serial_line_event_message, buf);
+
+      /* Wait until all processes have handled the serial line event */
+      if(PROCESS_ERR_OK ==
+        process_post(PROCESS_CURRENT(), PROCESS_EVENT_CONTINUE, NULL)) {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE);
       }
+      ptr = 0;
     }
   }
 
@@ -131,7 +145,7 @@ PROCESS_THREAD(serial_line_process, ev, data)
 void
 serial_line_init(void)
 {
-  ringbuf_init(&rxbuf, rxbuf_data, sizeof(rxbuf_data));
+  ringbuf_spsc_init(&rxbuf, rxbuf_data, sizeof(rxbuf_data));
   process_start(&serial_line_process, NULL);
 }
 /*---------------------------------------------------------------------------*/
@@ -42,6 +42,7 @@
 #define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
 
 #include "dev/slip.h"
+#include "lib/ringbuf.h"
 
 #define SLIP_END     0300
 #define SLIP_ESC     0333
@@ -62,28 +63,42 @@ uint16_t slip_rubbish, slip_twopackets, slip_overflow, slip_ip_drop;
 /* Must be at least one byte larger than UIP_BUFSIZE! */
 #define RX_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN + 16)
 
+/* The receive ring holds the bytes as they arrive on the line, it
+   must be a power of two and should fit at least one packet. */
+#ifdef SLIP_CONF_RX_RINGSIZE
+#define RX_RINGSIZE SLIP_CONF_RX_RINGSIZE
+#elif RX_BUFSIZE <= 128
+#define RX_RINGSIZE 128
+#elif RX_BUFSIZE <= 256
+#define RX_RINGSIZE 256
+#elif RX_BUFSIZE <= 512
+#define RX_RINGSIZE 512
+#elif RX_BUFSIZE <= 1024
+#define RX_RINGSIZE 1024
+#else
+#define RX_RINGSIZE 2048
+#endif
+
 enum {
-  STATE_TWOPACKETS = 0,	/* We have 2 packets and drop incoming data. */
-  STATE_OK = 1,
-  STATE_ESC = 2,
-  STATE_RUBBISH = 3,
+  STATE_OFF = 0,	/* Not initialized, incoming data is dropped. */
+  STATE_START = 1,	/* Waiting for the first byte of a packet. */
+  STATE_FRAME = 2,
+  STATE_DROP = 3,	/* rxbuf was full, drop until SLIP_END. */
 };
 
 /*
- * Variables begin and end manage the buffer space in a cyclic
- * fashion. The first used byte is at begin and end is one byte past
- * the last. I.e. [begin, end) is the actively used space.
- *
- * If begin != pkt_end we have a packet at [begin, pkt_end),
- * furthermore, if state == STATE_TWOPACKETS we have one more packet at
- * [pkt_end, end). If more bytes arrive in state STATE_TWOPACKETS
- * they are discarded.
+ * slip_input_byte() only puts the raw bytes into rxbuf and counts the
+ * SLIP_END that close a packet in frames_in, the process takes whole
+ * packets out of it with a few memcpy() and decodes them. A packet
+ * that does not fit is closed with the invalid escape SLIP_ESC
+ * SLIP_END, for which two bytes of rxbuf are always kept free.
  */
 
-static uint8_t state = STATE_TWOPACKETS;
-static uint16_t begin, end;
-static uint8_t rxbuf[RX_BUFSIZE];
-static uint16_t pkt_end;		/* SLIP_END tracker. */
+static uint8_t state = STATE_OFF;
+static struct ringbuf_spsc rxbuf;
+static uint8_t rxbuf_data[RX_RINGSIZE];
+static volatile uint8_t frames_in, frames_out;
+static uint8_t first;		/* First byte of the current packet. */
 
 static void (* input_callback)(void) = NULL;
 /*---------------------------------------------------------------------------*/
@@ -155,92 +170,111 @@ slip_write(const void *_ptr, int len)
 static void
 rxbuf_init(void)
 {
-  begin = end = pkt_end = 0;
-  state = STATE_OK;
+  ringbuf_spsc_init(&rxbuf, rxbuf_data, sizeof(rxbuf_data));
+  frames_in = frames_out = 0;
+  state = STATE_START;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Take the next packet out of rxbuf a chunk at a time, up to its
+ * SLIP_END, and undo the escaping in place. Once a packet is known to
+ * be bad, the rest of it goes over the start of outbuf just to find
+ * its end.
+ */
+static uint16_t
+read_frame(uint8_t *outbuf, uint16_t blen)
+{
+  uint16_t len = 0;
+  uint8_t *raw, *raw_end, *end;
+  ringbuf_index_t n;
+  uint8_t esc = 0, bad = 0;
+
+  do {
+    if(len == blen) {
+      /* Full, fine only if the packet ends here. */
+      if(ringbuf_spsc_get(&rxbuf) == SLIP_END) {
+        end = outbuf;
+        break;
+      }
+      bad = 1;
+      len = 0;
+    }
+
+    raw = &outbuf[len];
+    n = ringbuf_spsc_peek_bulk(&rxbuf, raw, blen - len);
+    end = memchr(raw, SLIP_END, n);
+    raw_end = end != NULL ? end : raw + n;
+    ringbuf_spsc_get_bulk(&rxbuf, NULL, raw_end - raw + (end != NULL));
+
+    for(; raw < raw_end; raw++) {
+      if(esc) {
+	esc = 0;
+	if(*raw == SLIP_ESC_END) {
+	  outbuf[len++] = SLIP_END;
+	} else if(*raw == SLIP_ESC_ESC) {
+	  outbuf[len++] = SLIP_ESC;
+	} else {
+	  bad = 1;
+	}
+      } else if(*raw == SLIP_ESC) {
+	esc = 1;
+      } else {
+	outbuf[len++] = *raw;
+      }
+    }
+  } while(end == NULL && n > 0);
+
+  if(bad || esc || end == NULL) {
+    SLIP_STATISTICS(slip_rubbish++);
+    return 0;
+  }
+  return len;
 }
 /*---------------------------------------------------------------------------*/
 /* Upper half does the polling. */
 static uint16_t
 slip_poll_handler(uint8_t *outbuf, uint16_t blen)
 {
-  /* This is a hack and won't work across buffer edge! */
-  if(rxbuf[begin] == 'C') {
+  uint8_t head[6];
+  ringbuf_index_t n;
+  uint16_t len;
+
+  /* This is a hack and only works at the start of a packet! */
+  n = ringbuf_spsc_peek_bulk(&rxbuf, head, sizeof(head));
+  if(n == 6 && memcmp(head, "CLIENT", 6) == 0) {
     int i;
-    if(begin < end && (end - begin) >= 6
-       && memcmp(&rxbuf[begin], "CLIENT", 6) == 0) {
-      state = STATE_TWOPACKETS;	/* Interrupts do nothing. */
-      memset(&rxbuf[begin], 0x0, 6);
-      
-      rxbuf_init();
-      
-      for(i = 0; i < 13; i++) {
-	slip_arch_writeb("CLIENTSERVER\300"[i]);
-      }
-      return 0;
+
+    ringbuf_spsc_get_bulk(&rxbuf, NULL, 6);
+    for(i = 0; i < 13; i++) {
+      slip_arch_writeb("CLIENTSERVER\300"[i]);
     }
+    return 0;
   }
 #ifdef SLIP_CONF_ANSWER_MAC_REQUEST
-  else if(rxbuf[begin] == '?') { 
+  else if(n >= 2 && head[0] == '?' && head[1] == 'M') {
     /* Used by tapslip6 to request mac for auto configure */
-    int i, j;
+    int j;
     char* hexchar = "0123456789abcdef";
-    if(begin < end && (end - begin) >= 2
-       && rxbuf[begin + 1] == 'M') {
-      state = STATE_TWOPACKETS; /* Interrupts do nothing. */
-      rxbuf[begin] = 0;
-      rxbuf[begin + 1] = 0;
-      
-      rxbuf_init();
-      
-      rimeaddr_t addr = get_mac_addr();
-      /* this is just a test so far... just to see if it works */
-      slip_arch_writeb('!');
-      slip_arch_writeb('M');
-      for(j = 0; j < 8; j++) {
-        slip_arch_writeb(hexchar[addr.u8[j] >> 4]);
-        slip_arch_writeb(hexchar[addr.u8[j] & 15]);
-      }
-      slip_arch_writeb(SLIP_END);
-      return 0;
+
+    ringbuf_spsc_get_bulk(&rxbuf, NULL, 2);
+
+    rimeaddr_t addr = get_mac_addr();
+    /* this is just a test so far... just to see if it works */
+    slip_arch_writeb('!');
+    slip_arch_writeb('M');
+    for(j = 0; j < 8; j++) {
+      slip_arch_writeb(hexchar[addr.u8[j] >> 4]);
+      slip_arch_writeb(hexchar[addr.u8[j] & 15]);
     }
+    slip_arch_writeb(SLIP_END);
+    return 0;
   }
 #endif /* SLIP_CONF_ANSWER_MAC_REQUEST */
 
-  /*
-   * Interrupt can not change begin but may change pkt_end.
-   * If pkt_end != begin it will not change again.
-   */
-  if(begin != pkt_end) {
-    uint16_t len;
-
-    if(begin < pkt_end) {
-      len = pkt_end - begin;
-      if(len > blen) {
-	len = 0;
-      } else {
-	memcpy(outbuf, &rxbuf[begin], len);
-      }
-    } else {
-      len = (RX_BUFSIZE - begin) + (pkt_end - 0);
-      if(len > blen) {
-	len = 0;
-      } else {
-	unsigned i;
-	for(i = begin; i < RX_BUFSIZE; i++) {
-	  *outbuf++ = rxbuf[i];
-	}
-	for(i = 0; i < pkt_end; i++) {
-	  *outbuf++ = rxbuf[i];
-	}
-      }
-    }
-
-    /* Remove data from buffer together with the copied packet. */
-    begin = pkt_end;
-    if(state == STATE_TWOPACKETS) {
-      pkt_end = end;
-      state = STATE_OK;		/* Assume no bytes where lost! */
-      
+  if(frames_out != frames_in) {
+    len = read_frame(outbuf, blen);
+    frames_out++;
+    if(frames_out != frames_in) {
       /* One more packet is buffered, need to be polled again! */
       process_poll(&slip_process);
     }
@@ -319,73 +353,58 @@ int
 slip_input_byte(unsigned char c)
 {
   switch(state) {
-  case STATE_RUBBISH:
+  case STATE_OFF:
+    return 0;
+
+  case STATE_DROP:
     if(c == SLIP_END) {
-      state = STATE_OK;
+      state = STATE_START;
     }
     return 0;
-    
-  case STATE_TWOPACKETS:       /* Two packets are already buffered! */
-    return 0;
 
-  case STATE_ESC:
-    if(c == SLIP_ESC_END) {
-      c = SLIP_END;
-    } else if(c == SLIP_ESC_ESC) {
-      c = SLIP_ESC;
-    } else {
-      state = STATE_RUBBISH;
-      SLIP_STATISTICS(slip_rubbish++);
-      end = pkt_end;		/* remove rubbish */
+  case STATE_START:
+    if(c == SLIP_END) {	/* Zero length packet. */
       return 0;
     }
-    state = STATE_OK;
-    break;
-
-  case STATE_OK:
-    if(c == SLIP_ESC) {
-      state = STATE_ESC;
-      return 0;
-    } else if(c == SLIP_END) {
-	/*
-	 * We have a new packet, possibly of zero length.
-	 *
-	 * There may already be one packet buffered.
-	 */
-      if(end != pkt_end) {	/* Non zero length. */
-	if(begin == pkt_end) {	/* None buffered. */
-	  pkt_end = end;
-	} else {
-	  state = STATE_TWOPACKETS;
-	  SLIP_STATISTICS(slip_twopackets++);
-	}
-	process_poll(&slip_process);
-	return 1;
-      }
+    if(ringbuf_spsc_space(&rxbuf) < 3 ||
+       (uint8_t)(frames_in - frames_out) == 0xff) {
+      state = STATE_DROP;
+      SLIP_STATISTICS(slip_overflow++);
       return 0;
     }
+    first = c;
+    state = STATE_FRAME;
     break;
-  }
 
-  /* add_char: */
-  {
-    unsigned next;
-    next = end + 1;
-    if(next == RX_BUFSIZE) {
-      next = 0;
+  case STATE_FRAME:
+    if(c == SLIP_END) {
+      /* There is always room for it. */
+      ringbuf_spsc_put(&rxbuf, c);
+      if(frames_in != frames_out) {
+	SLIP_STATISTICS(slip_twopackets++);
+      }
+      frames_in++;
+      state = STATE_START;
+      process_poll(&slip_process);
+      return 1;
     }
-    if(next == begin) {		/* rxbuf is full */
-      state = STATE_RUBBISH;
+    if(ringbuf_spsc_space(&rxbuf) < 3) {
+      /* rxbuf is full, make the process drop this packet. */
+      ringbuf_spsc_put(&rxbuf, SLIP_ESC);
+      ringbuf_spsc_put(&rxbuf, SLIP_END);
+      frames_in++;
+      state = STATE_DROP;
       SLIP_STATISTICS(slip_overflow++);
-      end = pkt_end;		/* remove rubbish */
-      return 0;
+      process_poll(&slip_process);
+      return 1;
     }
-    rxbuf[end] = c;
-    end = next;
+    break;
   }
 
+  ringbuf_spsc_put(&rxbuf, c);
+
   /* There could be a separate poll routine for this. */
-  if(c == 'T' && rxbuf[begin] == 'C') {
+  if(c == 'T' && first == 'C') {
     process_poll(&slip_process);
     return 1;
   }
@@ -47,17 +47,62 @@
 #include "contiki.h"
 #include "lib/memb.h"
 
+#if MEMB_FREELIST
+/*---------------------------------------------------------------------------*/
+static void
+build_freelist(struct memb *m)
+{
+  int i;
+
+  /* Link the blocks in address order, so that a fresh block hands them
+     out in the same order as the scanning allocator */
+  m->free = m->num;
+  for(i = m->num - 1; i >= 0; --i) {
+    if(m->count[i] == 0) {
+      m->next[i] = m->free;
+      m->free = i;
+    }
+  }
+  m->ready = 1;
+}
+#endif /* MEMB_FREELIST */
 /*---------------------------------------------------------------------------*/
 void
 memb_init(struct memb *m)
 {
   memset(m->count, 0, m->num);
   memset(m->mem, 0, m->size * m->num);
+#if MEMB_FREELIST
+  build_freelist(m);
+#endif /* MEMB_FREELIST */
+#if MEMB_STATS
+  m->used = m->max_used = m->failed = 0;
+#endif /* MEMB_STATS */
 }
 /*---------------------------------------------------------------------------*/
 void *
 memb_alloc(struct memb *m)
 {
+#if MEMB_FREELIST
+  unsigned short i;
+
+  /* Blocks may be used without memb_init(), they start out free */
+  if(!m->ready) {
+    build_freelist(m);
+  }
+
+  i = m->free;
+  if(i < m->num) {
+    m->free = m->next[i];
+    m->count[i] = 1;
+#if MEMB_STATS
+    if(++m->used > m->max_used) {
+      m->max_used = m->used;
+    }
+#endif /* MEMB_STATS */
+    return (void *)((char *)m->mem + (i * m->size));
+  }
+#else /* MEMB_FREELIST */
   int i;
 
   for(i = 0; i < m->num; ++i) {
@@ -66,18 +111,55 @@ memb_alloc(struct memb *m)
 	 indicate that it now is used and return a pointer to the
 	 memory block. */
       ++(m->count[i]);
+#if MEMB_STATS
+      if(++m->used > m->max_used) {
+        m->max_used = m->used;
+      }
+#endif /* MEMB_STATS */
       return (void *)((char *)m->mem + (i * m->size));
     }
   }
+#endif /* MEMB_FREELIST */
 
   /* No free block was found, so we return NULL to indicate failure to
      allocate block. */
+#if MEMB_STATS
+  m->failed++;
+#endif /* MEMB_STATS */
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
 char
 memb_free(struct memb *m, void *ptr)
 {
+#if MEMB_FREELIST
+  unsigned long offset;
+  int i;
+
+  if(!memb_inmemb(m, ptr)) {
+    return -1;
+  }
+
+  /* The block's index follows from its offset, which must be a whole
+     number of blocks */
+  offset = (char *)ptr - (char *)m->mem;
+  i = offset / m->size;
+  if((unsigned long)i * m->size != offset) {
+    return -1;
+  }
+
+  /* Make sure that we don't deallocate free memory. */
+  if(m->count[i] > 0) {
+    if(--(m->count[i]) == 0) {
+      m->next[i] = m->free;
+      m->free = i;
+#if MEMB_STATS
+      m->used--;
+#endif /* MEMB_STATS */
+    }
+  }
+  return m->count[i];
+#else /* MEMB_FREELIST */
   int i;
   char *ptr2;
 
@@ -92,12 +174,18 @@ memb_free(struct memb *m, void *ptr)
       if(m->count[i] > 0) {
 	/* Make sure that we don't deallocate free memory. */
 	--(m->count[i]);
+#if MEMB_STATS
+        if(m->count[i] == 0) {
+          m->used--;
+        }
+#endif /* MEMB_STATS */
       }
       return m->count[i];
     }
     ptr2 += m->size;
   }
   return -1;
+#endif /* MEMB_FREELIST */
 }
 /*---------------------------------------------------------------------------*/
 int
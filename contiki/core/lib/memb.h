@@ -65,6 +65,35 @@
 
 #include "sys/cc.h"
 
+/**
+ * \brief Keep the free blocks in a list
+ *
+ * With MEMB_CONF_FREELIST, the free blocks are chained through an
+ * array of block indices kept next to the blocks, so that memb_alloc()
+ * and memb_free() take constant time instead of walking the whole
+ * block. The blocks themselves are left untouched: code that still
+ * reads a block right after freeing it, such as a list_remove() that
+ * follows the memb_free(), keeps working.
+ */
+#ifdef MEMB_CONF_FREELIST
+#define MEMB_FREELIST MEMB_CONF_FREELIST
+#else
+#define MEMB_FREELIST 0
+#endif
+
+/**
+ * \brief Count the blocks in use and the failed allocations
+ *
+ * With MEMB_CONF_STATS, struct memb keeps the number of blocks in use,
+ * the largest number ever in use and the number of calls to
+ * memb_alloc() that found no free block.
+ */
+#ifdef MEMB_CONF_STATS
+#define MEMB_STATS MEMB_CONF_STATS
+#else
+#define MEMB_STATS 0
+#endif
+
 /**
  * Declare a memory block.
  *
@@ -86,18 +115,43 @@ MEMB(connections, struct connection, 16);
  * \param num The total number of memory chunks in the block.
  *
  */
+#if MEMB_FREELIST
+#define MEMB(name, structure, num) \
+        static char CC_CONCAT(name,_memb_count)[num]; \
+        static structure CC_CONCAT(name,_memb_mem)[num]; \
+        static unsigned short CC_CONCAT(name,_memb_next)[num]; \
+        static struct memb name = {sizeof(structure), num, \
+                                          CC_CONCAT(name,_memb_count), \
+                                          (void *)CC_CONCAT(name,_memb_mem), \
+                                          CC_CONCAT(name,_memb_next)}
+#else /* MEMB_FREELIST */
 #define MEMB(name, structure, num) \
         static char CC_CONCAT(name,_memb_count)[num]; \
         static structure CC_CONCAT(name,_memb_mem)[num]; \
         static struct memb name = {sizeof(structure), num, \
                                           CC_CONCAT(name,_memb_count), \
                                           (void *)CC_CONCAT(name,_memb_mem)}
+#endif /* MEMB_FREELIST */
 
 struct memb {
   unsigned short size;
   unsigned short num;
   char *count;
   void *mem;
+#if MEMB_FREELIST
+  /* The index of the free block that follows each free block */
+  unsigned short *next;
+  /* The index of the first free block, num when none is left */
+  unsigned short free;
+  /* Set once the free list has been built */
+  unsigned char ready;
+#endif /* MEMB_FREELIST */
+#if MEMB_STATS
+  /* Blocks in use, the largest number ever in use and failed allocations */
+  unsigned short used;
+  unsigned short max_used;
+  unsigned short failed;
+#endif /* MEMB_STATS */
 };
 
 /**
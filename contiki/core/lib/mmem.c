@@ -55,10 +55,184 @@
 #define MMEM_SIZE 4096
 #endif
 
-LIST(mmemlist);
+#ifdef MMEM_CONF_FREELIST
+#define MMEM_FREELIST MMEM_CONF_FREELIST
+#else
+#define MMEM_FREELIST 0
+#endif
+
+/* Bytes moved by each compaction step taken when the system is idle */
+#ifdef MMEM_CONF_COMPACT_STEP
+#define MMEM_COMPACT_STEP MMEM_CONF_COMPACT_STEP
+#else
+#define MMEM_COMPACT_STEP 1024
+#endif
+
+#if MMEM_FREELIST
+#include <limits.h>
+#include "sys/process.h"
+#endif /* MMEM_FREELIST */
+
 unsigned int avail_memory;
+static unsigned long moved, failed;
+
+#if MMEM_FREELIST
+/*
+ * The memory is a sequence of chunks, each starting with a header that
+ * tells its size and that of the chunk before it, so that a freed chunk
+ * can be merged with both neighbors. A chunk that ends the memory and
+ * is never free keeps the last real chunk from merging past the end.
+ *
+ * Free chunks are never adjacent. They are linked in lists by size,
+ * list i holding the chunks of 2^i to 2^(i+1)-1 bytes.
+ */
+struct chunk {
+  unsigned int size;
+  unsigned int prev_size;
+  /* The allocation living in the chunk, NULL when the chunk is free */
+  struct mmem *owner;
+};
+
+struct free_chunk {
+  struct chunk c;
+  struct free_chunk *next, *prev;
+};
+
+#define ALIGN(n)   (((n) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+#define HDR        ALIGN(sizeof(struct chunk))
+#define MIN_CHUNK  ALIGN(sizeof(struct free_chunk))
+#define CLASSES    (sizeof(unsigned int) * CHAR_BIT)
+
+#define NEXT(c)    ((struct chunk *)((char *)(c) + (c)->size))
+#define PREV(c)    ((struct chunk *)((char *)(c) - (c)->prev_size))
+
+static union {
+  char bytes[MMEM_SIZE];
+  void *align;
+} memory;
+static struct chunk *end;
+
+static struct free_chunk *classes[CLASSES];
+static unsigned int holes, blocks;
+
+/* All chunks below the cursor are allocated */
+static struct chunk *cursor;
+
+static unsigned char compacting;
+PROCESS(mmem_process, "Managed memory");
+#else /* MMEM_FREELIST */
+LIST(mmemlist);
 static char memory[MMEM_SIZE];
+#endif /* MMEM_FREELIST */
+
+#if MMEM_FREELIST
+/*---------------------------------------------------------------------------*/
+static int
+class_of(unsigned int size)
+{
+  int i;
+
+  for(i = 0; size > 1; i++) {
+    size >>= 1;
+  }
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+static void
+chunk_insert(struct chunk *c)
+{
+  struct free_chunk *f = (struct free_chunk *)c;
+  int i = class_of(c->size);
+
+  c->owner = NULL;
+  f->prev = NULL;
+  f->next = classes[i];
+  if(f->next != NULL) {
+    f->next->prev = f;
+  }
+  classes[i] = f;
+  holes++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+chunk_unlink(struct chunk *c)
+{
+  struct free_chunk *f = (struct free_chunk *)c;
+
+  if(f->prev != NULL) {
+    f->prev->next = f->next;
+  } else {
+    classes[class_of(c->size)] = f->next;
+  }
+  if(f->next != NULL) {
+    f->next->prev = f->prev;
+  }
+  holes--;
+}
+/*---------------------------------------------------------------------------*/
+static struct chunk *
+find(unsigned int size)
+{
+  struct free_chunk *f;
+  int i;
+
+  /* The first chunk that fits in the list of its size, otherwise any
+     chunk from the lists of larger ones */
+  i = class_of(size);
+  for(f = classes[i]; f != NULL; f = f->next) {
+    if(f->c.size >= size) {
+      return &f->c;
+    }
+  }
+  for(i++; i < CLASSES; i++) {
+    if(classes[i] != NULL) {
+      return &classes[i]->c;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+fragmented(void)
+{
+  return holes > 1 || (holes == 1 && PREV(end)->owner != NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule_compaction(void)
+{
+  /* A more urgent event may have evicted ours from the queue, which
+     leaves no low priority event pending */
+  if(compacting && process_queue_depth(PROCESS_PRIORITY_LOW) == 0) {
+    compacting = 0;
+  }
+  if(compacting || !fragmented()) {
+    return;
+  }
+  if(!process_is_running(&mmem_process)) {
+    process_start(&mmem_process, NULL);
+  }
+  /* Low priority events are only delivered when nothing else is
+     pending. If the queue is full, the next free tries again. */
+  compacting = process_post_priority(&mmem_process, PROCESS_EVENT_CONTINUE,
+                                     NULL, PROCESS_PRIORITY_LOW) ==
+    PROCESS_ERR_OK;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(mmem_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE);
+    compacting = 0;
+    mmem_compact(MMEM_COMPACT_STEP);
+    schedule_compaction();
+  }
 
+  PROCESS_END();
+}
+#endif /* MMEM_FREELIST */
 /*---------------------------------------------------------------------------*/
 /**
  * \brief      Allocate a managed memory block
@@ -82,8 +256,51 @@ static char memory[MMEM_SIZE];
 int
 mmem_alloc(struct mmem *m, unsigned int size)
 {
+#if MMEM_FREELIST
+  struct chunk *c, *rest;
+  unsigned int need;
+
+  if(size > MMEM_SIZE) {
+    failed++;
+    return 0;
+  }
+  need = ALIGN(size + HDR);
+  if(need < MIN_CHUNK) {
+    need = MIN_CHUNK;
+  }
+
+  c = find(need);
+  if(c == NULL && avail_memory >= need) {
+    /* Enough memory, but in pieces: gather it at the end */
+    mmem_compact(UINT_MAX);
+    c = find(need);
+  }
+  if(c == NULL) {
+    failed++;
+    return 0;
+  }
+  chunk_unlink(c);
+
+  /* Give back what is left, if it makes a chunk of its own */
+  if(c->size - need >= MIN_CHUNK) {
+    rest = (struct chunk *)((char *)c + need);
+    rest->size = c->size - need;
+    rest->prev_size = need;
+    NEXT(rest)->prev_size = rest->size;
+    c->size = need;
+    chunk_insert(rest);
+  }
+
+  c->owner = m;
+  m->ptr = (char *)c + HDR;
+  m->size = size;
+  avail_memory -= c->size;
+  blocks++;
+  return 1;
+#else /* MMEM_FREELIST */
   /* Check if we have enough memory left for this allocation. */
   if(avail_memory < size) {
+    failed++;
     return 0;
   }
 
@@ -104,6 +321,7 @@ mmem_alloc(struct mmem *m, unsigned int size)
   /* Return non-zero to indicate that we were able to allocate
      memory. */
   return 1;
+#endif /* MMEM_FREELIST */
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -118,9 +336,38 @@ mmem_alloc(struct mmem *m, unsigned int size)
 void
 mmem_free(struct mmem *m)
 {
+#if MMEM_FREELIST
+  struct chunk *c, *n;
+
+  c = (struct chunk *)((char *)m->ptr - HDR);
+  avail_memory += c->size;
+  blocks--;
+
+  /* Merge with the free chunks around it */
+  n = NEXT(c);
+  if(n->owner == NULL) {
+    chunk_unlink(n);
+    c->size += n->size;
+  }
+  if(c->prev_size != 0 && PREV(c)->owner == NULL) {
+    n = PREV(c);
+    chunk_unlink(n);
+    n->size += c->size;
+    c = n;
+  }
+  NEXT(c)->prev_size = c->size;
+  chunk_insert(c);
+
+  if(c < cursor) {
+    cursor = c;
+  }
+  schedule_compaction();
+#else /* MMEM_FREELIST */
   struct mmem *n;
 
   if(m->next != NULL) {
+    moved += &memory[MMEM_SIZE - avail_memory] - (char *)m->next->ptr;
+
     /* Compact the memory after the allocation that is to be removed
        by moving it downwards. */
     memmove(m->ptr, m->next->ptr,
@@ -137,6 +384,106 @@ mmem_free(struct mmem *m)
 
   /* Remove the memory block from the list. */
   list_remove(mmemlist, m);
+#endif /* MMEM_FREELIST */
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief      Compact the managed memory
+ * \param max  The number of bytes that may be moved
+ * \return     Non-zero if the memory is still fragmented
+ *
+ *             This function moves allocated blocks down over the
+ *             holes left by mmem_free(), until about max bytes have
+ *             been moved. At least one block is moved, if any needs
+ *             to. It is called when the system is idle, and does
+ *             nothing unless MMEM_CONF_FREELIST is set.
+ *
+ */
+int
+mmem_compact(unsigned int max)
+{
+#if MMEM_FREELIST
+  struct chunk *c, *f, *n;
+  unsigned int done, size, prev_size;
+
+  for(done = 0; cursor != end;) {
+    c = cursor;
+    if(c->owner != NULL) {
+      cursor = NEXT(c);
+      continue;
+    }
+
+    /* A free chunk is followed by an allocated one, or ends the memory */
+    n = NEXT(c);
+    if(n == end) {
+      break;
+    }
+    if(done > 0 && (done >= max || n->size > max - done)) {
+      return 1;
+    }
+
+    /* Swap the two chunks */
+    chunk_unlink(c);
+    size = c->size;
+    prev_size = c->prev_size;
+    memmove(c, n, n->size);
+    c->prev_size = prev_size;
+    c->owner->ptr = (char *)c + HDR;
+
+    f = NEXT(c);
+    f->size = size;
+    f->prev_size = c->size;
+    n = NEXT(f);
+    if(n->owner == NULL) {
+      chunk_unlink(n);
+      f->size += n->size;
+    }
+    NEXT(f)->prev_size = f->size;
+    chunk_insert(f);
+
+    cursor = f;
+    done += c->size;
+    moved += c->size;
+  }
+  return 0;
+#else /* MMEM_FREELIST */
+  return 0;
+#endif /* MMEM_FREELIST */
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief      Get the usage and fragmentation of the managed memory
+ * \param stats The structure to fill in
+ *
+ */
+void
+mmem_stats(struct mmem_stats *stats)
+{
+#if MMEM_FREELIST
+  struct free_chunk *f;
+  int i;
+
+  stats->used = (char *)end - memory.bytes - avail_memory;
+  stats->avail = avail_memory;
+  stats->largest = 0;
+  for(i = CLASSES - 1; i >= 0 && stats->largest == 0; i--) {
+    for(f = classes[i]; f != NULL; f = f->next) {
+      if(f->c.size - HDR > stats->largest) {
+        stats->largest = f->c.size - HDR;
+      }
+    }
+  }
+  stats->blocks = blocks;
+  stats->holes = holes;
+#else /* MMEM_FREELIST */
+  stats->used = MMEM_SIZE - avail_memory;
+  stats->avail = avail_memory;
+  stats->largest = avail_memory;
+  stats->blocks = list_length(mmemlist);
+  stats->holes = avail_memory > 0;
+#endif /* MMEM_FREELIST */
+  stats->moved = moved;
+  stats->failed = failed;
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -151,8 +498,32 @@ mmem_free(struct mmem *m)
 void
 mmem_init(void)
 {
+#if MMEM_FREELIST
+  struct chunk *c;
+  int i;
+
+  for(i = 0; i < CLASSES; i++) {
+    classes[i] = NULL;
+  }
+  holes = blocks = 0;
+
+  /* One free chunk, followed by the end marker */
+  c = (struct chunk *)memory.bytes;
+  end = (struct chunk *)(memory.bytes +
+                         ((MMEM_SIZE - HDR) & ~(sizeof(void *) - 1)));
+  c->size = (char *)end - memory.bytes;
+  c->prev_size = 0;
+  end->size = 0;
+  end->prev_size = c->size;
+  end->owner = (struct mmem *)end;
+  chunk_insert(c);
+  avail_memory = c->size;
+  cursor = c;
+#else /* MMEM_FREELIST */
   list_init(mmemlist);
   avail_memory = MMEM_SIZE;
+#endif /* MMEM_FREELIST */
+  moved = failed = 0;
 }
 /*---------------------------------------------------------------------------*/
 
@@ -44,6 +44,25 @@
  * stays in place. Therefore, a level of indirection is used: access
  * to allocated memory must always be done using a special macro.
  *
+ * With MMEM_CONF_FREELIST, mmem_free() no longer compacts the
+ * memory. Freed blocks are merged with their free neighbors and kept
+ * in lists by size, from which mmem_alloc() takes the blocks it
+ * needs. The memory is compacted a little at a time when the system
+ * is idle, with mmem_compact(), or all at once when an allocation
+ * finds enough free memory but no block large enough.
+ *
+ * Each block then costs more memory than in the default mode: a
+ * header of two sizes and a pointer, the rounding of the block to a
+ * multiple of the pointer size, and at least the size of a free list
+ * entry (the header and two more pointers). The same MMEM_CONF_SIZE
+ * therefore holds fewer blocks, notably when they are small.
+ *
+ * Memory therefore still moves in this mode, only at other times:
+ * any call to mmem_alloc() may move every allocated block, and so may
+ * the compaction that runs from the mmem process whenever the system
+ * is idle. A pointer obtained with MMEM_PTR() is only valid until the
+ * next mmem_alloc() or the next time the calling process yields.
+ *
  * \note This module has not been heavily tested.
  * @{
  */
@@ -80,12 +99,34 @@ struct mmem {
   void *ptr;
 };
 
-/* XXX: tagga minne med "interrupt usage", vilke gr att man r
+/**
+ * \brief Usage and fragmentation of the managed memory
+ *
+ * The memory is fragmented when avail is larger than largest, i.e.
+ * when the free memory is spread over several holes.
+ */
+struct mmem_stats {
+  /* Bytes in allocated blocks, block headers included */
+  unsigned long used;
+  /* Free bytes, and the largest allocation that fits without compacting */
+  unsigned long avail;
+  unsigned long largest;
+  /* Allocated blocks and free holes between them */
+  unsigned int blocks;
+  unsigned int holes;
+  /* Bytes moved by compaction and allocations that failed, so far */
+  unsigned long moved;
+  unsigned long failed;
+};
+
+/* XXX: tagga minne med "interrupt usage", vilke g�r att man �r
    speciellt varsam under free(). */
 
 int  mmem_alloc(struct mmem *m, unsigned int size);
 void mmem_free(struct mmem *);
 void mmem_init(void);
+int  mmem_compact(unsigned int max);
+void mmem_stats(struct mmem_stats *stats);
 
 #endif /* __MMEM_H__ */
 
@@ -38,6 +38,8 @@
  */
 
 #include "lib/ringbuf.h"
+
+#include <string.h>
 /*---------------------------------------------------------------------------*/
 void
 ringbuf_init(struct ringbuf *r, uint8_t *dataptr, uint8_t size)
@@ -104,3 +106,145 @@ ringbuf_elements(struct ringbuf *r)
   return (r->put_ptr - r->get_ptr) & r->mask;
 }
 /*---------------------------------------------------------------------------*/
+
+/* Keeps the compiler from moving the buffer accesses across the index
+   updates that hand the data over to the other side. */
+#ifdef __GNUC__
+#define BARRIER() __asm__ __volatile__("" : : : "memory")
+#else
+#define BARRIER()
+#endif
+/*---------------------------------------------------------------------------*/
+static ringbuf_index_t
+load_index(volatile ringbuf_index_t *index)
+{
+  ringbuf_index_t i;
+
+  /* The other side may update the index between the loads of its
+     bytes. It only moves forward, so two equal reads are consistent. */
+  do {
+    i = *index;
+  } while(sizeof(ringbuf_index_t) > 1 && i != *index);
+  BARRIER();
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+void
+ringbuf_spsc_init(struct ringbuf_spsc *r, uint8_t *dataptr,
+                  ringbuf_index_t size)
+{
+  r->data = dataptr;
+  r->mask = size - 1;
+  r->put_ptr = 0;
+  r->get_ptr = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf_spsc_put(struct ringbuf_spsc *r, uint8_t c)
+{
+  ringbuf_index_t put = r->put_ptr;
+
+  if((ringbuf_index_t)(put - load_index(&r->get_ptr)) > r->mask) {
+    return 0;
+  }
+  r->data[put & r->mask] = c;
+  BARRIER();
+  r->put_ptr = put + 1;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf_spsc_get(struct ringbuf_spsc *r)
+{
+  ringbuf_index_t get = r->get_ptr;
+  uint8_t c;
+
+  if(load_index(&r->put_ptr) == get) {
+    return -1;
+  }
+  c = r->data[get & r->mask];
+  BARRIER();
+  r->get_ptr = get + 1;
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+ringbuf_index_t
+ringbuf_spsc_put_bulk(struct ringbuf_spsc *r, const uint8_t *data,
+                      ringbuf_index_t len)
+{
+  ringbuf_index_t put = r->put_ptr;
+  ringbuf_index_t space, offset, first;
+
+  space = r->mask + 1 - (ringbuf_index_t)(put - load_index(&r->get_ptr));
+  if(len > space) {
+    len = space;
+  }
+  offset = put & r->mask;
+  first = r->mask + 1 - offset;
+  if(first > len) {
+    first = len;
+  }
+  memcpy(&r->data[offset], data, first);
+  memcpy(r->data, data + first, len - first);
+  BARRIER();
+  r->put_ptr = put + len;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static ringbuf_index_t
+copy_out(struct ringbuf_spsc *r, uint8_t *data, ringbuf_index_t len)
+{
+  ringbuf_index_t get = r->get_ptr;
+  ringbuf_index_t elements, offset, first;
+
+  elements = load_index(&r->put_ptr) - get;
+  if(len > elements) {
+    len = elements;
+  }
+  if(data != NULL) {
+    offset = get & r->mask;
+    first = r->mask + 1 - offset;
+    if(first > len) {
+      first = len;
+    }
+    memcpy(data, &r->data[offset], first);
+    memcpy(data + first, r->data, len - first);
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+ringbuf_index_t
+ringbuf_spsc_get_bulk(struct ringbuf_spsc *r, uint8_t *data,
+                      ringbuf_index_t len)
+{
+  len = copy_out(r, data, len);
+  BARRIER();
+  r->get_ptr += len;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+ringbuf_index_t
+ringbuf_spsc_peek_bulk(struct ringbuf_spsc *r, uint8_t *data,
+                       ringbuf_index_t len)
+{
+  return copy_out(r, data, len);
+}
+/*---------------------------------------------------------------------------*/
+ringbuf_index_t
+ringbuf_spsc_size(struct ringbuf_spsc *r)
+{
+  return r->mask + 1;
+}
+/*---------------------------------------------------------------------------*/
+ringbuf_index_t
+ringbuf_spsc_elements(struct ringbuf_spsc *r)
+{
+  return load_index(&r->put_ptr) - load_index(&r->get_ptr);
+}
+/*---------------------------------------------------------------------------*/
+ringbuf_index_t
+ringbuf_spsc_space(struct ringbuf_spsc *r)
+{
+  return r->mask + 1 - ringbuf_spsc_elements(r);
+}
+/*---------------------------------------------------------------------------*/
@@ -128,4 +128,140 @@ int     ringbuf_size(struct ringbuf *r);
  */
 int     ringbuf_elements(struct ringbuf *r);
 
+/*---------------------------------------------------------------------------*/
+
+/**
+ * \brief      Type of the indices of a single-producer/single-consumer ring buffer.
+ *
+ *             The indices are free-running counters, so a struct
+ *             ringbuf_spsc can hold up to half as many bytes as the
+ *             type can count. Platforms that need larger buffers can
+ *             set RINGBUF_CONF_INDEX_TYPE to uint32_t.
+ */
+#ifdef RINGBUF_CONF_INDEX_TYPE
+typedef RINGBUF_CONF_INDEX_TYPE ringbuf_index_t;
+#else
+typedef uint16_t ringbuf_index_t;
+#endif
+
+/**
+ * \brief      Structure that holds the state of a single-producer/single-consumer ring buffer.
+ *
+ *             Unlike a struct ringbuf, this ring buffer moves blocks
+ *             of data with memcpy(), may be larger than 128 bytes and
+ *             holds as many bytes as its size. One side, typically an
+ *             interrupt handler, only puts data into the buffer and
+ *             the other one only gets data from it: each index is
+ *             written by one side only, so no locking is needed. An
+ *             index that is wider than what the CPU can load at once
+ *             is read until two loads agree. This struct is an opaque
+ *             structure with no user-visible elements.
+ */
+struct ringbuf_spsc {
+  uint8_t *data;
+  ringbuf_index_t mask;
+
+  volatile ringbuf_index_t put_ptr, get_ptr;
+};
+
+/**
+ * \brief      Initialize a single-producer/single-consumer ring buffer
+ * \param r    A pointer to a struct ringbuf_spsc to hold the state of the ring buffer
+ * \param a    A pointer to an array to hold the data in the buffer
+ * \param size_power_of_two The size of the ring buffer, which must be a power of two
+ *
+ *             The size of the ring buffer must be a power of two and
+ *             at most half the range of a ringbuf_index_t.
+ *
+ */
+void    ringbuf_spsc_init(struct ringbuf_spsc *r, uint8_t *a,
+                          ringbuf_index_t size_power_of_two);
+
+/**
+ * \brief      Insert a byte into the ring buffer
+ * \param r    A pointer to a struct ringbuf_spsc to hold the state of the ring buffer
+ * \param c    The byte to be written to the buffer
+ * \return     Non-zero if there data could be written, or zero if the buffer was full.
+ *
+ *             Only the producer may call this function.
+ *
+ */
+int     ringbuf_spsc_put(struct ringbuf_spsc *r, uint8_t c);
+
+/**
+ * \brief      Get a byte from the ring buffer
+ * \param r    A pointer to a struct ringbuf_spsc to hold the state of the ring buffer
+ * \return     The data from the buffer, or -1 if the buffer was empty
+ *
+ *             Only the consumer may call this function.
+ *
+ */
+int     ringbuf_spsc_get(struct ringbuf_spsc *r);
+
+/**
+ * \brief      Insert a block of data into the ring buffer
+ * \param r    A pointer to a struct ringbuf_spsc to hold the state of the ring buffer
+ * \param data The data to be written to the buffer
+ * \param len  The number of bytes to write
+ * \return     The number of bytes written, less than len if the buffer got full
+ *
+ *             The data is copied with at most two calls to memcpy()
+ *             and made visible to the consumer at once. Only the
+ *             producer may call this function.
+ *
+ */
+ringbuf_index_t ringbuf_spsc_put_bulk(struct ringbuf_spsc *r,
+                                      const uint8_t *data,
+                                      ringbuf_index_t len);
+
+/**
+ * \brief      Get a block of data from the ring buffer
+ * \param r    A pointer to a struct ringbuf_spsc to hold the state of the ring buffer
+ * \param data The buffer to copy the data to, or NULL to discard it
+ * \param len  The largest number of bytes to get
+ * \return     The number of bytes removed from the ring buffer
+ *
+ *             Only the consumer may call this function.
+ *
+ */
+ringbuf_index_t ringbuf_spsc_get_bulk(struct ringbuf_spsc *r, uint8_t *data,
+                                      ringbuf_index_t len);
+
+/**
+ * \brief      Copy data from the ring buffer without removing it
+ * \param r    A pointer to a struct ringbuf_spsc to hold the state of the ring buffer
+ * \param data The buffer to copy the data to
+ * \param len  The largest number of bytes to copy
+ * \return     The number of bytes copied
+ *
+ *             This lets the consumer look for a delimiter and then
+ *             remove exactly the bytes it used with
+ *             ringbuf_spsc_get_bulk(). Only the consumer may call
+ *             this function.
+ *
+ */
+ringbuf_index_t ringbuf_spsc_peek_bulk(struct ringbuf_spsc *r, uint8_t *data,
+                                       ringbuf_index_t len);
+
+/**
+ * \brief      Get the size of a ring buffer
+ * \param r    A pointer to a struct ringbuf_spsc to hold the state of the ring buffer
+ * \return     The size of the buffer.
+ */
+ringbuf_index_t ringbuf_spsc_size(struct ringbuf_spsc *r);
+
+/**
+ * \brief      Get the number of elements currently in the ring buffer
+ * \param r    A pointer to a struct ringbuf_spsc to hold the state of the ring buffer
+ * \return     The number of elements in the buffer.
+ */
+ringbuf_index_t ringbuf_spsc_elements(struct ringbuf_spsc *r);
+
+/**
+ * \brief      Get the number of bytes that can be inserted into the ring buffer
+ * \param r    A pointer to a struct ringbuf_spsc to hold the state of the ring buffer
+ * \return     The free space in the buffer.
+ */
+ringbuf_index_t ringbuf_spsc_space(struct ringbuf_spsc *r);
+
 #endif /* __RINGBUF_H__ */
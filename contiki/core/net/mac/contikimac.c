@@ -653,6 +653,8 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   packetbuf_compact();
 
 #ifdef NETSTACK_ENCRYPT
+  /* The MAC may still hold the packet for a retransmission */
+  packetbuf_unshare();
   NETSTACK_ENCRYPT();
 #endif /* NETSTACK_ENCRYPT */
 
@@ -83,36 +83,114 @@ struct qbuf_metadata {
   uint8_t max_transmissions;
 };
 
+/* The maximum number of co-existing neighbor queues */
+#ifdef CSMA_CONF_MAX_NEIGHBOR_QUEUES
+#define CSMA_MAX_NEIGHBOR_QUEUES CSMA_CONF_MAX_NEIGHBOR_QUEUES
+#else
+#define CSMA_MAX_NEIGHBOR_QUEUES 2
+#endif /* CSMA_CONF_MAX_NEIGHBOR_QUEUES */
+
+/* The number of hash buckets the neighbor queues are found in, 0
+   searches the list of neighbor queues instead */
+#ifdef CSMA_CONF_NEIGHBOR_HASH
+#define CSMA_NEIGHBOR_HASH CSMA_CONF_NEIGHBOR_HASH
+#else
+#define CSMA_NEIGHBOR_HASH 0
+#endif /* CSMA_CONF_NEIGHBOR_HASH */
+
+#define MAX_QUEUED_PACKETS QUEUEBUF_NUM
+
+/* The maximum number of packets queued for a single neighbor, so that
+   an unreachable neighbor does not take all the packet buffers */
+#ifdef CSMA_CONF_MAX_PACKET_PER_NEIGHBOR
+#define CSMA_MAX_PACKET_PER_NEIGHBOR CSMA_CONF_MAX_PACKET_PER_NEIGHBOR
+#else
+#define CSMA_MAX_PACKET_PER_NEIGHBOR MAX_QUEUED_PACKETS
+#endif /* CSMA_CONF_MAX_PACKET_PER_NEIGHBOR */
+
+/* The bytes a neighbor may send in each round of the deficit round
+   robin among the neighbors ready to transmit. With 0, every neighbor
+   sends its whole queue as soon as its own timer fires. */
+#ifdef CSMA_CONF_DRR_QUANTUM
+#define CSMA_DRR_QUANTUM CSMA_CONF_DRR_QUANTUM
+#else
+#define CSMA_DRR_QUANTUM 0
+#endif /* CSMA_CONF_DRR_QUANTUM */
+
 /* Every neighbor has its own packet queue */
 struct neighbor_queue {
   struct neighbor_queue *next;
+#if CSMA_NEIGHBOR_HASH
+  /* The next neighbor in the same hash bucket */
+  struct neighbor_queue *hash_next;
+#endif /* CSMA_NEIGHBOR_HASH */
+#if CSMA_DRR_QUANTUM
+  /* The next neighbor ready to transmit */
+  struct neighbor_queue *ready_next;
+  /* The bytes it may still send in this round */
+  int16_t deficit;
+  uint8_t ready;
+#endif /* CSMA_DRR_QUANTUM */
   rimeaddr_t addr;
   struct ctimer transmit_timer;
   uint8_t transmissions;
   uint8_t collisions, deferrals;
+  uint8_t queued;
   LIST_STRUCT(queued_packet_list);
 };
 
-/* The maximum number of co-existing neighbor queues */
-#ifdef CSMA_CONF_MAX_NEIGHBOR_QUEUES
-#define CSMA_MAX_NEIGHBOR_QUEUES CSMA_CONF_MAX_NEIGHBOR_QUEUES
-#else
-#define CSMA_MAX_NEIGHBOR_QUEUES 2
-#endif /* CSMA_CONF_MAX_NEIGHBOR_QUEUES */
-
-#define MAX_QUEUED_PACKETS QUEUEBUF_NUM
 MEMB(neighbor_memb, struct neighbor_queue, CSMA_MAX_NEIGHBOR_QUEUES);
 MEMB(packet_memb, struct rdc_buf_list, MAX_QUEUED_PACKETS);
 MEMB(metadata_memb, struct qbuf_metadata, MAX_QUEUED_PACKETS);
 LIST(neighbor_list);
 
+#if CSMA_NEIGHBOR_HASH
+static struct neighbor_queue *neighbor_hash[CSMA_NEIGHBOR_HASH];
+#endif /* CSMA_NEIGHBOR_HASH */
+
+#if CSMA_DRR_QUANTUM
+/* The neighbors ready to transmit, in round robin order */
+static struct neighbor_queue *ready_head, *ready_tail;
+/* The neighbor whose packet is being sent by the RDC layer */
+static struct neighbor_queue *sending;
+static struct ctimer schedule_timer;
+#endif /* CSMA_DRR_QUANTUM */
+
+#if CSMA_STATS
+struct csma_stats csma_stats;
+#endif /* CSMA_STATS */
+
 static void packet_sent(void *ptr, int status, int num_transmissions);
 static void transmit_packet_list(void *ptr);
 
+/*---------------------------------------------------------------------------*/
+#if CSMA_NEIGHBOR_HASH
+static struct neighbor_queue **
+neighbor_bucket(const rimeaddr_t *addr)
+{
+  unsigned h;
+  int i;
+
+  h = 0;
+  for(i = 0; i < sizeof(rimeaddr_t); i++) {
+    h = h * 31 + addr->u8[i];
+  }
+  return &neighbor_hash[h % CSMA_NEIGHBOR_HASH];
+}
+#endif /* CSMA_NEIGHBOR_HASH */
 /*---------------------------------------------------------------------------*/
 static struct neighbor_queue *
 neighbor_queue_from_addr(const rimeaddr_t *addr)
 {
+#if CSMA_NEIGHBOR_HASH
+  struct neighbor_queue *n = *neighbor_bucket(addr);
+  while(n != NULL) {
+    if(rimeaddr_cmp(&n->addr, addr)) {
+      return n;
+    }
+    n = n->hash_next;
+  }
+#else /* CSMA_NEIGHBOR_HASH */
   struct neighbor_queue *n = list_head(neighbor_list);
   while(n != NULL) {
     if(rimeaddr_cmp(&n->addr, addr)) {
@@ -120,9 +198,41 @@ neighbor_queue_from_addr(const rimeaddr_t *addr)
     }
     n = list_item_next(n);
   }
+#endif /* CSMA_NEIGHBOR_HASH */
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+static void
+free_neighbor(struct neighbor_queue *n)
+{
+#if CSMA_NEIGHBOR_HASH
+  struct neighbor_queue **p;
+
+  for(p = neighbor_bucket(&n->addr); *p != n; p = &(*p)->hash_next);
+  *p = n->hash_next;
+#endif /* CSMA_NEIGHBOR_HASH */
+#if CSMA_DRR_QUANTUM
+  if(n->ready) {
+    struct neighbor_queue **p, *prev;
+
+    prev = NULL;
+    for(p = &ready_head; *p != n; p = &(*p)->ready_next) {
+      prev = *p;
+    }
+    *p = n->ready_next;
+    if(ready_tail == n) {
+      ready_tail = prev;
+    }
+  }
+  if(sending == n) {
+    sending = NULL;
+  }
+#endif /* CSMA_DRR_QUANTUM */
+  ctimer_stop(&n->transmit_timer);
+  list_remove(neighbor_list, n);
+  memb_free(&neighbor_memb, n);
+}
+/*---------------------------------------------------------------------------*/
 static clock_time_t
 default_timebase(void)
 {
@@ -140,10 +250,67 @@ default_timebase(void)
   return time;
 }
 /*---------------------------------------------------------------------------*/
+#if CSMA_DRR_QUANTUM
+/* Send the head packet of the next neighbor whose turn it is, one
+   packet at a time so that a neighbor with a long queue or a bad link
+   does not hold the others back */
+static void
+schedule(void *ptr)
+{
+  struct neighbor_queue *n;
+  struct rdc_buf_list *q;
+  int len;
+
+  while(sending == NULL && (n = ready_head) != NULL) {
+    q = list_head(n->queued_packet_list);
+    len = queuebuf_datalen(q->buf);
+    ready_head = n->ready_next;
+    if(n->deficit < len) {
+      /* Its turn comes again in the next round */
+      n->deficit += CSMA_DRR_QUANTUM;
+      n->ready_next = NULL;
+      if(ready_head == NULL) {
+        ready_head = n;
+      } else {
+        ready_tail->ready_next = n;
+      }
+      ready_tail = n;
+      continue;
+    }
+    if(ready_head == NULL) {
+      ready_tail = NULL;
+    }
+    n->ready = 0;
+    n->deficit -= len;
+
+    PRINTF("csma: sending %p to %d.%d, deficit %d\n", q,
+           n->addr.u8[0], n->addr.u8[1], n->deficit);
+    sending = n;
+    queuebuf_to_packetbuf(q->buf);
+    NETSTACK_RDC.send(packet_sent, n);
+  }
+}
+#endif /* CSMA_DRR_QUANTUM */
+/*---------------------------------------------------------------------------*/
 static void
 transmit_packet_list(void *ptr)
 {
   struct neighbor_queue *n = ptr;
+#if CSMA_DRR_QUANTUM
+  /* Wait for the turn of the neighbor */
+  if(n && !n->ready && sending != n &&
+     list_head(n->queued_packet_list) != NULL) {
+    n->ready = 1;
+    n->ready_next = NULL;
+    if(ready_head == NULL) {
+      ready_head = n;
+    } else {
+      ready_tail->ready_next = n;
+    }
+    ready_tail = n;
+    schedule(NULL);
+  }
+#else /* CSMA_DRR_QUANTUM */
   if(n) {
     struct rdc_buf_list *q = list_head(n->queued_packet_list);
     if(q != NULL) {
@@ -153,6 +320,7 @@ transmit_packet_list(void *ptr)
       NETSTACK_RDC.send_list(packet_sent, n, q);
     }
   }
+#endif /* CSMA_DRR_QUANTUM */
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -161,6 +329,7 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
   if(p != NULL) {
     /* Remove packet from list and deallocate */
     list_remove(n->queued_packet_list, p);
+    n->queued--;
 
     queuebuf_free(p->buf);
     memb_free(&metadata_memb, p->ptr);
@@ -177,9 +346,7 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
                  transmit_packet_list, n);
     } else {
       /* This was the last packet in the queue, we free the neighbor */
-      ctimer_stop(&n->transmit_timer);
-      list_remove(neighbor_list, n);
-      memb_free(&neighbor_memb, n);
+      free_neighbor(n);
     }
   }
 }
@@ -200,6 +367,13 @@ packet_sent(void *ptr, int status, int num_transmissions)
   if(n == NULL) {
     return;
   }
+#if CSMA_DRR_QUANTUM
+  if(sending == n && status != MAC_TX_DEFERRED) {
+    /* Let the next neighbor send */
+    sending = NULL;
+    ctimer_set(&schedule_timer, 0, schedule, NULL);
+  }
+#endif /* CSMA_DRR_QUANTUM */
   switch(status) {
   case MAC_TX_OK:
   case MAC_TX_NOACK:
@@ -210,6 +384,7 @@ packet_sent(void *ptr, int status, int num_transmissions)
     break;
   case MAC_TX_DEFERRED:
     n->deferrals++;
+    CSMA_STATS_ADD(deferrals);
     break;
   }
 
@@ -237,9 +412,11 @@ packet_sent(void *ptr, int status, int num_transmissions)
         switch(status) {
         case MAC_TX_COLLISION:
           PRINTF("csma: rexmit collision %d\n", n->transmissions);
+          CSMA_STATS_ADD(collisions);
           break;
         case MAC_TX_NOACK:
           PRINTF("csma: rexmit noack %d\n", n->transmissions);
+          CSMA_STATS_ADD(noacks);
           break;
         default:
           PRINTF("csma: rexmit err %d, %d\n", status, n->transmissions);
@@ -273,12 +450,14 @@ packet_sent(void *ptr, int status, int num_transmissions)
         } else {
           PRINTF("csma: drop with status %d after %d transmissions, %d collisions\n",
                  status, n->transmissions, n->collisions);
+          CSMA_STATS_ADD(dropped);
           free_packet(n, q);
           mac_call_sent_callback(sent, cptr, status, num_tx);
         }
       } else {
         if(status == MAC_TX_OK) {
           PRINTF("csma: rexmit ok %d\n", n->transmissions);
+          CSMA_STATS_ADD(sent);
         } else {
           PRINTF("csma: rexmit failed %d: %d\n", n->transmissions, status);
         }
@@ -315,14 +494,26 @@ send_packet(mac_callback_t sent, void *ptr)
       n->transmissions = 0;
       n->collisions = 0;
       n->deferrals = 0;
+      n->queued = 0;
+#if CSMA_DRR_QUANTUM
+      n->ready = 0;
+      n->deficit = 0;
+#endif /* CSMA_DRR_QUANTUM */
       /* Init packet list for this neighbor */
       LIST_STRUCT_INIT(n, queued_packet_list);
       /* Add neighbor to the list */
       list_add(neighbor_list, n);
+#if CSMA_NEIGHBOR_HASH
+      n->hash_next = *neighbor_bucket(addr);
+      *neighbor_bucket(addr) = n;
+#endif /* CSMA_NEIGHBOR_HASH */
     }
   }
 
-  if(n != NULL) {
+  if(n != NULL && n->queued >= CSMA_MAX_PACKET_PER_NEIGHBOR) {
+    PRINTF("csma: neighbor queue full, dropping packet\n");
+    CSMA_STATS_ADD(neighbor_full);
+  } else if(n != NULL) {
     /* Add packet to the neighbor's queue */
     q = memb_alloc(&packet_memb);
     if(q != NULL) {
@@ -348,6 +539,8 @@ send_packet(mac_callback_t sent, void *ptr)
 	  } else {
 	    list_add(n->queued_packet_list, q);
 	  }
+	  n->queued++;
+	  CSMA_STATS_ADD(queued);
 
 	  /* If q is the first packet in the neighbor's queue, send asap */
 	  if(list_head(n->queued_packet_list) == q) {
@@ -363,12 +556,14 @@ send_packet(mac_callback_t sent, void *ptr)
     }
     /* The packet allocation failed. Remove and free neighbor entry if empty. */
     if(list_length(n->queued_packet_list) == 0) {
-      list_remove(neighbor_list, n);
-      memb_free(&neighbor_memb, n);
+      free_neighbor(n);
     }
     PRINTF("csma: could not allocate packet, dropping packet\n");
-  } else {
+    CSMA_STATS_ADD(no_buffer);
+  }
+  if(n == NULL) {
     PRINTF("csma: could not allocate neighbor, dropping packet\n");
+    CSMA_STATS_ADD(no_neighbor);
   }
   mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
 }
@@ -400,12 +595,23 @@ channel_check_interval(void)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+void
+csma_stats_reset(void)
+{
+#if CSMA_STATS
+  memset(&csma_stats, 0, sizeof(csma_stats));
+#endif /* CSMA_STATS */
+}
+/*---------------------------------------------------------------------------*/
 static void
 init(void)
 {
   memb_init(&packet_memb);
   memb_init(&metadata_memb);
   memb_init(&neighbor_memb);
+#if CSMA_NEIGHBOR_HASH
+  memset(neighbor_hash, 0, sizeof(neighbor_hash));
+#endif /* CSMA_NEIGHBOR_HASH */
 }
 /*---------------------------------------------------------------------------*/
 const struct mac_driver csma_driver = {
@@ -44,8 +44,37 @@
 #include "net/mac/mac.h"
 #include "dev/radio.h"
 
+/* CSMA statistics, enabled with CSMA_CONF_STATS */
+#ifdef CSMA_CONF_STATS
+#define CSMA_STATS CSMA_CONF_STATS
+#else
+#define CSMA_STATS 0
+#endif
+
+struct csma_stats {
+  /* packets queued and packets sent */
+  unsigned long queued, sent;
+  /* packets dropped after the last transmission failed */
+  unsigned long dropped;
+  /* packets dropped because no neighbor queue, no packet buffer or
+     no more room in the queue of their neighbor was left */
+  unsigned long no_neighbor, no_buffer, neighbor_full;
+  /* backoffs after a collision and after a missing ack */
+  unsigned long collisions, noacks;
+  /* transmissions deferred by the RDC layer */
+  unsigned long deferrals;
+};
+
+#if CSMA_STATS
+extern struct csma_stats csma_stats;
+#define CSMA_STATS_ADD(x) csma_stats.x++
+#else
+#define CSMA_STATS_ADD(x)
+#endif
+
 extern const struct mac_driver csma_driver;
 
 const struct mac_driver *csma_init(const struct mac_driver *r);
+void csma_stats_reset(void);
 
 #endif /* __CSMA_H__ */
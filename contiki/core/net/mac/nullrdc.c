@@ -137,6 +137,8 @@ send_one_packet(mac_callback_t sent, void *ptr)
   } else {
 
 #ifdef NETSTACK_ENCRYPT
+    /* The MAC may still hold the packet for a retransmission */
+    packetbuf_unshare();
     NETSTACK_ENCRYPT();
 #endif /* NETSTACK_ENCRYPT */
 
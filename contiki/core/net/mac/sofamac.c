@@ -2,6 +2,9 @@
 #include "dev/radio.h"
 #include "dev/watchdog.h"
 #include "net/netstack.h"
+#include "lib/assert.h"
+#include "lib/list.h"
+#include "lib/memb.h"
 #include "lib/random.h"
 #include "net/mac/sofamac.h"
 #include "net/rime.h"
@@ -40,46 +43,212 @@
 #define USE_BACKOFF 1
 // after the backoff, if we receive a beacon instead on starting a communication we go to sleep
 #define SLEEP_BACKOFF 0
+// schedule the power cycle with rtimer rather than with the (clock tick bound) ctimer
+#ifdef SOFAMAC_CONF_WITH_RTIMER
+#define WITH_RTIMER SOFAMAC_CONF_WITH_RTIMER
+#else
+#define WITH_RTIMER 1
+#endif
+// learn the wake up phase of the neighbors that ack our strobes and start
+// the next strobe trains just before one of them wakes up
+#ifdef SOFAMAC_CONF_WITH_PHASE_OPTIMIZATION
+#define WITH_PHASE_OPTIMIZATION SOFAMAC_CONF_WITH_PHASE_OPTIMIZATION
+#else
+#define WITH_PHASE_OPTIMIZATION 0
+#endif
+// a strobe train can only be timed precisely by the rtimer power cycle
+#if !WITH_RTIMER
+#undef WITH_PHASE_OPTIMIZATION
+#define WITH_PHASE_OPTIMIZATION 0
+#endif
 
 // MACROS
 #define CSCHEDULE_POWERCYCLE(rtime) cschedule_powercycle((1ul * CLOCK_SECOND * (rtime)) / RTIMER_ARCH_SECOND)
 #define GOTO_IDLE(rtime) ctimer_set(&idle_timeout_ctimer,(1ul * CLOCK_SECOND * (rtime)) / RTIMER_ARCH_SECOND,(void (*)(void *))goto_idle, NULL)
 #define STOP_IDLE() ctimer_stop(&idle_timeout_ctimer)
-#define SEND_BACKOFF(rtime) ctimer_set(&backoff_ctimer,(1ul * CLOCK_SECOND * (rtime)) / RTIMER_ARCH_SECOND,(void (*)(void *))send_packet, NULL)
+#define SEND_BACKOFF(rtime) ctimer_set(&backoff_ctimer,(1ul * CLOCK_SECOND * (rtime)) / RTIMER_ARCH_SECOND,(void (*)(void *))backoff_expired, NULL)
 #define STOP_BACKOFF() ctimer_stop(&backoff_ctimer)
+#define PERIOD ((rtimer_clock_t)(sofamac_config.on_time + sofamac_config.off_time))
+#if WITH_RTIMER
+// the rtimer power cycle polls sofamac_process for each strobe
+#define SCHEDULE_STROBE()
+#else
+#define SCHEDULE_STROBE() ctimer_set(&strobe_ctimer,1 + (1ul * CLOCK_SECOND * sofamac_config.strobe_wait_time) / RTIMER_ARCH_SECOND,poll_sofamac, NULL)
+#endif
 
 #ifndef MIN
 #define MIN(a, b) ((a) < (b)? (a) : (b))
 #endif /* MIN */
 
+#ifdef SOFAMAC_CONF_QUEUE_SIZE
+#define SOFA_QUEUE_SIZE SOFAMAC_CONF_QUEUE_SIZE
+#else
+#define SOFA_QUEUE_SIZE 4
+#endif
+
+#if WITH_PHASE_OPTIMIZATION
+#include "net/mac/phase.h"
+
+#ifdef SOFAMAC_CONF_MAX_PHASE_NEIGHBORS
+#define MAX_PHASE_NEIGHBORS SOFAMAC_CONF_MAX_PHASE_NEIGHBORS
+#else
+#define MAX_PHASE_NEIGHBORS 8
+#endif
+
+// The recorded phase is the offset, within our own power cycle, of the
+// strobe that a neighbor acked. Keeping an offset rather than an absolute
+// time lets the wake ups be computed from short differences, which stay
+// correct across rtimer wraparounds whatever the period. The neighbor
+// heard the strobe within its on time: start strobing this long before
+#define PHASE_GUARD_TIME (2 * sofamac_config.on_time)
+
+PHASE_LIST(sofa_phase_list, MAX_PHASE_NEIGHBORS);
+// neighbor whose wake up the current strobe train is aimed at
+static rimeaddr_t phase_neighbor;
+#endif /* WITH_PHASE_OPTIMIZATION */
+
+// the number of targets is sent in a byte, and a targeted strobe must fit
+// in the packetbuf of its receivers
+CTASSERT(SOFA_MAX_TARGETS <= 255);
+CTASSERT(sizeof(struct sofa_hdr) + 1 + SOFA_MAX_TARGETS * sizeof(rimeaddr_t) <= PACKETBUF_SIZE);
+// the payload length is sent in a byte, and a data frame with the largest
+// payload and all the responders must fit in a frame
+CTASSERT(SOFA_MAX_PAYLOAD <= 255);
+CTASSERT(SOFA_MAX_FRAMER_HDR_SIZE + sizeof(struct sofa_data_hdr) + SOFA_MAX_PAYLOAD +
+	1 + SOFA_MAX_RESPONDERS * sizeof(rimeaddr_t) <= SOFA_MAX_FRAME_SIZE);
+
 // GLOBAL VARIABLES
 
-//value to be sent
-uint16_t sofa_value;
+// exchanges waiting to be initiated, the head is the ongoing one
+struct sofa_tx_req {
+  struct sofa_tx_req *next;
+  sofa_handle_t handle;
+  // set for the packets handed over by the upper layers
+  mac_callback_t sent;
+  void *ptr;
+  // set when the payload is pulled from the application at the start
+  uint8_t pull;
+  uint8_t len;
+  uint8_t payload[SOFA_MAX_PAYLOAD];
+  // neighbors that may answer, none means anyone
+  uint8_t ntargets;
+  rimeaddr_t targets[SOFA_MAX_TARGETS];
+#if SOFAMAC_STATS
+  clock_time_t queued;
+#endif
+};
+MEMB(tx_memb, struct sofa_tx_req, SOFA_QUEUE_SIZE);
+LIST(tx_queue);
+static sofa_handle_t last_handle;
 // Retransmission probability
 #if RETX
 int p_retx = 50;
 #endif
 // Timers
 static struct ctimer idle_timeout_ctimer;
+#if WITH_RTIMER
+static struct rtimer rt;
+static rtimer_clock_t cycle_start;
+#else
 static struct ctimer cpowercycle_ctimer;
+#endif
 static struct ctimer backoff_ctimer;
+#if !WITH_RTIMER
+static struct ctimer strobe_ctimer;
+#endif
 // FSM
-enum mac_state current_state = disabled;
-// MAC parameters
-struct sofamac_config sofamac_config =
+volatile enum mac_state current_state = disabled;
+// MAC parameters, see sofamac_set_config()
+static struct sofamac_config sofamac_config =
 	{
 		DEFAULT_ON_TIME, DEFAULT_OFF_TIME,
-		DEFAULT_STROBE_TIME, DEFAULT_STROBE_WAIT_TIME
+		DEFAULT_STROBE_TIME, DEFAULT_STROBE_WAIT_TIME,
+		MASTER_PACKET_WAITING_TIME, MASTER_ACK_WAITING_TIME,
+		SLAVE_PACKET_WAITING_TIME, MASTER_BACKOFF_WAITING_TIME,
+		DEFAULT_ACK_WINDOW_TIME, DEFAULT_SLOT_TIME
 	};
+// set by sofamac_set_config(), used from the next cycle boundary
+static struct sofamac_config next_config;
+static volatile uint8_t config_pending;
 static struct pt pt;
+// strobe train
+static struct pt strobe_pt;
+static uint8_t strobing;
+static uint8_t strobe[MAX_STROBE_SIZE];
+static int strobe_len;
+static rtimer_clock_t strobe_t0;
+static int strobes, collisions;
+static rtimer_clock_t last_strobe_time;
+// neighbors that acked the strobe train, in the order of their reply slots
+static rimeaddr_t responders[SOFA_MAX_RESPONDERS];
+static uint8_t nresponders;
+static rtimer_clock_t ack_window_end;
+// responders whose data we got
+static uint8_t answered[SOFA_MAX_RESPONDERS];
+static uint8_t answers;
+// our reply to a master data frame, sent when our slot starts
+static uint8_t reply[MAX_DATA_SIZE];
+static int reply_len;
+static struct rtimer slot_rt;
+// initiator of the exchange we acked
+static rimeaddr_t master;
 // callbacks
 const struct sofa_callback *u;
 
+PROCESS(sofamac_process, "SOFA MAC");
+
+#if SOFAMAC_STATS
+struct sofamac_stats sofamac_stats;
+static uint8_t stats_radio_is_on;
+static rtimer_clock_t stats_radio_since;
+
+/*---------------------------------------------------------------------------*/
+// charge the radio on time since the last call to the current state
+static void stats_radio_time(void)
+    {
+    rtimer_clock_t now = RTIMER_NOW();
+
+    if (stats_radio_is_on)
+	{
+	sofamac_stats.radio_on[current_state] += (rtimer_clock_t)(now - stats_radio_since);
+	}
+    stats_radio_since = now;
+    }
+
+/*---------------------------------------------------------------------------*/
+static void stats_radio(uint8_t on)
+    {
+    stats_radio_time();
+    stats_radio_is_on = on;
+    }
+
+/*---------------------------------------------------------------------------*/
+static void stats_histogram(unsigned long *histogram, unsigned long ms)
+    {
+    int bin;
+
+    for (bin = 0; ms > 0 && bin < SOFA_STATS_BINS - 1; bin++)
+	{
+	ms >>= 1;
+	}
+    histogram[bin]++;
+    }
+
+#define SET_STATE(s) do { stats_radio_time(); current_state = (s); } while(0)
+#define STATS_RADIO(on) stats_radio(on)
+#else
+#define SET_STATE(s) current_state = (s)
+#define STATS_RADIO(on)
+#endif /* SOFAMAC_STATS */
+
 /*---------------------------------------------------------------------------*/
 static void powercycle_turn_radio_off(void)
     {
-    if (current_state == idle)	NETSTACK_RADIO.off();
+    if (current_state == idle)
+	{
+	NETSTACK_RADIO.off();
+	STATS_RADIO(0);
+	}
     }
 
 /*---------------------------------------------------------------------------*/
@@ -88,13 +257,204 @@ static void powercycle_turn_radio_on(void)
     if (current_state != disabled)
 	{
 	NETSTACK_RADIO.on();
-#if USE_BACKOFF
-	if (current_state == wait_to_send)
-	    SEND_BACKOFF(MASTER_BACKOFF_WAITING_TIME);
+	STATS_RADIO(1);
+	}
+    }
+
+/*---------------------------------------------------------------------------*/
+// only the initiator of an exchange goes through these states
+static int is_initiator(void)
+    {
+    return current_state == wait_to_send || current_state == wait_slave_strobe_ack ||
+	current_state == wait_slave_packet;
+    }
+
+/*---------------------------------------------------------------------------*/
+static void start_exchange(void);
+// Reports the outcome of the exchange we initiated and moves on to the
+// next queued one
+static void exchange_done(uint16_t ret)
+    {
+    struct sofa_tx_req *req;
+    int status;
+
+    SET_STATE(idle);
+    powercycle_turn_radio_off();
+    req = list_pop(tx_queue);
+    if (req == NULL)
+	{
+	return;
 	}
+#if SOFAMAC_STATS
+    if (ret == SOFA_SUCCESS || ret == SOFA_PARTIAL) sofamac_stats.success++;
+    else if (ret == SOFA_NOACK) sofamac_stats.noack++;
+    else if (ret == SOFA_BUSY) sofamac_stats.busy++;
+    else sofamac_stats.error++;
+    stats_histogram(sofamac_stats.latency, (1000ul * (clock_time() - req->queued)) / CLOCK_SECOND);
 #endif
+    if (req->sent != NULL)
+	{
+	status = ret == SOFA_SUCCESS || ret == SOFA_PARTIAL ? MAC_TX_OK : ret == SOFA_NOACK ? MAC_TX_NOACK :
+	    ret == SOFA_BUSY ? MAC_TX_COLLISION : MAC_TX_ERR;
+	mac_call_sent_callback(req->sent, req->ptr, status, 1);
+	}
+    else if (u != NULL && u->result)
+	{
+	u->result(req->handle, ret);
+	}
+    memb_free(&tx_memb, req);
+    if (current_state == idle && list_head(tx_queue) != NULL)
+	{
+	start_exchange();
+	}
+    }
+
+/*---------------------------------------------------------------------------*/
+// the ongoing exchange failed, go back to sleep
+static void exchange_failed(void)
+    {
+    if (is_initiator())
+	{
+	exchange_done(SOFA_ERROR);
+	return;
+	}
+    SET_STATE(idle);
+    SOFAMAC_STATS_ADD(passive_error);
+    // notify the application that the data exchange was not successfull
+    if(u != NULL && u->result) u->result(SOFA_HANDLE_NONE, SOFA_ERROR);
+    powercycle_turn_radio_off();
+    }
+
+/*---------------------------------------------------------------------------*/
+// whether addr is one of the n targets, no targets match any address
+static int is_target(const rimeaddr_t *targets, uint8_t n, const rimeaddr_t *addr)
+    {
+    uint8_t i;
+
+    for (i = 0; i < n; i++)
+	{
+	if (rimeaddr_cmp(&targets[i], addr))
+	    {
+	    return 1;
+	    }
+	}
+    return n == 0;
+    }
+
+/*---------------------------------------------------------------------------*/
+// Queues an exchange with one of the ntargets targets, or with anyone if
+// there are none. Returns its handle or SOFA_HANDLE_NONE if it cannot
+// be queued.
+static sofa_handle_t enqueue_exchange(const rimeaddr_t *targets, uint8_t ntargets,
+	const void *payload, uint8_t len, mac_callback_t sent, void *ptr)
+    {
+    struct sofa_tx_req *req;
+
+    if (len > SOFA_MAX_PAYLOAD || ntargets > SOFA_MAX_TARGETS)
+	{
+	PRINTDEBUG("sofamac: payload too large (%u) or too many targets (%u)\n", len, ntargets);
+	return SOFA_HANDLE_NONE;
+	}
+    req = memb_alloc(&tx_memb);
+    if (req == NULL)
+	{
+	PRINTDEBUG("sofamac: queue full\n");
+	SOFAMAC_STATS_ADD(queue_full);
+	return SOFA_HANDLE_NONE;
+	}
+    if (++last_handle == SOFA_HANDLE_NONE)
+	{
+	last_handle++;
+	}
+    req->handle = last_handle;
+    req->sent = sent;
+    req->ptr = ptr;
+    req->pull = payload == NULL;
+    req->len = req->pull ? 0 : len;
+    if (!req->pull)
+	{
+	memcpy(req->payload, payload, len);
+	}
+    req->ntargets = ntargets;
+    if (ntargets > 0)
+	{
+	memcpy(req->targets, targets, ntargets * sizeof(rimeaddr_t));
+	}
+#if SOFAMAC_STATS
+    req->queued = clock_time();
+#endif
+    list_add(tx_queue, req);
+    if (current_state == idle)
+	{
+	start_exchange();
+	}
+    return req->handle;
+    }
+
+/*---------------------------------------------------------------------------*/
+// the backoff may end both in the ctimer and in the rtimer power cycle
+static void backoff_expired(void)
+    {
+    if (current_state == wait_to_send)
+	{
+	STOP_BACKOFF();
+	send_packet();
+	}
     }
 
+#if !WITH_RTIMER
+/*---------------------------------------------------------------------------*/
+// listen to the channel for a while before starting the exchange. Must
+// not be called from interrupt context.
+static void start_backoff(void)
+    {
+#if USE_BACKOFF
+    SEND_BACKOFF(sofamac_config.backoff_time);
+#else
+    backoff_expired();
+#endif
+    }
+
+/*---------------------------------------------------------------------------*/
+static void poll_sofamac(void *ptr)
+    {
+    process_poll(&sofamac_process);
+    }
+#endif
+
+/*---------------------------------------------------------------------------*/
+// Become the initiator of an exchange. With the rtimer power cycle the
+// backoff and the strobe train start at our next wake up.
+static void start_exchange(void)
+    {
+    SET_STATE(wait_to_send);
+#if !WITH_RTIMER
+    powercycle_turn_radio_on();
+    start_backoff();
+#endif
+    }
+
+#if WITH_RTIMER
+/*---------------------------------------------------------------------------*/
+static char powercycle(struct rtimer *t, void *ptr);
+static void schedule_powercycle_fixed(struct rtimer *t, rtimer_clock_t fixed_time)
+    {
+    int r;
+
+    if (current_state != disabled)
+	{
+	if (RTIMER_CLOCK_LT(fixed_time, RTIMER_NOW() + 1))
+	    {
+	    fixed_time = RTIMER_NOW() + 1;
+	    }
+	r = rtimer_set(t, fixed_time, 1, (void (*)(struct rtimer *, void *)) powercycle, NULL);
+	if (r != RTIMER_OK)
+	    {
+	    PRINTF("sofamac: could not set rtimer\n");
+	    }
+	}
+    }
+#else
 /*---------------------------------------------------------------------------*/
 static char cpowercycle(void *ptr);
 static void cschedule_powercycle(clock_time_t time)
@@ -105,14 +465,154 @@ static void cschedule_powercycle(clock_time_t time)
 	ctimer_set(&cpowercycle_ctimer, time, (void (*)(void *)) cpowercycle, NULL);
 	}
     }
+#endif
+
+/*---------------------------------------------------------------------------*/
+// Called at the start of each power cycle: a new configuration only takes
+// effect between exchanges, so the timers of the ongoing one stay consistent
+static void apply_config(void)
+    {
+    if (config_pending && (current_state == idle || current_state == disabled ||
+	    current_state == wait_to_send))
+	{
+	memcpy(&sofamac_config, &next_config, sizeof(sofamac_config));
+	config_pending = 0;
+	}
+    }
 
 /*---------------------------------------------------------------------------*/
 static void goto_idle()
     {
-    current_state = idle;
+    if (current_state == wait_slave_packet)
+	{
+	// (some of) the slaves did not answer
+	exchange_done(answers > 0 ? SOFA_PARTIAL : SOFA_ERROR);
+	return;
+	}
+    if (current_state == wait_master_packet || current_state == wait_master_packacket_ack)
+	{
+	// the initiator did not go on with the exchange
+	SOFAMAC_STATS_ADD(passive_error);
+	}
+    SET_STATE(idle);
     powercycle_turn_radio_off();
     }
 
+#if WITH_PHASE_OPTIMIZATION
+/*---------------------------------------------------------------------------*/
+// offset of time from the start of our current power cycle
+static rtimer_clock_t phase_offset(rtimer_clock_t time)
+    {
+    while (RTIMER_CLOCK_LT(time, cycle_start))
+	{
+	time += PERIOD;
+	}
+    return (rtimer_clock_t)(time - cycle_start) % PERIOD;
+    }
+
+/*---------------------------------------------------------------------------*/
+// Returns when to start the backoff so that the strobe train begins just
+// before the first known (targeted) neighbor wakes up, or now if no phase
+// is known
+static rtimer_clock_t phase_strobe_start(rtimer_clock_t now)
+    {
+    struct sofa_tx_req *req = list_head(tx_queue);
+    struct phase *e;
+    rtimer_clock_t wake, wait, lead, best = 0;
+
+    lead = PHASE_GUARD_TIME;
+#if USE_BACKOFF
+    lead += sofamac_config.backoff_time;
+#endif
+    rimeaddr_copy(&phase_neighbor, &rimeaddr_null);
+    for (e = list_head(*sofa_phase_list.list); e != NULL; e = list_item_next(e))
+	{
+	if (!is_target(req->targets, req->ntargets, &e->neighbor))
+	    {
+	    continue;
+	    }
+	// neighbors are assumed to wake up with our own period
+	wake = cycle_start + e->time;
+	while (RTIMER_CLOCK_LT(wake, now + lead))
+	    {
+	    wake += PERIOD;
+	    }
+	wait = wake - now;
+	if (rimeaddr_cmp(&phase_neighbor, &rimeaddr_null) || wait < best)
+	    {
+	    best = wait;
+	    rimeaddr_copy(&phase_neighbor, &e->neighbor);
+	    }
+	}
+    if (rimeaddr_cmp(&phase_neighbor, &rimeaddr_null))
+	{
+	return now;
+	}
+    return now + best - lead;
+    }
+#endif /* WITH_PHASE_OPTIMIZATION */
+
+#if WITH_RTIMER
+/*---------------------------------------------------------------------------*/
+// Runs in interrupt context: the radio is switched at fixed offsets from
+// the cycle start, and everything else is handed over to sofamac_process
+static char powercycle(struct rtimer *t, void *ptr)
+    {
+    PT_BEGIN(&pt);
+    cycle_start = RTIMER_NOW();
+    while (1)
+	{
+	apply_config();
+	powercycle_turn_radio_on();
+	// exchanges queued while we were busy start now
+	if (current_state == idle && list_head(tx_queue) != NULL)
+	    {
+	    SET_STATE(wait_to_send);
+	    }
+	if (current_state == wait_to_send)
+	    {
+#if WITH_PHASE_OPTIMIZATION
+	    {
+	    static rtimer_clock_t phase_start;
+	    // sleep until just before the first known neighbor wakes up
+	    phase_start = phase_strobe_start(RTIMER_NOW());
+	    if (RTIMER_CLOCK_LT(RTIMER_NOW(), phase_start))
+		{
+		NETSTACK_RADIO.off();
+		STATS_RADIO(0);
+		schedule_powercycle_fixed(t, phase_start);
+		PT_YIELD(&pt);
+		powercycle_turn_radio_on();
+		}
+	    }
+#endif
+#if USE_BACKOFF
+	    schedule_powercycle_fixed(t, RTIMER_NOW() + sofamac_config.backoff_time);
+	    PT_YIELD(&pt);
+#endif
+	    // start the strobe train and pace it, one strobe per wait window
+	    while (current_state == wait_to_send || current_state == wait_slave_strobe_ack)
+		{
+		process_poll(&sofamac_process);
+		schedule_powercycle_fixed(t, RTIMER_NOW() + sofamac_config.strobe_wait_time);
+		PT_YIELD(&pt);
+		}
+	    // the strobe train may have lasted more than a period
+	    while (RTIMER_CLOCK_LT(cycle_start + PERIOD, RTIMER_NOW()))
+		{
+		cycle_start += PERIOD;
+		}
+	    }
+	schedule_powercycle_fixed(t, cycle_start + sofamac_config.on_time);
+	PT_YIELD(&pt);
+	powercycle_turn_radio_off();
+	cycle_start += PERIOD;
+	schedule_powercycle_fixed(t, cycle_start);
+	PT_YIELD(&pt);
+	}
+    PT_END(&pt);
+    }
+#else
 /*---------------------------------------------------------------------------*/
 static char cpowercycle(void *ptr)
     {
@@ -120,178 +620,281 @@ static char cpowercycle(void *ptr)
 			    ;
     while (1)
 	{
+	apply_config();
 	powercycle_turn_radio_on();
-	CSCHEDULE_POWERCYCLE(DEFAULT_ON_TIME);
+	if (current_state == idle && list_head(tx_queue) != NULL) start_exchange();
+	else if (current_state == wait_to_send) start_backoff();
+	CSCHEDULE_POWERCYCLE(sofamac_config.on_time);
 	PT_YIELD(&pt);
 	powercycle_turn_radio_off();
-	CSCHEDULE_POWERCYCLE(DEFAULT_OFF_TIME);
+	CSCHEDULE_POWERCYCLE(sofamac_config.off_time);
 	PT_YIELD(&pt);
 	}
     PT_END (&pt);
     }
+#endif
 
 /*---------------------------------------------------------------------------*/
-int send_packet(void)
+// start the power cycle off_time from now
+static void start_powercycle(void)
     {
-    int len, strobe_len, data_len, strobes, collisions;
-    struct sofa_hdr *hdr;
+#if WITH_RTIMER
+    rtimer_set(&rt, RTIMER_NOW() + sofamac_config.off_time, 1, (void (*)(struct rtimer *, void *)) powercycle, NULL);
+#else
+    CSCHEDULE_POWERCYCLE(sofamac_config.off_time);
+#endif
+    }
+
+/*---------------------------------------------------------------------------*/
+// index of addr among the responders, -1 if it did not ack our strobes
+static int responder_index(const rimeaddr_t *addr)
+    {
+    int i;
+
+    for (i = 0; i < nresponders; i++)
+	{
+	if (rimeaddr_cmp(&responders[i], addr))
+	    {
+	    return i;
+	    }
+	}
+    return -1;
+    }
+
+/*---------------------------------------------------------------------------*/
+// whether the ack window opened by the first strobe ack is over
+static int ack_window_over(void)
+    {
+    return nresponders > 0 && !RTIMER_CLOCK_LT(RTIMER_NOW(), ack_window_end);
+    }
+
+/*---------------------------------------------------------------------------*/
+// send our data to the nodes that acknowledged the strobe train
+static int send_master_data(void)
+    {
+    int len, data_len;
     struct sofa_data_hdr *data_pkt;
-    uint8_t strobe[MAX_STROBE_SIZE];
-    uint8_t data[MAX_STROBE_SIZE];
-    rtimer_clock_t t0, t;
-    rimeaddr_t strobe_ack_sender;
+    uint8_t data[MAX_DATA_SIZE];
+    uint8_t *list;
+    struct sofa_tx_req *req = list_head(tx_queue);
 
-    //TODO: instead of enforcing broadcast, we should allow the application to also use unicast
-    // ensure that the sender of the packet is this node and the receiver is null
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &rimeaddr_null);
+    packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &rimeaddr_node_addr);
+    // Create the data header for the data packet.
+    len = NETSTACK_FRAMER.create();
+    data_len = len + sizeof(struct sofa_data_hdr) + req->len;
+    if (nresponders > 1)
+	{
+	data_len += 1 + nresponders * sizeof(rimeaddr_t);
+	}
+    if (len == 0 || data_len > (int) sizeof(data))
+	{
+	PRINTDEBUG("sofamac: data send failed, too large header\n");
+	return MAC_TX_ERR_FATAL;
+	}
+    memcpy(data, packetbuf_hdrptr(), len);
+    data_pkt = (struct sofa_data_hdr *)&(data[len]);
+    data_pkt->type = TYPE_DATA_M;
+    // this payload is provided buy the application
+    data_pkt->len = req->len;
+    memcpy(data_pkt + 1, req->payload, req->len);
+    rimeaddr_copy(&(data_pkt->dst), &responders[0]);
+    if (nresponders > 1)
+	{
+	// tell the responders in which slot to reply
+	list = (uint8_t *)(data_pkt + 1) + req->len;
+	list[0] = nresponders;
+	memcpy(list + 1, responders, nresponders * sizeof(rimeaddr_t));
+	}
+    answers = 0;
+    memset(answered, 0, sizeof(answered));
+    packetbuf_compact(); // This assures that the entire packet is consecutive in memory
+    NETSTACK_RADIO.send(data, data_len);
+    GOTO_IDLE(sofamac_config.slave_packet_wait_time + (nresponders - 1) * sofamac_config.slot_time);
+    PRINTDEBUG(
+	    "sofamac: send data to %d,%d and %u more (strobes=%u,len=%u), done\n", responders[0].u8[0], responders[0].u8[1], nresponders - 1, strobes, data_len);
+    return MAC_TX_OK;
+    }
+
+/*---------------------------------------------------------------------------*/
+// Sends one strobe each time sofamac_process is polled, until enough strobe
+// acks or a collision are received or the strobe time is over
+static PT_THREAD(strobe_train(void))
+    {
+    int ret;
+
+    PT_BEGIN(&strobe_pt);
+    strobe_t0 = RTIMER_NOW();
+    for (strobes = 0; current_state == wait_slave_strobe_ack && collisions == 0 && RTIMER_CLOCK_LT (RTIMER_NOW (), strobe_t0 + sofamac_config.strobe_time) && !ack_window_over(); strobes++)
+	{
+	last_strobe_time = RTIMER_NOW();
+	NETSTACK_RADIO.send(strobe, strobe_len);
+	SOFAMAC_STATS_ADD(strobes);
+	SCHEDULE_STROBE();
+	PT_YIELD(&strobe_pt);
+	}
+    // end of strobe sending time or got a collision or node is no more waiting for a strobe packet
+    if (nresponders > 0 && (current_state == wait_slave_strobe_ack || current_state == wait_slave_packet))
+	{
+	SET_STATE(wait_slave_packet);
+	ret = send_master_data();
+	}
+    else if (collisions == 0)
+	{
+	ret = MAC_TX_NOACK;
+#if WITH_PHASE_OPTIMIZATION
+	// the neighbor we aimed at may have changed its phase
+	if (!rimeaddr_cmp(&phase_neighbor, &rimeaddr_null))
+	    {
+	    phase_update(&sofa_phase_list, &phase_neighbor, 0, MAC_TX_NOACK);
+	    }
+#endif
+	}
+    else
+	{
+	SOFAMAC_STATS_ADD(collisions);
+	ret = MAC_TX_COLLISION;
+	}
+    if (ret != MAC_TX_OK)
+	{
+	exchange_done(ret == MAC_TX_NOACK ? SOFA_NOACK : ret == MAC_TX_COLLISION ? SOFA_BUSY : SOFA_ERROR);
+	}
+    strobing = 0;
+    PT_END(&strobe_pt);
+    }
+
+/*---------------------------------------------------------------------------*/
+// Starts the strobe train of an exchange, the outcome is reported through
+// the result callback
+int send_packet(void)
+    {
+    int len;
+    struct sofa_tx_req *req = list_head(tx_queue);
+
+    if (req == NULL)
+	{
+	SET_STATE(idle);
+	return MAC_TX_ERR;
+	}
+    if (req->pull)
+	{
+	// the application state may have changed while the exchange was queued
+	req->len = 0;
+	if (u != NULL && u->pull)
+	    {
+	    req->len = MIN(u->pull(req->payload, SOFA_MAX_PAYLOAD), SOFA_MAX_PAYLOAD);
+	    }
+	}
+    // strobes are broadcast, the targeted neighbors are listed in the payload
     packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &rimeaddr_node_addr);
     packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &rimeaddr_null);
     // Create the sofamac header for the beacon
     len = NETSTACK_FRAMER.create();
-    strobe_len = len + sizeof(struct sofa_hdr);
+    strobe_len = len + sizeof(struct sofa_hdr) + 1 + req->ntargets * sizeof(rimeaddr_t);
     if (len == 0 || strobe_len > (int) sizeof(strobe))
 	{
 	PRINTDEBUG("sofamac: data send failed, too large header\n");
-	current_state = idle;
+	exchange_done(SOFA_ERROR);
 	return MAC_TX_ERR_FATAL;
 	}
     // copy header to our structure
     memcpy(strobe, packetbuf_hdrptr(), len);
     // set packet type
     strobe[len] = TYPE_STROBE;
+    // append the targets
+    strobe[len + sizeof(struct sofa_hdr)] = req->ntargets;
+    memcpy(&strobe[len + sizeof(struct sofa_hdr) + 1], req->targets, req->ntargets * sizeof(rimeaddr_t));
     // update FSM
-    current_state = wait_slave_strobe_ack;
-    // clear the receiver address
-    rimeaddr_copy(&strobe_ack_sender, &rimeaddr_null);
-    // Turn on the radio to listen for the strobe ACK
-    powercycle_turn_radio_on();
-    watchdog_stop();
+    SET_STATE(wait_slave_strobe_ack);
+    // clear the responders
+    nresponders = 0;
     // clear the collision count
     collisions = 0;
-    // Send a train of strobes until the receiver answers with an ACK
-    t0 = RTIMER_NOW ();
-    for (strobes = 0; current_state == wait_slave_strobe_ack && collisions == 0 && RTIMER_CLOCK_LT (RTIMER_NOW (), t0 + sofamac_config.strobe_time); strobes++)
-	{
-	t = RTIMER_NOW ();
-	// listen for incoming ACKs
-	while (current_state == wait_slave_strobe_ack && RTIMER_CLOCK_LT (RTIMER_NOW (),
-		t + sofamac_config.strobe_wait_time))
-	    {
-	    // Check if we received an ACK
-	    packetbuf_clear();
-	    len = NETSTACK_RADIO.read(packetbuf_dataptr(), PACKETBUF_SIZE);
-	    if (len > 0)
-		{
-		packetbuf_set_datalen(len);
-		if (NETSTACK_FRAMER.parse())
-		    {
-
-		    hdr = packetbuf_dataptr();
-		    if (hdr->type == TYPE_STROBE_ACK)
-			{
-			if (rimeaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &rimeaddr_node_addr))
-			    {
-			    // save the address of the receiver
-			    rimeaddr_copy(&strobe_ack_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
-			    // update FSM
-			    current_state = wait_slave_packet;
-			    }
-			else // ACK not for us
-			    {
-			    PRINTDEBUG("sofamac: strobe ack for someone else\n");
-			    }
-			}
-		    else // not a STROBE ACK
-			{
-			PRINTDEBUG(
-				"sofamac: expected strobe ack, got data or other type \n");
-			collisions++;
-			}
-		    }
-		else // fail to parse the packet
-		    {
-		    PRINTDEBUG(
-			    "sofamac: expected strobe ack, packet failed to parse %u\n", len);
+    // Turn on the radio to listen for the strobe ACK
+    powercycle_turn_radio_on();
+    // Send the first strobe, the following ones are sent by sofamac_process
+    strobing = 1;
+    SOFAMAC_STATS_ADD(exchanges);
+    PT_INIT(&strobe_pt);
+    strobe_train();
+    return MAC_TX_DEFERRED;
+    }
 
-		    }
-		} // endif read packet length > 0
-	    } // end strobe_wait_time
-	//TODO: this sould not be needed
-	t = RTIMER_NOW ();
-	// Send the beacon
-	if (current_state == wait_slave_strobe_ack && collisions == 0)
-	    {
-	    NETSTACK_RADIO.send(strobe, strobe_len);
-	    }
+/*---------------------------------------------------------------------------*/
+// The packetbuf payload becomes the payload of a queued exchange, sent is
+// called once the exchange is over
+static void qsend_packet(mac_callback_t sent, void *ptr)
+    {
+    if (packetbuf_datalen() > SOFA_MAX_PAYLOAD)
+	{
+	mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
 	}
-    // end of strobe sending time or got a collision or node is no more waiting for a strobe packet
-    if (current_state == wait_slave_packet && collisions == 0)
-	{
-	packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &rimeaddr_null);
-	packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &rimeaddr_node_addr);
-	// Create the data header for the data packet.
-	len = NETSTACK_FRAMER.create();
-	data_len = len + sizeof(struct sofa_data_hdr);
-	if (len == 0 || data_len > (int) sizeof(data))
-	    {
-	    PRINTDEBUG("sofamac: data send failed, too large header\n");
-	    return MAC_TX_ERR_FATAL;
-	    }
-	memcpy(data, packetbuf_hdrptr(), len);
-	data_pkt = (struct sofa_data_hdr *)&(data[len]);
-	data_pkt->type = TYPE_DATA_M;
-	// this value is provided buy the application
-	data_pkt->data = sofa_value;
-	rimeaddr_copy(&(data_pkt->dst), &strobe_ack_sender);
-	packetbuf_compact(); // This assures that the entire packet is consecutive in memory
-	NETSTACK_RADIO.send(data, data_len);
-	GOTO_IDLE(SLAVE_PACKET_WAITING_TIME);
-	PRINTDEBUG(
-		"sofamac: send data to %d,%d (strobes=%u,len=%u,%s), done\n", packetbuf_addr (PACKETBUF_ADDR_RECEIVER)->u8[0], packetbuf_addr (PACKETBUF_ADDR_RECEIVER)->u8[1], strobes, packetbuf_totlen (), current_state == wait_slave_packet ? "ack" : "no ack");
+    else if (enqueue_exchange(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
+	    rimeaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &rimeaddr_null) ? 0 : 1,
+	    packetbuf_dataptr(), packetbuf_datalen(), sent, ptr) == SOFA_HANDLE_NONE)
+	{
+	mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
+	}
+    }
+
+/*---------------------------------------------------------------------------*/
+// whether the received strobe may be answered by us. Strobes without a
+// target list are answered by anyone.
+static int strobe_targets_us(void)
+    {
+    uint8_t *ntargets = (uint8_t *)packetbuf_dataptr() + sizeof(struct sofa_hdr);
+
+    if (packetbuf_datalen() <= sizeof(struct sofa_hdr) ||
+	    packetbuf_datalen() < sizeof(struct sofa_hdr) + 1 + *ntargets * sizeof(rimeaddr_t))
+	{
+	return 1;
 	}
-    else // we got a collision or we didn't receive a strobe ack
+    return is_target((rimeaddr_t *)(ntargets + 1), *ntargets, &rimeaddr_node_addr);
+    }
+
+/*---------------------------------------------------------------------------*/
+// check that the payload announced by a data header was entirely received
+static int valid_data_len(const struct sofa_data_hdr *data_pkt)
+    {
+    return data_pkt->len <= SOFA_MAX_PAYLOAD &&
+	packetbuf_datalen() >= sizeof(struct sofa_data_hdr) + data_pkt->len;
+    }
+
+/*---------------------------------------------------------------------------*/
+// our reply slot in a valid master data frame, -1 if it is not for us
+static int data_slot(const struct sofa_data_hdr *data_pkt)
+    {
+    const uint8_t *list = (const uint8_t *)(data_pkt + 1) + data_pkt->len;
+    int i;
+
+    if (rimeaddr_cmp(&(data_pkt->dst), &rimeaddr_node_addr))
 	{
-	current_state = idle;
-	powercycle_turn_radio_off();
+	return 0;
 	}
-    watchdog_start();
-    if (collisions == 0)
+    if (packetbuf_datalen() > sizeof(struct sofa_data_hdr) + data_pkt->len &&
+	    packetbuf_datalen() >= sizeof(struct sofa_data_hdr) + data_pkt->len + 1 + list[0] * sizeof(rimeaddr_t))
 	{
-	if (current_state == wait_slave_strobe_ack)
+	for (i = 1; i < list[0]; i++)
 	    {
-	    return MAC_TX_NOACK;
-	    }
-	else
-	    {
-	    return MAC_TX_OK;
+	    if (rimeaddr_cmp((const rimeaddr_t *)(list + 1) + i, &rimeaddr_node_addr))
+		{
+		return i;
+		}
 	    }
 	}
-    else
-	{
-	return MAC_TX_COLLISION;
-	}
+    return -1;
     }
 
 /*---------------------------------------------------------------------------*/
-static void qsend_packet(mac_callback_t sent, void *ptr)
+// Sends our reply to the initiator, from the slot rtimer unless we have
+// the first slot
+static void send_reply(struct rtimer *t, void *ptr)
     {
-    int tx_status = MAC_TX_OK;
-
-    if (current_state == idle)
+    // the exchange may have timed out while we waited for our slot
+    if (current_state == wait_master_packacket_ack)
 	{
-#if USE_BACKOFF    
-	current_state = wait_to_send;
-	powercycle_turn_radio_on();
-#else
-	powercycle_turn_radio_on();
-	send_packet();
-#endif
+	NETSTACK_RADIO.send(reply, reply_len);
 	}
-    /*
- this function is in mac.c
- mac_call_sent_callback(mac_callback_t sent, void *ptr, int status, int num_tx)
- we should call it when all is finished.. after receiving the last ACK
-     */
-    mac_call_sent_callback(sent, ptr, tx_status, 1);
     }
 
 /*---------------------------------------------------------------------------*/
@@ -299,41 +902,99 @@ static void input_packet(void)
     {
     struct sofa_hdr *hdr;
     struct sofa_data_hdr *data_pkt;
-    uint8_t data[MAX_STROBE_SIZE];
     uint8_t ack[MAX_STROBE_SIZE];
-    int len, data_len, ack_len;
+    int len, data_len, ack_len, slot;
     if (NETSTACK_FRAMER.parse())
 	{
+	hdr = packetbuf_dataptr();
+	// while strobing we only expect strobe acks, anything else is a collision
+	if (current_state == wait_slave_strobe_ack)
+	    {
+	    if (hdr->type == TYPE_STROBE_ACK)
+		{
+		struct sofa_tx_req *req = list_head(tx_queue);
+
+		if (rimeaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &rimeaddr_node_addr) &&
+			is_target(req->targets, req->ntargets, packetbuf_addr(PACKETBUF_ADDR_SENDER)) &&
+			responder_index(packetbuf_addr(PACKETBUF_ADDR_SENDER)) < 0)
+		    {
+		    if (nresponders == 0)
+			{
+			// keep strobing a while for more responders
+			ack_window_end = RTIMER_NOW() + sofamac_config.ack_window_time;
+#if SOFAMAC_STATS
+			stats_histogram(sofamac_stats.ack_time,
+				(1000ul * (rtimer_clock_t)(RTIMER_NOW() - strobe_t0)) / RTIMER_ARCH_SECOND);
+#endif
+			}
+		    // save the address of the receiver
+		    rimeaddr_copy(&responders[nresponders++], packetbuf_addr(PACKETBUF_ADDR_SENDER));
+		    SOFAMAC_STATS_ADD(responders);
+#if WITH_PHASE_OPTIMIZATION
+		    // the receiver woke up shortly before our last strobe
+		    phase_update(&sofa_phase_list, packetbuf_addr(PACKETBUF_ADDR_SENDER), phase_offset(last_strobe_time), MAC_TX_OK);
+#endif
+		    // update FSM
+		    if (nresponders == SOFA_MAX_RESPONDERS)
+			{
+			SET_STATE(wait_slave_packet);
+			}
+		    }
+		else // ACK not for us or from a neighbor we did not target
+		    {
+		    PRINTDEBUG("sofamac: strobe ack for someone else\n");
+		    }
+		}
+	    else // not a STROBE ACK
+		{
+		PRINTDEBUG(
+			"sofamac: expected strobe ack, got data or other type \n");
+		collisions++;
+		}
+	    // let the strobe train end
+	    if (current_state != wait_slave_strobe_ack || collisions > 0)
+		{
+		process_poll(&sofamac_process);
+		}
+	    return;
+	    }
 #if USE_BACKOFF
 	//if we are waiting for sending something and we receive some packets, we stop the sending procedure (the channel is already busy. We switch to idle mode and act as a receiver. If SLEEP_BACKOFF is selected we go instead to sleep.
 	if (current_state == wait_to_send)
 	    {
 	    STOP_BACKOFF ();
+	    SOFAMAC_STATS_ADD(backoff_aborts);
 #if !SLEEP_BACKOFF
-	    current_state = idle;
+	    // the exchange stays queued until our next wake up
+	    SET_STATE(idle);
 #else
-	    if(u->result) u->result(SOFA_BUSY);
+	    exchange_done(SOFA_BUSY);
 #endif
 	    }
 #endif
 
-	hdr = packetbuf_dataptr();
 	if (hdr->type == TYPE_DATA_S)
 	    {
 	    data_pkt = packetbuf_dataptr();
-	    if (rimeaddr_cmp(&(data_pkt->dst), &rimeaddr_node_addr))
+	    if (rimeaddr_cmp(&(data_pkt->dst), &rimeaddr_node_addr) && valid_data_len(data_pkt))
 		{
 		if (current_state == wait_slave_packet)
 		    {
-		    // stop timeout timer
-		    STOP_IDLE ();
-		    // send the received value to the application
-			if(u->recv) {
-    			u->recv(data_pkt->data);
+		    int i = responder_index(packetbuf_addr(PACKETBUF_ADDR_SENDER));
+
+		    if (i < 0 || answered[i])
+			{
+			PRINTDEBUG("sofamac: data from an unexpected slave\n");
+			return;
+			}
+		    answered[i] = 1;
+		    answers++;
+		    // send the received payload to the application
+			if(u != NULL && u->recv) {
+    			u->recv(packetbuf_addr(PACKETBUF_ADDR_SENDER), data_pkt + 1, data_pkt->len);
   			}
 		    PRINTDEBUG(
-			    "sofamac: data(%d) from %d,%d \n", data_pkt->data, packetbuf_addr (PACKETBUF_ADDR_SENDER)->u8[0], packetbuf_addr (PACKETBUF_ADDR_SENDER)->u8[1]);
-		    current_state = idle;
+			    "sofamac: data(%u bytes) from %d,%d \n", data_pkt->len, packetbuf_addr (PACKETBUF_ADDR_SENDER)->u8[0], packetbuf_addr (PACKETBUF_ADDR_SENDER)->u8[1]);
 		    /* send the final ACK */
 		    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, packetbuf_addr(PACKETBUF_ADDR_SENDER));
 		    packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &rimeaddr_node_addr);
@@ -343,6 +1004,7 @@ static void input_packet(void)
 		    if (len == 0 || ack_len > (int) sizeof(ack))
 			{
 			PRINTDEBUG("sofamac: data send failed, too large header\n");
+			exchange_done(SOFA_ERROR);
 			return;
 			}
 		    memcpy(ack, packetbuf_hdrptr(), len);
@@ -351,29 +1013,31 @@ static void input_packet(void)
 		    // this assures that the entire packet is consecutive in memory
 		    packetbuf_compact();
 		    NETSTACK_RADIO.send(ack, ack_len);
-		    // notify the application that the data exchange was successfull
-		    if(u->result) u->result(SOFA_SUCCESS);
-		    current_state = idle;
-		    powercycle_turn_radio_off();
+		    if (answers == nresponders)
+			{
+			// stop timeout timer
+			STOP_IDLE ();
+			// notify the application that the data exchange was successfull
+			exchange_done(SOFA_SUCCESS);
+			}
 		    return;
 		    }
 		else
 		    {
 		    //we are not in a state where we are expecting data
-		    current_state = idle;
-		    // notify the application that the data exchange was not successfull
-		    if(u->result) u->result(SOFA_ERROR);
-		    powercycle_turn_radio_off();
+		    exchange_failed();
 		    return;
 		    }
 		}
+	    else if (current_state == wait_master_packacket_ack)
+		{
+		// another responder of our initiator replied in its slot
+		return;
+		}
 	    else
 		{
 		// the data packet is not for us
-		current_state = idle;
-		// notify the application that the data exchange was not successfull
-		if(u->result) u->result(SOFA_ERROR);
-		powercycle_turn_radio_off();
+		exchange_failed();
 		PRINTDEBUG(
 			"sofamac: data not for us (%d,%d->%d,%d)\n", packetbuf_addr (PACKETBUF_ADDR_SENDER)->u8[0], packetbuf_addr (PACKETBUF_ADDR_SENDER)->u8[1], packetbuf_addr (PACKETBUF_ADDR_RECEIVER)->u8[0], packetbuf_addr (PACKETBUF_ADDR_RECEIVER)->u8[1]);
 		}
@@ -384,63 +1048,72 @@ static void input_packet(void)
 	    PRINTDEBUG(
 		    "sofamac: master data from %d,%d. Destination %d.%d\n",
 		    packetbuf_addr (PACKETBUF_ADDR_SENDER)->u8[0], packetbuf_addr (PACKETBUF_ADDR_SENDER)->u8[1],(data_pkt->dst).u8[0],(data_pkt->dst).u8[1]);
-	    if (rimeaddr_cmp(&(data_pkt->dst), &rimeaddr_node_addr))
+	    if (valid_data_len(data_pkt) && (slot = data_slot(data_pkt)) >= 0)
 		{
 		if (current_state == wait_master_packet)
 		    {
 		    rimeaddr_t dst;
+		    rtimer_clock_t slot_start = RTIMER_NOW();
+
 		    rimeaddr_copy(&dst, packetbuf_addr(PACKETBUF_ADDR_SENDER));
 		    // stop waiting timeout
 		    STOP_IDLE ();
-		    // send the received value to the application
-			if(u->recv) {
-    			u->recv(data_pkt->data);
+		    // send the received payload to the application
+			if(u != NULL && u->recv) {
+    			u->recv(&dst, data_pkt + 1, data_pkt->len);
   			}
 		    // update FSM
-		    current_state = wait_master_packacket_ack;
+		    SET_STATE(wait_master_packacket_ack);
 		    // send our data to the initiator
 		    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &rimeaddr_null);
 		    packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &rimeaddr_node_addr);
 		    // Create the data header for the data packet
 		    len = NETSTACK_FRAMER.create();
 		    data_len = len + sizeof(struct sofa_data_hdr);
-		    if (len == 0 || data_len > (int) sizeof(data))
+		    if (len == 0 || data_len + SOFA_MAX_PAYLOAD > (int) sizeof(reply))
 			{
 			PRINTDEBUG("sofamac: data send failed, too large header\n");
+			goto_idle();
 			return;
 			}
-		    memcpy(data, packetbuf_hdrptr(), len);
-		    data_pkt = (struct sofa_data_hdr *)&(data[len]);
+		    memcpy(reply, packetbuf_hdrptr(), len);
+		    data_pkt = (struct sofa_data_hdr *)&(reply[len]);
 		    data_pkt->type = TYPE_DATA_S;
-		    //ask the application for a value to send
-			if(u->pull_val) {
-    			data_pkt->data = u->pull_val();
+		    //ask the application for a payload to send
+			if(u != NULL && u->pull) {
+    			data_pkt->len = MIN(u->pull(data_pkt + 1, SOFA_MAX_PAYLOAD), SOFA_MAX_PAYLOAD);
   			}
 else{
-		    data_pkt->data = 0;
+		    data_pkt->len = 0;
 }
+		    reply_len = data_len + data_pkt->len;
 		    rimeaddr_copy(&(data_pkt->dst), &dst);
-		    // This assures that the entire packet is consecutive in memory
-		    packetbuf_compact();
-		    NETSTACK_RADIO.send(data, data_len);
+		    // the responders reply one after the other, in the order of the list.
+		    // rtimer_set() masks the rtimer interrupt, so the slot can be armed
+		    // from here while the power cycle rtimer is pending
+		    if (slot == 0)
+			{
+			send_reply(NULL, NULL);
+			}
+		    else
+			{
+			rtimer_set(&slot_rt, slot_start + slot * sofamac_config.slot_time, 1,
+				(void (*)(struct rtimer *, void *)) send_reply, NULL);
+			}
 		    // set timeout for waiting the packet
-		    GOTO_IDLE(MASTER_ACK_WAITING_TIME);
+		    GOTO_IDLE(slot * sofamac_config.slot_time + sofamac_config.master_ack_wait_time);
 		    return;
 		    }
 		else
 		    {
 		    //we received a packet not for us
-		    current_state = idle;
-		    // notify the application that the data exchange was not successfull
-		    if(u->result) u->result(SOFA_ERROR);
-		    powercycle_turn_radio_off();
+		    exchange_failed();
 		    return;
 		    }
 		}
 	    else
 		{
-		current_state = idle;
-		powercycle_turn_radio_off();
+		goto_idle();
 		PRINTDEBUG(
 			"sofamac: data not for us (%d,%d->%d,%d)\n", packetbuf_addr (PACKETBUF_ADDR_SENDER)->u8[0], packetbuf_addr (PACKETBUF_ADDR_SENDER)->u8[1], data_pkt->dst.u8[0], data_pkt->dst.u8[1]);
 		return;
@@ -449,6 +1122,22 @@ else{
 	    }
 	else if (hdr->type == TYPE_STROBE)
 	    {
+	    if (!strobe_targets_us())
+		{
+		// the initiator wants someone else, go back to sleep right
+		// away rather than waiting for the end of our on time
+		if (current_state == idle)
+		    {
+		    SOFAMAC_STATS_ADD(not_targeted);
+		    goto_idle();
+		    }
+		return;
+		}
+	    if (current_state == wait_master_packet && rimeaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_SENDER), &master))
+		{
+		// the initiator we acked is still collecting strobe acks
+		return;
+		}
 #if WITH_RETX
 		if ((current_state == idle) || ((current_state == wait_master_packet) && ((random_rand()%100) < p_retx)))
 #else
@@ -465,26 +1154,26 @@ else{
 			NETSTACK_RADIO.send(packetbuf_hdrptr(), packetbuf_totlen());
 			PRINTDEBUG(
 				"sofamac: send strobe ack to %d,%d\n", packetbuf_addr (PACKETBUF_ADDR_RECEIVER)->u8[0], packetbuf_addr (PACKETBUF_ADDR_RECEIVER)->u8 [1]);
-			current_state = wait_master_packet;
+			rimeaddr_copy(&master, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+			SET_STATE(wait_master_packet);
+			SOFAMAC_STATS_ADD(passive);
 			// set a timeout for waiting data (sender can chose another node to send data)
-			GOTO_IDLE(MASTER_PACKET_WAITING_TIME);
+			GOTO_IDLE(sofamac_config.master_packet_wait_time);
 			return;
 			}
 		    else
 			{
 			PRINTDEBUG(
 				"sofamac: failed to send strobe ack, going back to idle\n");
-			current_state = idle;
-			powercycle_turn_radio_off();
+			goto_idle();
 			return;
 			}
 		    }
 		else
 		    {
 		    PRINTDEBUG("long sofa: stray strobe\n");
-		    current_state = idle;
 		    // since we are not in a idle state, we probably already sent an ack for a strobe. we then turn off our radio since the master is not interested in sending data to us
-		    powercycle_turn_radio_off();
+		    goto_idle();
 		    return;
 		    }
 	    }
@@ -500,40 +1189,42 @@ else{
 		// stop waiting timeout
 		STOP_IDLE ();
 		PRINTF("sofamac: got data ack\n");
-		current_state = idle;
+		SET_STATE(idle);
+		SOFAMAC_STATS_ADD(passive_success);
 		// notify the application that the data exchange was successfull
-		if(u->result) u->result(SOFA_SUCCESS);
+		if(u != NULL && u->result) u->result(SOFA_HANDLE_NONE, SOFA_SUCCESS);
 		powercycle_turn_radio_off();
 		return;
 		}
+	    else if (current_state == wait_master_packacket_ack)
+		{
+		// acks another responder of our initiator
+		return;
+		}
 	    else
 		{
-		current_state = idle;
-		// notify the application that the data exchange was not successfull
-		if(u->result) u->result(SOFA_ERROR);
-		powercycle_turn_radio_off();
+		exchange_failed();
 		PRINTDEBUG("sofamac: stray data ack\n");
 		return;
 		}
 	    }
 	else
 	    {
-	    current_state = idle;
-	    // notify the application that the data exchange was not successfull
-	    if(u->result) u->result(SOFA_ERROR);
-	    powercycle_turn_radio_off();
+	    exchange_failed();
 	    PRINTF(
 		    "sofamac: unknown or unwanted packet type %u (%u)\n", hdr->type, packetbuf_datalen ());
 	    return;
 	    }
 	}
+    else if (current_state == wait_slave_strobe_ack)
+	{
+	PRINTDEBUG(
+		"sofamac: expected strobe ack, packet failed to parse %u\n", packetbuf_totlen ());
+	}
     else
 	{
 	// now we go to sleep if the radio fails to parse the packet. We can also ignore the packets and go on with the mechanism
-	current_state = idle;
-        // notify the application that the data exchange was not successfull
-	if(u->result) u->result(SOFA_ERROR);
-	powercycle_turn_radio_off();
+	exchange_failed();
 	PRINTF("sofamac: failed to parse (%u)\n", packetbuf_totlen ());
 	return;
 	}
@@ -543,27 +1234,32 @@ else{
 void sofamac_init(void)
     {
     PT_INIT(&pt);
-    current_state = idle;
-    CSCHEDULE_POWERCYCLE(DEFAULT_OFF_TIME);
+    SET_STATE(idle);
+#if WITH_PHASE_OPTIMIZATION
+    phase_init(&sofa_phase_list);
+#endif
+    process_start(&sofamac_process, NULL);
+    start_powercycle();
     PRINTDEBUG("Sofamac INIT\n");
     }
 
-void sofamac_tx(uint16_t tx_value)
+/*---------------------------------------------------------------------------*/
+// Queues an exchange of payload with the first neighbor that wakes up. The
+// returned handle is passed to the result callback when it is over. With a
+// NULL payload, the payload is pulled from the application when the
+// exchange starts rather than copied now.
+sofa_handle_t sofamac_tx(const void *payload, uint8_t len)
     {
-    sofa_value = tx_value;
-    if (current_state == idle)
-   	{
-   #if USE_BACKOFF
-   	current_state = wait_to_send;
-   	powercycle_turn_radio_on();
-   #else
-   	powercycle_turn_radio_on();
-   	send_packet();
-   #endif
-	}
-else{
-//notify that we are not in idle mode
-}
+    return enqueue_exchange(NULL, 0, payload, len, NULL, NULL);
+    }
+
+/*---------------------------------------------------------------------------*/
+// Like sofamac_tx(), but only the ntargets neighbors in targets may take
+// part in the exchange
+sofa_handle_t sofamac_tx_to(const rimeaddr_t *targets, uint8_t ntargets,
+	const void *payload, uint8_t len)
+    {
+    return enqueue_exchange(targets, ntargets, payload, len, NULL, NULL);
     }
 
 /*---------------------------------------------------------------------------*/
@@ -571,8 +1267,9 @@ static int turn_on(void)
     {
     if (current_state == disabled)
 	{
-	current_state = enabled;
-	CSCHEDULE_POWERCYCLE(DEFAULT_OFF_TIME);
+	SET_STATE(enabled);
+	PT_INIT(&pt);
+	start_powercycle();
 	}
     PRINTDEBUG("Sofamac ON\n");
     return 1;
@@ -581,26 +1278,106 @@ static int turn_on(void)
 /*---------------------------------------------------------------------------*/
 static int turn_off(int keep_radio_on)
     {
-    current_state = disabled;
+    SET_STATE(disabled);
+    STATS_RADIO(0);
     PRINTDEBUG("Sofamac OFF\n");
     return NETSTACK_RADIO.off();
     }
 
 static void qsend_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
     {
+    struct rdc_buf_list *curr;
 
+    for (curr = buf_list; curr != NULL; curr = list_item_next(curr))
+	{
+	queuebuf_to_packetbuf(curr->buf);
+	qsend_packet(sent, ptr);
+	}
     }
 
 void sofa_register(struct sofa_callback *f){
 u = f;
 }
 
+/*---------------------------------------------------------------------------*/
+// The new timing is used from the first power cycle that starts with no
+// exchange in progress. Returns 0 if the configuration is inconsistent.
+int sofamac_set_config(const struct sofamac_config *config)
+    {
+    if (config->on_time == 0 || config->off_time == 0 ||
+	    config->on_time > SOFA_MAX_TIME || config->off_time > SOFA_MAX_TIME - config->on_time)
+	{
+	PRINTDEBUG("sofamac: invalid period\n");
+	return 0;
+	}
+    // a neighbor waking up must hear at least one strobe of the train, and
+    // each neighbor wakes up once during a train that lasts a whole period
+    if (config->strobe_wait_time == 0 || config->strobe_wait_time > config->on_time ||
+	    config->strobe_time < (rtimer_clock_t)(config->on_time + config->off_time) ||
+	    config->strobe_time > SOFA_MAX_TIME)
+	{
+	PRINTDEBUG("sofamac: invalid strobe timing\n");
+	return 0;
+	}
+    // the first responder must still be waiting when the ack window ends
+    if (SOFA_MAX_RESPONDERS > 1 && (config->slot_time == 0 || config->ack_window_time > SOFA_MAX_TIME ||
+	    config->ack_window_time + config->strobe_wait_time >= config->master_packet_wait_time))
+	{
+	PRINTDEBUG("sofamac: invalid ack window\n");
+	return 0;
+	}
+    memcpy(&next_config, config, sizeof(next_config));
+    config_pending = 1;
+    if (current_state == disabled)
+	{
+	// the power cycle is stopped, nothing can race with us
+	apply_config();
+	}
+    return 1;
+    }
+
+/*---------------------------------------------------------------------------*/
+// the configuration set last, even if it is not in use yet
+void sofamac_get_config(struct sofamac_config *config)
+    {
+    memcpy(config, config_pending ? &next_config : &sofamac_config, sizeof(sofamac_config));
+    }
+
+/*---------------------------------------------------------------------------*/
+void sofamac_stats_reset(void)
+    {
+#if SOFAMAC_STATS
+    stats_radio_time();
+    memset(&sofamac_stats, 0, sizeof(sofamac_stats));
+#endif
+    }
+
+/*---------------------------------------------------------------------------*/
+// Starts the exchanges whose backoff ended in the rtimer power cycle and
+// runs their strobe train
+PROCESS_THREAD(sofamac_process, ev, data)
+    {
+    PROCESS_BEGIN();
+    while (1)
+	{
+	PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+	if (strobing)
+	    {
+	    strobe_train();
+	    }
+	else
+	    {
+	    backoff_expired();
+	    }
+	}
+    PROCESS_END();
+    }
+
 /*---------------------------------------------------------------------------*/
 /** Returns the channel check interval, expressed in clock_time_t ticks. */
 static unsigned short channel_check_interval(void)
     {
-    /*NOTE: DEFAULT_PERIOD=(RTIMER_ARCH_SECOND / NETSTACK_RDC_CHANNEL_CHECK_RATE) CLOCK_SECOND */
-    return (1ul * CLOCK_SECOND * DEFAULT_PERIOD) / RTIMER_ARCH_SECOND;
+    return (1ul * CLOCK_SECOND * PERIOD) / RTIMER_ARCH_SECOND;
     }
 
 /*---------------------------------------------------------------------------*/
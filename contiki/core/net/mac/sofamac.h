@@ -46,6 +46,7 @@
 #include "net/mac/rdc.h"
 #include "dev/radio.h"
 #include "net/rime/rimeaddr.h"
+#include "net/packetbuf.h"
 
 
 //TODO: is this needed???
@@ -77,9 +78,17 @@ struct sofa_hdr {
   uint16_t delay;
 };
 
+// In strobes this header is followed by the number of targeted neighbors
+// and their addresses, only those may answer. No targets means that any
+// neighbor may answer.
+
+// Data frames carry a variable-length application payload of len bytes
+// right after this header. A master data frame sent to several responders
+// is addressed to the first one, and the payload is followed by the number
+// of responders and their addresses: the i-th one replies in slot i.
 struct sofa_data_hdr {
   uint8_t type;
-  uint16_t data;
+  uint8_t len;
   rimeaddr_t dst;
 };
 
@@ -87,6 +96,9 @@ struct sofa_data_hdr {
 #define SOFA_SUCCESS 1
 #define SOFA_ERROR 2
 #define SOFA_BUSY 3
+#define SOFA_NOACK 4
+// only some of the responders answered before the timeout
+#define SOFA_PARTIAL 5
 
 // SOFA's message types
 #define DISPATCH          0
@@ -97,8 +109,44 @@ struct sofa_data_hdr {
 #define TYPE_DATA_ACK     5
 
 // SOFA PARAMETERS
-#define MAX_STROBE_SIZE 50
-#define DEFAULT_PERIOD (RTIMER_ARCH_SECOND)
+// An 802.15.4 frame carries at most 127 bytes, 2 of them for the FCS, and
+// is received whole into the packetbuf
+#define SOFA_MAX_FRAME_SIZE (PACKETBUF_SIZE < 125 ? PACKETBUF_SIZE : 125)
+// The longest header of framer-802154: frame control, sequence number,
+// both PAN ids and both addresses
+#define SOFA_MAX_FRAMER_HDR_SIZE (7 + 2 * sizeof(rimeaddr_t))
+// Largest application payload carried by a data frame. The default is
+// what is left of a frame to the responders with the longest header.
+#ifdef SOFAMAC_CONF_MAX_PAYLOAD
+#define SOFA_MAX_PAYLOAD SOFAMAC_CONF_MAX_PAYLOAD
+#else
+#define SOFA_MAX_PAYLOAD ((int)(SOFA_MAX_FRAME_SIZE - SOFA_MAX_FRAMER_HDR_SIZE - \
+	sizeof(struct sofa_data_hdr) - 1 - SOFA_MAX_RESPONDERS * sizeof(rimeaddr_t)))
+#endif
+// Largest number of neighbors an exchange can be targeted at
+#ifdef SOFAMAC_CONF_MAX_TARGETS
+#define SOFA_MAX_TARGETS SOFAMAC_CONF_MAX_TARGETS
+#else
+#define SOFA_MAX_TARGETS 4
+#endif
+// Largest number of strobe acks the initiator collects before exchanging
+// with all the responders at once
+#ifdef SOFAMAC_CONF_MAX_RESPONDERS
+#define SOFA_MAX_RESPONDERS SOFAMAC_CONF_MAX_RESPONDERS
+#else
+#define SOFA_MAX_RESPONDERS 1
+#endif
+// a strobe carries the target list of the exchange, and the acks reuse
+// the buffer of the strobes
+#define MAX_STROBE_SIZE (PACKETBUF_HDR_SIZE + sizeof(struct sofa_hdr) + \
+	1 + SOFA_MAX_TARGETS * sizeof(rimeaddr_t))
+#define MAX_DATA_SIZE (PACKETBUF_HDR_SIZE + sizeof(struct sofa_data_hdr) + SOFA_MAX_PAYLOAD + \
+	1 + SOFA_MAX_RESPONDERS * sizeof(rimeaddr_t))
+// The rtimer only orders times less than half its range apart, the period
+// and the strobe train must be shorter
+#define SOFA_MAX_TIME ((rtimer_clock_t)~0 >> 1)
+// one second, or less with a 16-bit rtimer at 32768 Hz
+#define DEFAULT_PERIOD (RTIMER_ARCH_SECOND < SOFA_MAX_TIME ? RTIMER_ARCH_SECOND : SOFA_MAX_TIME)
 #define DEFAULT_ON_TIME (RTIMER_ARCH_SECOND / 200)
 #define DEFAULT_OFF_TIME (DEFAULT_PERIOD - DEFAULT_ON_TIME)
 #define DEFAULT_STROBE_WAIT_TIME DEFAULT_ON_TIME
@@ -107,34 +155,103 @@ struct sofa_data_hdr {
 #define MASTER_ACK_WAITING_TIME (5 * DEFAULT_ON_TIME)
 #define SLAVE_PACKET_WAITING_TIME (5 * DEFAULT_ON_TIME)
 #define MASTER_BACKOFF_WAITING_TIME DEFAULT_ON_TIME*2
+// after the first strobe ack, keep strobing this long for more responders
+#define DEFAULT_ACK_WINDOW_TIME (2 * DEFAULT_ON_TIME)
+// a reply slot fits a full frame and its ack at 250 kbit/s
+#define DEFAULT_SLOT_TIME (RTIMER_ARCH_SECOND / 128)
 
 /* On some platforms, we may end up with a DEFAULT_PERIOD that is 0
    which will make compilation fail due to a modulo operation in the
    code. To ensure that DEFAULT_PERIOD is greater than zero, we use
    the construct below. */
-#if DEFAULT_PERIOD == 0
+#if RTIMER_ARCH_SECOND == 0
 #undef DEFAULT_PERIOD
 #define DEFAULT_PERIOD 1
 #endif
 
 /*---------------------------------------------------------------------------*/
+// SOFA timing in rtimer ticks, the period is on_time + off_time. The
+// period and the strobe train last at most SOFA_MAX_TIME.
 struct sofamac_config {
   rtimer_clock_t on_time;
   rtimer_clock_t off_time;
   rtimer_clock_t strobe_time;
   rtimer_clock_t strobe_wait_time;
+  rtimer_clock_t master_packet_wait_time;
+  rtimer_clock_t master_ack_wait_time;
+  rtimer_clock_t slave_packet_wait_time;
+  rtimer_clock_t backoff_time;
+  rtimer_clock_t ack_window_time;
+  rtimer_clock_t slot_time;
 };
 
+// identifies an exchange queued by sofamac_tx()
+typedef uint8_t sofa_handle_t;
+// handle of the failed calls to sofamac_tx() and of the exchanges
+// initiated by our neighbors
+#define SOFA_HANDLE_NONE 0
+
+// recv gets the payload of the neighbor we exchanged with, pull fills
+// at most maxlen bytes with the payload to answer with, or to start an
+// exchange queued without a payload, and returns its length
 struct sofa_callback{
-void(* recv)(uint16_t rx_value);
-uint16_t (* pull_val)(void);
-void (* result)(uint16_t ret_value);
+void(* recv)(const rimeaddr_t *from, const void *payload, uint8_t len);
+uint8_t (* pull)(void *payload, uint8_t maxlen);
+void (* result)(sofa_handle_t handle, uint16_t ret_value);
 };
 
 
+/*---------------------------------------------------------------------------*/
+// SOFA statistics, enabled with SOFAMAC_CONF_STATS
+#ifdef SOFAMAC_CONF_STATS
+#define SOFAMAC_STATS SOFAMAC_CONF_STATS
+#else
+#define SOFAMAC_STATS 0
+#endif
+
+// bin 0 counts the durations below 1 ms, bin i those in [2^(i-1), 2^i) ms
+// and the last bin everything above
+#define SOFA_STATS_BINS 12
+#define SOFA_STATS_STATES (wait_to_send + 1)
+
+struct sofamac_stats {
+  // exchanges we initiated and their outcomes, success includes the
+  // exchanges where only some of the responders answered
+  unsigned long exchanges, success, noack, busy, error;
+  // exchanges that could not be queued
+  unsigned long queue_full;
+  // strobes sent, strobe trains aborted by a collision and backoffs
+  // aborted because the channel was busy
+  unsigned long strobes, collisions, backoff_aborts;
+  // strobe acks collected, as many as the neighbors we exchanged with
+  unsigned long responders;
+  // exchanges initiated by our neighbors and their outcomes
+  unsigned long passive, passive_success, passive_error;
+  // strobes we did not answer because they targeted other neighbors
+  unsigned long not_targeted;
+  // radio on time in each FSM state, in rtimer ticks
+  unsigned long radio_on[SOFA_STATS_STATES];
+  // from the start of the strobe train to the strobe ack
+  unsigned long ack_time[SOFA_STATS_BINS];
+  // from sofamac_tx() to the end of the exchange
+  unsigned long latency[SOFA_STATS_BINS];
+};
+
+#if SOFAMAC_STATS
+extern struct sofamac_stats sofamac_stats;
+#define SOFAMAC_STATS_ADD(x) sofamac_stats.x++
+#else
+#define SOFAMAC_STATS_ADD(x)
+#endif
+
 extern const struct rdc_driver sofamac_driver;
 int send_packet(void);
 void sofa_register(struct sofa_callback *);
-void sofamac_tx(uint16_t);
+sofa_handle_t sofamac_tx(const void *payload, uint8_t len);
+sofa_handle_t sofamac_tx_to(const rimeaddr_t *targets, uint8_t ntargets,
+	const void *payload, uint8_t len);
+int sofamac_set_config(const struct sofamac_config *config);
+void sofamac_get_config(struct sofamac_config *config);
+void sofamac_stats_reset(void);
 
 #endif /* __SOFAMAC_H__ */
@@ -47,6 +47,7 @@
 #include "contiki-net.h"
 #include "net/packetbuf.h"
 #include "net/rime.h"
+#include "lib/memb.h"
 
 struct packetbuf_attr packetbuf_attrs[PACKETBUF_NUM_ATTRS];
 struct packetbuf_addr packetbuf_addrs[PACKETBUF_NUM_ADDRS];
@@ -55,6 +56,42 @@ struct packetbuf_addr packetbuf_addrs[PACKETBUF_NUM_ADDRS];
 static uint16_t buflen, bufptr;
 static uint8_t hdrptr;
 
+#if PACKETBUF_POOL
+/* A frame has PACKETBUF_HDR_SIZE bytes of headroom in front of the
+   packetbuf, so that a packet held with its headers is restored with
+   a whole header space in front of it */
+#define FRAME_SIZE (2 * PACKETBUF_HDR_SIZE + PACKETBUF_SIZE)
+
+struct frame {
+  /* Aligned on an even 16-bit boundary, like the packetbuf below */
+  uint16_t data[FRAME_SIZE / 2 + 1];
+  /* The first byte used by a held packet */
+  uint16_t low;
+  /* The held packets and the packetbuf that refer to the frame */
+  uint8_t refs;
+};
+
+/* Each packet held by a queuebuf may have a frame of its own, and
+   the packetbuf needs one more */
+#ifdef PACKETBUF_CONF_POOL_NUM
+#define PACKETBUF_POOL_NUM PACKETBUF_CONF_POOL_NUM
+#else
+#define PACKETBUF_POOL_NUM (QUEUEBUF_NUM + 1)
+#endif
+#if PACKETBUF_POOL_NUM < QUEUEBUF_NUM + 1
+#error "PACKETBUF_CONF_POOL_NUM must be larger than QUEUEBUF_NUM"
+#endif
+
+MEMB(frame_memb, struct frame, PACKETBUF_POOL_NUM);
+
+/* The frame of the packetbuf and the offset of the packetbuf in it */
+static struct frame *frame;
+static uint16_t base;
+static uint8_t *packetbuf;
+
+/* The packetbuf gets its first frame when it is first used */
+#define CHECK_FRAME() do { if(frame == NULL) { packetbuf_clear(); } } while(0)
+#else /* PACKETBUF_POOL */
 /* The declarations below ensure that the packet buffer is aligned on
    an even 16-bit boundary. On some platforms (most notably the
    msp430), having apotentially misaligned packet buffer may lead to
@@ -62,8 +99,15 @@ static uint8_t hdrptr;
 static uint16_t packetbuf_aligned[(PACKETBUF_SIZE + PACKETBUF_HDR_SIZE) / 2 + 1];
 static uint8_t *packetbuf = (uint8_t *)packetbuf_aligned;
 
+#define CHECK_FRAME()
+#endif /* PACKETBUF_POOL */
+
 static uint8_t *packetbufptr;
 
+#if PACKETBUF_STATS
+struct packetbuf_stats packetbuf_stats;
+#endif /* PACKETBUF_STATS */
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -72,10 +116,97 @@ static uint8_t *packetbufptr;
 #define PRINTF(...)
 #endif
 
+#if PACKETBUF_POOL
+/*---------------------------------------------------------------------------*/
+static struct frame *
+frame_alloc(void)
+{
+  struct frame *f;
+
+  f = memb_alloc(&frame_memb);
+  if(f != NULL) {
+    f->refs = 1;
+    f->low = FRAME_SIZE;
+  }
+  return f;
+}
+/*---------------------------------------------------------------------------*/
+static void
+frame_release(struct frame *f)
+{
+  if(--f->refs == 0) {
+    memb_free(&frame_memb, f);
+  } else if(f->refs == 1 && f == frame) {
+    /* Only the packetbuf is left */
+    f->low = FRAME_SIZE;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_frame(struct frame *f, uint16_t offset)
+{
+  int reference;
+
+  reference = frame != NULL && packetbuf_is_reference();
+  frame = f;
+  base = offset;
+  packetbuf = (uint8_t *)f->data + offset;
+  if(!reference) {
+    packetbufptr = &packetbuf[PACKETBUF_HDR_SIZE];
+  }
+}
+#endif /* PACKETBUF_POOL */
+/*---------------------------------------------------------------------------*/
+int
+packetbuf_unshare(void)
+{
+#if PACKETBUF_POOL
+  struct frame *f, *old;
+
+  CHECK_FRAME();
+  if(frame->refs == 1) {
+    return 1;
+  }
+  f = frame_alloc();
+  if(f == NULL) {
+    PRINTF("packetbuf: no frame left to copy to\n");
+    return 0;
+  }
+  PACKETBUF_STATS_ADD(unshared, 1);
+  memcpy((uint8_t *)f->data + base + hdrptr, packetbuf + hdrptr,
+         PACKETBUF_HDR_SIZE - hdrptr);
+  PACKETBUF_STATS_ADD(copied, PACKETBUF_HDR_SIZE - hdrptr);
+  if(!packetbuf_is_reference()) {
+    memcpy((uint8_t *)f->data + base + PACKETBUF_HDR_SIZE + bufptr,
+           packetbufptr + bufptr, buflen);
+    PACKETBUF_STATS_ADD(copied, buflen);
+  }
+  old = frame;
+  set_frame(f, base);
+  frame_release(old);
+#endif /* PACKETBUF_POOL */
+  return 1;
+}
 /*---------------------------------------------------------------------------*/
 void
 packetbuf_clear(void)
 {
+#if PACKETBUF_POOL
+  struct frame *old;
+
+  old = frame;
+  if(old == NULL || old->refs > 1) {
+    /* The pool has a frame for each held packet, so that there always
+       is one left here */
+    set_frame(frame_alloc(), PACKETBUF_HDR_SIZE);
+    if(old != NULL) {
+      frame_release(old);
+    }
+  } else {
+    old->low = FRAME_SIZE;
+    set_frame(old, PACKETBUF_HDR_SIZE);
+  }
+#endif /* PACKETBUF_POOL */
   buflen = bufptr = 0;
   hdrptr = PACKETBUF_HDR_SIZE;
 
@@ -97,6 +228,7 @@ packetbuf_copyfrom(const void *from, uint16_t len)
   packetbuf_clear();
   l = len > PACKETBUF_SIZE? PACKETBUF_SIZE: len;
   memcpy(packetbufptr, from, l);
+  PACKETBUF_STATS_ADD(copied, l);
   buflen = l;
   return l;
 }
@@ -106,14 +238,32 @@ packetbuf_compact(void)
 {
   int i, len;
 
+  CHECK_FRAME();
+#if PACKETBUF_POOL
+  if((packetbuf_is_reference() || bufptr > 0) && !packetbuf_unshare()) {
+    return;
+  }
+#endif /* PACKETBUF_POOL */
   if(packetbuf_is_reference()) {
     memcpy(&packetbuf[PACKETBUF_HDR_SIZE], packetbuf_reference_ptr(),
 	   packetbuf_datalen());
+    PACKETBUF_STATS_ADD(copied, packetbuf_datalen());
+#if PACKETBUF_POOL
+  } else if(bufptr > 0 && packetbuf_hdrlen() < packetbuf_datalen()) {
+    /* Move the header up to the data instead, the data stays where it
+       is in the frame */
+    memmove(packetbuf + hdrptr + bufptr, packetbuf + hdrptr,
+            packetbuf_hdrlen());
+    PACKETBUF_STATS_ADD(moved, packetbuf_hdrlen());
+    set_frame(frame, base + bufptr);
+    bufptr = 0;
+#endif /* PACKETBUF_POOL */
   } else if(bufptr > 0) {
     len = packetbuf_datalen() + PACKETBUF_HDR_SIZE;
     for(i = PACKETBUF_HDR_SIZE; i < len; i++) {
       packetbuf[i] = packetbuf[bufptr + i];
     }
+    PACKETBUF_STATS_ADD(moved, packetbuf_datalen());
 
     bufptr = 0;
   }
@@ -122,6 +272,7 @@ packetbuf_compact(void)
 int
 packetbuf_copyto_hdr(uint8_t *to)
 {
+  CHECK_FRAME();
 #if DEBUG_LEVEL > 0
   {
     int i;
@@ -133,12 +284,14 @@ packetbuf_copyto_hdr(uint8_t *to)
   }
 #endif /* DEBUG_LEVEL */
   memcpy(to, packetbuf + hdrptr, PACKETBUF_HDR_SIZE - hdrptr);
+  PACKETBUF_STATS_ADD(copied, PACKETBUF_HDR_SIZE - hdrptr);
   return PACKETBUF_HDR_SIZE - hdrptr;
 }
 /*---------------------------------------------------------------------------*/
 int
 packetbuf_copyto(void *to)
 {
+  CHECK_FRAME();
 #if DEBUG_LEVEL > 0
   {
     int i;
@@ -165,13 +318,22 @@ packetbuf_copyto(void *to)
   memcpy(to, packetbuf + hdrptr, PACKETBUF_HDR_SIZE - hdrptr);
   memcpy((uint8_t *)to + PACKETBUF_HDR_SIZE - hdrptr, packetbufptr + bufptr,
 	 buflen);
+  PACKETBUF_STATS_ADD(copied, PACKETBUF_HDR_SIZE - hdrptr + buflen);
   return PACKETBUF_HDR_SIZE - hdrptr + buflen;
 }
 /*---------------------------------------------------------------------------*/
 int
 packetbuf_hdralloc(int size)
 {
+  CHECK_FRAME();
   if(hdrptr >= size && packetbuf_totlen() + size <= PACKETBUF_SIZE) {
+#if PACKETBUF_POOL
+    /* The new header goes in front of the held packets, unless one of
+       them starts further down in the frame */
+    if(frame->refs > 1 && base + hdrptr > frame->low && !packetbuf_unshare()) {
+      return 0;
+    }
+#endif /* PACKETBUF_POOL */
     hdrptr -= size;
     return 1;
   }
@@ -206,12 +368,14 @@ packetbuf_set_datalen(uint16_t len)
 void *
 packetbuf_dataptr(void)
 {
+  CHECK_FRAME();
   return (void *)(&packetbuf[bufptr + PACKETBUF_HDR_SIZE]);
 }
 /*---------------------------------------------------------------------------*/
 void *
 packetbuf_hdrptr(void)
 {
+  CHECK_FRAME();
   return (void *)(&packetbuf[hdrptr]);
 }
 /*---------------------------------------------------------------------------*/
@@ -253,6 +417,70 @@ packetbuf_totlen(void)
   return packetbuf_hdrlen() + packetbuf_datalen();
 }
 /*---------------------------------------------------------------------------*/
+#if PACKETBUF_POOL
+int
+packetbuf_hold(struct packetbuf_held *h)
+{
+  packetbuf_compact();
+  h->frame = frame;
+  h->offset = base + hdrptr;
+  frame->refs++;
+  if(h->offset < frame->low) {
+    frame->low = h->offset;
+  }
+  PACKETBUF_STATS_ADD(held, 1);
+  if(packetbuf_totlen() > PACKETBUF_SIZE) {
+    /* Too large packet */
+    return 0;
+  }
+  return packetbuf_totlen();
+}
+/*---------------------------------------------------------------------------*/
+void
+packetbuf_restore(struct packetbuf_held *h, uint16_t len)
+{
+  struct frame *f, *old;
+
+  f = h->frame;
+  if(h->offset < PACKETBUF_HDR_SIZE) {
+    /* Too little headroom left in front of the packet */
+    packetbuf_copyfrom((uint8_t *)f->data + h->offset, len);
+    return;
+  }
+  f->refs++;
+  old = frame;
+  set_frame(f, h->offset - PACKETBUF_HDR_SIZE);
+  if(old != NULL) {
+    frame_release(old);
+  }
+  buflen = len;
+  bufptr = 0;
+  hdrptr = PACKETBUF_HDR_SIZE;
+  packetbufptr = &packetbuf[PACKETBUF_HDR_SIZE];
+  packetbuf_attr_clear();
+}
+/*---------------------------------------------------------------------------*/
+void
+packetbuf_release(struct packetbuf_held *h)
+{
+  frame_release(h->frame);
+}
+/*---------------------------------------------------------------------------*/
+void *
+packetbuf_held_ptr(struct packetbuf_held *h)
+{
+  return (uint8_t *)((struct frame *)h->frame)->data + h->offset;
+}
+#endif /* PACKETBUF_POOL */
+/*---------------------------------------------------------------------------*/
+void
+packetbuf_stats_reset(void)
+{
+#if PACKETBUF_STATS
+  memset(&packetbuf_stats, 0, sizeof(packetbuf_stats));
+#endif /* PACKETBUF_STATS */
+}
+/*---------------------------------------------------------------------------*/
 void
 packetbuf_attr_clear(void)
 {
@@ -271,6 +499,8 @@ packetbuf_attr_copyto(struct packetbuf_attr *attrs,
 {
   memcpy(attrs, packetbuf_attrs, sizeof(packetbuf_attrs));
   memcpy(addrs, packetbuf_addrs, sizeof(packetbuf_addrs));
+  PACKETBUF_STATS_ADD(attr_copied,
+                      sizeof(packetbuf_attrs) + sizeof(packetbuf_addrs));
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -279,6 +509,8 @@ packetbuf_attr_copyfrom(struct packetbuf_attr *attrs,
 {
   memcpy(packetbuf_attrs, attrs, sizeof(packetbuf_attrs));
   memcpy(packetbuf_addrs, addrs, sizeof(packetbuf_addrs));
+  PACKETBUF_STATS_ADD(attr_copied,
+                      sizeof(packetbuf_attrs) + sizeof(packetbuf_addrs));
 }
 /*---------------------------------------------------------------------------*/
 #if !PACKETBUF_CONF_ATTRS_INLINE
@@ -8,6 +8,13 @@
  * @{
  *
  * The packetbuf module does Rime's buffer management.
+ *
+ * With the packetbuf pool (PACKETBUF_CONF_POOL), the packet in the
+ * packetbuf may share its frame with a queued packet. Code that writes
+ * into the packetbuf in place, other than into a header it has just
+ * allocated with packetbuf_hdralloc(), must call packetbuf_unshare()
+ * first and take its pointers into the packetbuf again afterwards.
+ * Otherwise the write also changes the queued packet.
  */
 
 /*
@@ -73,6 +80,48 @@
 #define PACKETBUF_HDR_SIZE 48
 #endif
 
+/**
+ * \brief      Keep packets in a pool of reference counted frames
+ *
+ *             With the pool, the packetbuf is one of several frames
+ *             that queued packets share with it: queueing, restoring
+ *             and retransmitting a packet only pass a reference
+ *             around, and the headers of the lower layers are
+ *             prepended in the headroom of the frame. A frame is
+ *             copied only before writing into a part of it that a
+ *             queued packet still uses.
+ */
+#ifdef PACKETBUF_CONF_POOL
+#define PACKETBUF_POOL PACKETBUF_CONF_POOL
+#else
+#define PACKETBUF_POOL 0
+#endif
+
+/**
+ * \brief      Count the bytes copied in and out of the packetbuf
+ */
+#ifdef PACKETBUF_CONF_STATS
+#define PACKETBUF_STATS PACKETBUF_CONF_STATS
+#else
+#define PACKETBUF_STATS 0
+#endif
+
+struct packetbuf_stats {
+  /* packet bytes copied and moved, and attribute bytes copied */
+  unsigned long copied, moved, attr_copied;
+  /* packets held in a frame and frames copied before a write */
+  unsigned long held, unshared;
+};
+
+#if PACKETBUF_STATS
+extern struct packetbuf_stats packetbuf_stats;
+#define PACKETBUF_STATS_ADD(x, n) packetbuf_stats.x += (n)
+#else
+#define PACKETBUF_STATS_ADD(x, n)
+#endif
+
+void packetbuf_stats_reset(void);
+
 /**
  * \brief      Clear and reset the packetbuf
  *
@@ -313,6 +362,57 @@ int packetbuf_hdralloc(int size);
  */
 int packetbuf_hdrreduce(int size);
 
+#if PACKETBUF_POOL
+/* A packet held in a frame of the pool */
+struct packetbuf_held {
+  void *frame;
+  uint16_t offset;
+};
+
+/**
+ * \brief      Hold the packet in the packetbuf without copying it
+ * \param h    The packet to hold
+ * \retval     The length of the packet, header and data, or zero if it is too large
+ *
+ *             The packet is compacted and its frame is referenced by
+ *             h until packetbuf_release() is called. The packetbuf
+ *             may still be used afterwards.
+ */
+int packetbuf_hold(struct packetbuf_held *h);
+
+/**
+ * \brief      Put a held packet back in the packetbuf
+ * \param h    The packet held with packetbuf_hold()
+ * \param len  The length returned by packetbuf_hold()
+ *
+ *             Like packetbuf_copyfrom(), the whole packet is put in
+ *             the data portion of the packetbuf and the attributes are
+ *             cleared, but the packetbuf refers to the frame of the
+ *             packet instead of copying it.
+ */
+void packetbuf_restore(struct packetbuf_held *h, uint16_t len);
+
+void packetbuf_release(struct packetbuf_held *h);
+void *packetbuf_held_ptr(struct packetbuf_held *h);
+#endif /* PACKETBUF_POOL */
+
+/**
+ * \brief      Give the packetbuf a frame of its own
+ * \retval     Non-zero if the packetbuf has a frame of its own, zero otherwise
+ *
+ *             With the packetbuf pool, the packet in the packetbuf may
+ *             still be held by a queued packet after
+ *             queuebuf_new_from_packetbuf() or
+ *             queuebuf_to_packetbuf(). This function copies it to a
+ *             frame of its own, and must be called before writing into
+ *             its data or header anywhere but in a header just
+ *             allocated with packetbuf_hdralloc(). Pointers to the
+ *             packetbuf must be taken again afterwards.
+ *
+ *             Without the pool, the function does nothing.
+ */
+int packetbuf_unshare(void);
+
 /* Packet attributes stuff below: */
 
 typedef uint16_t packetbuf_attr_t;
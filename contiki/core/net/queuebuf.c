@@ -75,10 +75,19 @@ struct queuebuf {
 #endif
 };
 
+#if PACKETBUF_POOL && WITH_SWAP
+#error "A packetbuf pool cannot be swapped to CFS"
+#endif
+
 /* The actual queuebuf data */
 struct queuebuf_data {
   uint16_t len;
+#if PACKETBUF_POOL
+  /* The packet stays in its packetbuf frame */
+  struct packetbuf_held held;
+#else /* PACKETBUF_POOL */
   uint8_t data[PACKETBUF_SIZE];
+#endif /* PACKETBUF_POOL */
   struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
   struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
 };
@@ -361,7 +370,11 @@ queuebuf_new_from_packetbuf(void)
       buframptr = buf->ram_ptr;
 #endif
 
+#if PACKETBUF_POOL
+      buframptr->len = packetbuf_hold(&buframptr->held);
+#else /* PACKETBUF_POOL */
       buframptr->len = packetbuf_copyto(buframptr->data);
+#endif /* PACKETBUF_POOL */
       packetbuf_attr_copyto(buframptr->attrs, buframptr->addrs);
 
 #if WITH_SWAP
@@ -379,6 +392,9 @@ queuebuf_new_from_packetbuf(void)
       PRINTF("queuebuf len %d\n", queuebuf_len);
       printf("#A q=%d\n", queuebuf_len);
       if(queuebuf_len == queuebuf_max_len + 1) {
+#if PACKETBUF_POOL
+  packetbuf_release(&buframptr->held);
+#endif /* PACKETBUF_POOL */
   memb_free(&bufmem, buf);
   queuebuf_len--;
   return NULL;
@@ -415,6 +431,9 @@ queuebuf_free(struct queuebuf *buf)
       queuebuf_remove_from_file(buf->swap_id);
     }
 #else
+#if PACKETBUF_POOL
+    packetbuf_release(&buf->ram_ptr->held);
+#endif /* PACKETBUF_POOL */
     memb_free(&buframmem, buf->ram_ptr);
 #endif
     memb_free(&bufmem, buf);
@@ -439,7 +458,11 @@ queuebuf_to_packetbuf(struct queuebuf *b)
   struct queuebuf_ref *r;
   if(memb_inmemb(&bufmem, b)) {
     struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
+#if PACKETBUF_POOL
+    packetbuf_restore(&buframptr->held, buframptr->len);
+#else /* PACKETBUF_POOL */
     packetbuf_copyfrom(buframptr->data, buframptr->len);
+#endif /* PACKETBUF_POOL */
     packetbuf_attr_copyfrom(buframptr->attrs, buframptr->addrs);
   } else if(memb_inmemb(&refbufmem, b)) {
     r = (struct queuebuf_ref *)b;
@@ -447,6 +470,7 @@ queuebuf_to_packetbuf(struct queuebuf *b)
     packetbuf_copyfrom(r->ref, r->len);
     packetbuf_hdralloc(r->hdrlen);
     memcpy(packetbuf_hdrptr(), r->hdr, r->hdrlen);
+    PACKETBUF_STATS_ADD(copied, r->hdrlen);
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -457,7 +481,11 @@ queuebuf_dataptr(struct queuebuf *b)
 
   if(memb_inmemb(&bufmem, b)) {
     struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
+#if PACKETBUF_POOL
+    return packetbuf_held_ptr(&buframptr->held);
+#else /* PACKETBUF_POOL */
     return buframptr->data;
+#endif /* PACKETBUF_POOL */
   } else if(memb_inmemb(&refbufmem, b)) {
     r = (struct queuebuf_ref *)b;
     return r->ref;
@@ -632,6 +632,8 @@ send_queued_packet(struct collect_conn *c)
          packet. */
       memset(&hdr, 0, sizeof(hdr));
       hdr.rtmetric = c->rtmetric;
+      /* The packet is still on the send queue */
+      packetbuf_unshare();
       memcpy(packetbuf_dataptr(), &hdr, sizeof(struct data_msg_hdr));
 
       /* Send the packet. */
@@ -733,6 +735,8 @@ retransmit_current_packet(struct collect_conn *c)
          packet. */
       memset(&hdr, 0, sizeof(hdr));
       hdr.rtmetric = c->rtmetric;
+      /* The packet is still on the send queue */
+      packetbuf_unshare();
       memcpy(packetbuf_dataptr(), &hdr, sizeof(struct data_msg_hdr));
 
       /* Send the packet. */
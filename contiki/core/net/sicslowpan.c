@@ -225,36 +225,48 @@ static int last_tx_status;
  *  @{
  */
 
+/** The total length of the IPv6 packet in the sicslowpan_buf. */
 static uint16_t sicslowpan_len;
 
 /**
- * The buffer used for the 6lowpan reassembly.
- * This buffer contains only the IPv6 packet (no MAC header, 6lowpan, etc).
- * It has a fix size as we do not use dynamic memory allocation.
+ * The buffer the received packet is uncompressed to: uip_buf for a
+ * packet that is not fragmented, or the buffer of its reassembly.
  */
-static uip_buf_t sicslowpan_aligned_buf;
-#define sicslowpan_buf (sicslowpan_aligned_buf.u8)
+static uint8_t *sicslowpan_buf;
 
-/** The total length of the IPv6 packet in the sicslowpan_buf. */
+/** Number of 8 bytes units in a reassembly buffer. */
+#define REASS_UNITS ((UIP_BUFSIZE - UIP_LLH_LEN + 7) / 8)
 
 /**
- * length of the ip packet already sent / received.
- * It includes IP and transport headers.
+ * A datagram being reassembled. Fragments are identified by their
+ * sender, tag and datagram size and may arrive in any order.
  */
-static uint16_t processed_ip_in_len;
+struct sicslowpan_reass {
+  /**
+   * The buffer used for the 6lowpan reassembly.
+   * This buffer contains only the IPv6 packet (no MAC header, 6lowpan, etc).
+   * It has a fix size as we do not use dynamic memory allocation.
+   */
+  uip_buf_t buf;
+  /** The source address of the fragments being merged */
+  rimeaddr_t sender;
+  /** Reassembly timer, started by the first fragment received */
+  struct timer timer;
+  /** The tag in the fragments being merged. */
+  uint16_t tag;
+  /** Size of the datagram, zero if the reassembly is not in use */
+  uint16_t size;
+  /** Number of 8 bytes units of the datagram received so far */
+  uint16_t received;
+  /** Bitmap of the 8 bytes units received so far */
+  uint8_t units[(REASS_UNITS + 7) / 8];
+};
+
+static struct sicslowpan_reass reass[SICSLOWPAN_REASS_CONTEXTS];
 
 /** Datagram tag to be put in the fragments I send. */
 static uint16_t my_tag;
 
-/** When reassembling, the tag in the fragments being merged. */
-static uint16_t reass_tag;
-
-/** When reassembling, the source address of the fragments being merged */
-rimeaddr_t frag_sender;
-
-/** Reassembly %process %timer. */
-static struct timer reass_timer;
-
 /** @} */
 #else /* SICSLOWPAN_CONF_FRAG */
 /** The buffer used for the 6lowpan processing is uip_buf.
@@ -263,6 +275,108 @@ static struct timer reass_timer;
 #define sicslowpan_len uip_len
 #endif /* SICSLOWPAN_CONF_FRAG */
 
+#if SICSLOWPAN_CONF_FRAG
+/*--------------------------------------------------------------------*/
+/** \brief Free the reassemblies that timed out */
+static void
+reass_expire(void)
+{
+  struct sicslowpan_reass *r;
+
+  for(r = reass; r < &reass[SICSLOWPAN_REASS_CONTEXTS]; r++) {
+    if(r->size > 0 && timer_expired(&r->timer)) {
+      PRINTFI("sicslowpan input: reassembly of tag %d timed out\n", r->tag);
+      UIP_STAT(++uip_stat.sicslowpan.reasstimeout);
+      r->size = 0;
+    }
+  }
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Find the reassembly a fragment belongs to, or start one
+ * \param tag The datagram tag of the fragment
+ * \param size The datagram size of the fragment
+ * \param first Non zero for a FRAG1
+ * \return The reassembly, or NULL if the fragment must be dropped
+ *
+ * Only a FRAG1 may take the place of the oldest reassembly when all
+ * are in use: senders send the fragments of a datagram in order, so
+ * the first one is the best sign that the datagram is still alive.
+ */
+static struct sicslowpan_reass *
+reass_lookup(uint16_t tag, uint16_t size, uint8_t first)
+{
+  const rimeaddr_t *sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  struct sicslowpan_reass *r, *free = NULL, *oldest = NULL;
+  clock_time_t now = clock_time();
+
+  for(r = reass; r < &reass[SICSLOWPAN_REASS_CONTEXTS]; r++) {
+    if(r->size == 0) {
+      free = r;
+    } else if(r->size == size && r->tag == tag &&
+              rimeaddr_cmp(&r->sender, sender)) {
+      return r;
+    } else if(oldest == NULL ||
+              (clock_time_t)(now - r->timer.start) >
+              (clock_time_t)(now - oldest->timer.start)) {
+      oldest = r;
+    }
+  }
+
+  if(size == 0 || size > UIP_BUFSIZE - UIP_LLH_LEN) {
+    return NULL;
+  }
+  if(free == NULL) {
+    if(!first) {
+      PRINTFI("sicslowpan input: no reassembly for tag %d, dropping\n", tag);
+      UIP_STAT(++uip_stat.sicslowpan.reassdrop);
+      return NULL;
+    }
+    PRINTFI("sicslowpan input: giving up reassembly of tag %d\n", oldest->tag);
+    UIP_STAT(++uip_stat.sicslowpan.reassdrop);
+    free = oldest;
+  }
+
+  free->size = size;
+  free->tag = tag;
+  free->received = 0;
+  memset(free->units, 0, sizeof(free->units));
+  rimeaddr_copy(&free->sender, sender);
+  timer_set(&free->timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
+  PRINTFI("sicslowpan input: INIT FRAGMENTATION (len %d, tag %d)\n",
+          size, tag);
+  return free;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Account for the bytes of a fragment in its reassembly
+ * \param r The reassembly
+ * \param offset Offset of the fragment in the IP packet
+ * \param len Uncompressed length of the fragment
+ * \return Non zero if the datagram is complete
+ *
+ * Bytes beyond the datagram size are ignored, and so are the units
+ * received twice.
+ */
+static int
+reass_add(struct sicslowpan_reass *r, uint16_t offset, uint16_t len)
+{
+  uint16_t unit, end;
+
+  end = offset + len;
+  if(end > r->size) {
+    end = r->size;
+  }
+  for(unit = offset >> 3; unit < (end + 7) >> 3; unit++) {
+    if((r->units[unit >> 3] & (1 << (unit & 7))) == 0) {
+      r->units[unit >> 3] |= 1 << (unit & 7);
+      r->received++;
+    }
+  }
+  return r->received == (r->size + 7) >> 3;
+}
+#endif /* SICSLOWPAN_CONF_FRAG */
+
 /*-------------------------------------------------------------------------*/
 /* Rime Sniffer support for one single listener to enable powertrace of IP */
 /*-------------------------------------------------------------------------*/
@@ -1501,6 +1615,9 @@ output(uip_lladdr_t *localdest)
     queuebuf_to_packetbuf(q);
     queuebuf_free(q);
     q = NULL;
+    /* The next fragments are written in place */
+    packetbuf_unshare();
+    rime_ptr = packetbuf_dataptr();
 
     /* Check tx result. */
     if((last_tx_status == MAC_TX_COLLISION) ||
@@ -1547,6 +1664,8 @@ output(uip_lladdr_t *localdest)
       queuebuf_to_packetbuf(q);
       queuebuf_free(q);
       q = NULL;
+      packetbuf_unshare();
+      rime_ptr = packetbuf_dataptr();
       processed_ip_out_len += rime_payload_len;
 
       /* Check tx result. */
@@ -1582,11 +1701,14 @@ output(uip_lladdr_t *localdest)
  *  The 6lowpan packet is put in packetbuf by the MAC. If its a frag1 or
  *  a non-fragmented packet we first uncompress the IP header. The
  *  6lowpan payload and possibly the uncompressed IP header are then
- *  copied in siclowpan_buf. If the IP packet is complete it is copied
- *  to uip_buf and the IP layer is called.
+ *  copied in the buffer of the reassembly the fragment belongs to. If
+ *  the IP packet is complete it is copied to uip_buf and the IP layer
+ *  is called. A packet that is not fragmented is uncompressed in
+ *  uip_buf directly.
  *
- * \note We do not check for overlapping sicslowpan fragments
- * (it is a SHALL in the RFC 4944 and should never happen)
+ * \note We do not check that overlapping sicslowpan fragments carry
+ * the same data (it is a SHALL in the RFC 4944 and should never
+ * happen), the bytes received twice are only counted once.
  */
 static void
 input(void)
@@ -1599,7 +1721,9 @@ input(void)
 #if SICSLOWPAN_CONF_FRAG
   /* tag of the fragment */
   uint16_t frag_tag = 0;
-  uint8_t first_fragment = 0, last_fragment = 0;
+  uint8_t first_fragment = 0;
+  /* the reassembly the fragment belongs to */
+  struct sicslowpan_reass *r = NULL;
 #endif /*SICSLOWPAN_CONF_FRAG*/
 
   /* init */
@@ -1610,11 +1734,8 @@ input(void)
   rime_ptr = packetbuf_dataptr();
 
 #if SICSLOWPAN_CONF_FRAG
-  /* if reassembly timed out, cancel it */
-  if(timer_expired(&reass_timer)) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  }
+  /* cancel the reassemblies that timed out */
+  reass_expire();
   /*
    * Since we don't support the mesh and broadcast header, the first header
    * we look for is the fragmentation header
@@ -1630,7 +1751,6 @@ input(void)
       PRINTFI("size %d, tag %d, offset %d)\n",
              frag_size, frag_tag, frag_offset);
       rime_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
-      /*      printf("frag1 %d %d\n", reass_tag, frag_tag);*/
       first_fragment = 1;
       is_fragment = 1;
       break;
@@ -1646,72 +1766,22 @@ input(void)
       PRINTFI("size %d, tag %d, offset %d)\n",
              frag_size, frag_tag, frag_offset);
       rime_hdr_len += SICSLOWPAN_FRAGN_HDR_LEN;
-
-      /* If this is the last fragment, we may shave off any extrenous
-         bytes at the end. We must be liberal in what we accept. */
-      PRINTFI("last_fragment?: processed_ip_in_len %d rime_payload_len %d frag_size %d\n",
-              processed_ip_in_len, packetbuf_datalen() - rime_hdr_len, frag_size);
-
-      if(processed_ip_in_len + packetbuf_datalen() - rime_hdr_len >= frag_size) {
-        last_fragment = 1;
-      }
       is_fragment = 1;
       break;
     default:
       break;
   }
 
-  /* We are currently reassembling a packet, but have just received the first
-   * fragment of another packet. We can either ignore it and hope to receive
-   * the rest of the under-reassembly packet fragments, or we can discard the
-   * previous packet altogether, and start reassembling the new packet.
-   *
-   * We discard the previous packet, and start reassembling the new packet.
-   * This lessens the negative impacts of too high SICSLOWPAN_REASS_MAXAGE.
-   */
-#define PRIORITIZE_NEW_PACKETS 1
-#if PRIORITIZE_NEW_PACKETS
-  if(processed_ip_in_len > 0 && first_fragment
-      && !rimeaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  }
-#endif /* PRIORITIZE_NEW_PACKETS */
-
-  if(processed_ip_in_len > 0) {
-    /* reassembly is ongoing */
-    /*    printf("frag %d %d\n", reass_tag, frag_tag);*/
-    if((frag_size > 0 &&
-        (frag_size != sicslowpan_len ||
-         reass_tag  != frag_tag ||
-         !rimeaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))))  ||
-       frag_size == 0) {
-      /*
-       * the packet is a fragment that does not belong to the packet
-       * being reassembled or the packet is not a fragment.
-       */
-      PRINTFI("sicslowpan input: Dropping 6lowpan packet that is not a fragment of the packet currently being reassembled\n");
+  if(is_fragment) {
+    r = reass_lookup(frag_tag, frag_size, first_fragment);
+    if(r == NULL) {
+      PRINTFI("sicslowpan input: Dropping 6lowpan fragment\n");
       return;
     }
+    sicslowpan_buf = r->buf.u8;
   } else {
-    /*
-     * reassembly is off
-     * start it if we received a fragment
-     */
-    if((frag_size > 0) && (frag_size <= UIP_BUFSIZE)) {
-      /* We are currently not reassembling a packet, but have received a packet fragment
-       * that is not the first one. */
-      if(is_fragment && !first_fragment) {
-        return;
-      }
-
-      sicslowpan_len = frag_size;
-      reass_tag = frag_tag;
-      timer_set(&reass_timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
-      PRINTFI("sicslowpan input: INIT FRAGMENTATION (len %d, tag %d)\n",
-             sicslowpan_len, reass_tag);
-      rimeaddr_copy(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
-    }
+    /* Uncompress a packet that is not fragmented in place */
+    sicslowpan_buf = uip_buf;
   }
 
   if(rime_hdr_len == SICSLOWPAN_FRAGN_HDR_LEN) {
@@ -1773,34 +1843,31 @@ input(void)
   {
     int req_size = UIP_LLH_LEN + uncomp_hdr_len + (uint16_t)(frag_offset << 3)
         + rime_payload_len;
-    if(req_size > sizeof(sicslowpan_buf)) {
+    if(req_size > UIP_BUFSIZE) {
       PRINTF(
           "SICSLOWPAN: packet dropped, minimum required SICSLOWPAN_IP_BUF size: %d+%d+%d+%d=%d (current size: %d)\n",
           UIP_LLH_LEN, uncomp_hdr_len, (uint16_t)(frag_offset << 3),
-          rime_payload_len, req_size, sizeof(sicslowpan_buf));
+          rime_payload_len, req_size, UIP_BUFSIZE);
       return;
     }
   }
 
   memcpy((uint8_t *)SICSLOWPAN_IP_BUF + uncomp_hdr_len + (uint16_t)(frag_offset << 3), rime_ptr + rime_hdr_len, rime_payload_len);
   
-  /* update processed_ip_in_len if fragment, sicslowpan_len otherwise */
+  /* account for the fragment in its reassembly, set sicslowpan_len otherwise */
 
 #if SICSLOWPAN_CONF_FRAG
-  if(frag_size > 0) {
-    /* Add the size of the header only for the first fragment. */
-    if(first_fragment != 0) {
-      processed_ip_in_len += uncomp_hdr_len;
-    }
-    /* For the last fragment, we are OK if there is extrenous bytes at
-       the end of the packet. */
-    if(last_fragment != 0) {
-      processed_ip_in_len = frag_size;
-    } else {
-      processed_ip_in_len += rime_payload_len;
+  if(r != NULL) {
+    /* The headers are only in the first fragment. For the last one, we
+       are OK if there are extraneous bytes at the end of the packet. */
+    if(!reass_add(r, (uint16_t)(frag_offset << 3),
+                  uncomp_hdr_len + rime_payload_len)) {
+      PRINTF("received %d of %d units\n", r->received, (r->size + 7) >> 3);
+      return;
     }
-    PRINTF("processed_ip_in_len %d, rime_payload_len %d\n", processed_ip_in_len, rime_payload_len);
-
+    sicslowpan_len = r->size;
+    r->size = 0;
+    UIP_STAT(++uip_stat.sicslowpan.reass);
   } else {
 #endif /* SICSLOWPAN_CONF_FRAG */
     sicslowpan_len = rime_payload_len + uncomp_hdr_len;
@@ -1808,46 +1875,41 @@ input(void)
   }
 
   /*
-   * If we have a full IP packet in sicslowpan_buf, deliver it to
+   * We have a full IP packet in sicslowpan_buf, deliver it to
    * the IP stack
    */
-  PRINTF("sicslowpan_init processed_ip_in_len %d, sicslowpan_len %d\n",
-         processed_ip_in_len, sicslowpan_len);
-  if(processed_ip_in_len == 0 || (processed_ip_in_len == sicslowpan_len)) {
-    PRINTFI("sicslowpan input: IP packet ready (length %d)\n",
-           sicslowpan_len);
+  PRINTFI("sicslowpan input: IP packet ready (length %d)\n",
+          sicslowpan_len);
+  if(sicslowpan_buf != uip_buf) {
     memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, sicslowpan_len);
-    uip_len = sicslowpan_len;
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
+  }
+  uip_len = sicslowpan_len;
+  sicslowpan_len = 0;
 #endif /* SICSLOWPAN_CONF_FRAG */
 
 #if DEBUG
-    {
-      uint16_t ndx;
-      PRINTF("after decompression %u:", SICSLOWPAN_IP_BUF->len[1]);
-      for (ndx = 0; ndx < SICSLOWPAN_IP_BUF->len[1] + 40; ndx++) {
-        uint8_t data = ((uint8_t *) (SICSLOWPAN_IP_BUF))[ndx];
-        PRINTF("%02x", data);
-      }
-      PRINTF("\n");
+  {
+    uint16_t ndx;
+    PRINTF("after decompression %u:", SICSLOWPAN_IP_BUF->len[1]);
+    for (ndx = 0; ndx < SICSLOWPAN_IP_BUF->len[1] + 40; ndx++) {
+      uint8_t data = ((uint8_t *) (SICSLOWPAN_IP_BUF))[ndx];
+      PRINTF("%02x", data);
     }
+    PRINTF("\n");
+  }
 #endif
 
 #if SICSLOWPAN_CONF_NEIGHBOR_INFO
-    neighbor_info_packet_received();
+  neighbor_info_packet_received();
 #endif /* SICSLOWPAN_CONF_NEIGHBOR_INFO */
 
-    /* if callback is set then set attributes and call */
-    if(callback) {
-      set_packet_attrs();
-      callback->input_callback();
-    }
-
-    tcpip_input();
-#if SICSLOWPAN_CONF_FRAG
+  /* if callback is set then set attributes and call */
+  if(callback) {
+    set_packet_attrs();
+    callback->input_callback();
   }
-#endif /* SICSLOWPAN_CONF_FRAG */
+
+  tcpip_input();
 }
 /** @} */
 
@@ -688,7 +688,7 @@ tcpip_ipv6_output(void)
 void
 tcpip_poll_udp(struct uip_udp_conn *conn)
 {
-  process_post(&tcpip_process, UDP_POLL, conn);
+  process_post_priority(&tcpip_process, UDP_POLL, conn, PROCESS_PRIORITY_HIGH);
 }
 #endif /* UIP_UDP */
 /*---------------------------------------------------------------------------*/
@@ -696,7 +696,7 @@ tcpip_poll_udp(struct uip_udp_conn *conn)
 void
 tcpip_poll_tcp(struct uip_conn *conn)
 {
-  process_post(&tcpip_process, TCP_POLL, conn);
+  process_post_priority(&tcpip_process, TCP_POLL, conn, PROCESS_PRIORITY_HIGH);
 }
 #endif /* UIP_TCP */
 /*---------------------------------------------------------------------------*/
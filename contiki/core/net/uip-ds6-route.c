@@ -49,6 +49,25 @@ MEMB(defaultroutermemb, uip_ds6_defrt_t, UIP_DS6_DEFRT_NB);
 LIST(notificationlist);
 #endif
 
+#if UIP_DS6_ROUTE_TRIE
+/* A node of the route trie. Nodes only exist for the routes and where
+   the prefixes of two routes part, and hold the prefix shared by all
+   the routes below them. A node without a route has two children. */
+struct route_node {
+  struct route_node *child[2];
+  uip_ds6_route_t *route;
+  uip_ipaddr_t prefix;
+  uint8_t length;
+};
+
+static struct route_node *trie_root;
+/* The node of each route, and the one where it parts from the others */
+MEMB(routenodememb, struct route_node, 2 * UIP_DS6_ROUTE_NB);
+
+/* Bit n of an address, counting from its most significant bit */
+#define ADDR_BIT(addr, n) (((addr)->u8[(n) >> 3] >> (7 - ((n) & 7))) & 1)
+#endif /* UIP_DS6_ROUTE_TRIE */
+
 #undef DEBUG
 #define DEBUG DEBUG_NONE
 #include "net/uip-debug.h"
@@ -91,11 +110,150 @@ uip_ds6_notification_rm(struct uip_ds6_notification *n)
 }
 #endif
 /*---------------------------------------------------------------------------*/
+#if UIP_DS6_ROUTE_TRIE
+/* Number of leading bits two addresses have in common, at most max */
+static uint8_t
+common_length(const uip_ipaddr_t *a, const uip_ipaddr_t *b, uint8_t max)
+{
+  uint8_t len, x;
+
+  for(len = 0; len < max; len += 8) {
+    x = a->u8[len >> 3] ^ b->u8[len >> 3];
+    if(x != 0) {
+      while((x & 0x80) == 0) {
+        x <<= 1;
+        len++;
+      }
+      break;
+    }
+  }
+  return len < max ? len : max;
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_route_t *
+trie_lookup(uip_ipaddr_t *addr)
+{
+  struct route_node *n;
+  uip_ds6_route_t *found_route;
+
+  found_route = NULL;
+  n = trie_root;
+  while(n != NULL && common_length(addr, &n->prefix, n->length) == n->length) {
+    if(n->route != NULL) {
+      found_route = n->route;
+    }
+    if(n->length == 128) {
+      break;
+    }
+    n = n->child[ADDR_BIT(addr, n->length)];
+  }
+  return found_route;
+}
+/*---------------------------------------------------------------------------*/
+static int
+trie_insert(uip_ds6_route_t *route)
+{
+  struct route_node **link, *n, *node, *branch;
+  uint8_t len;
+
+  /* Walk down the nodes whose prefix is a prefix of the route */
+  len = 0;
+  for(link = &trie_root; (n = *link) != NULL;
+      link = &n->child[ADDR_BIT(&route->ipaddr, n->length)]) {
+    len = common_length(&route->ipaddr, &n->prefix,
+                        route->length < n->length ?
+                        route->length : n->length);
+    if(len < n->length) {
+      break;
+    }
+    if(n->length == route->length) {
+      n->route = route;
+      return 1;
+    }
+  }
+
+  node = memb_alloc(&routenodememb);
+  if(node == NULL) {
+    return 0;
+  }
+  node->child[0] = node->child[1] = NULL;
+  node->route = route;
+  uip_ipaddr_copy(&node->prefix, &route->ipaddr);
+  node->length = route->length;
+
+  if(n == NULL) {
+    *link = node;
+  } else if(len == route->length) {
+    /* The route is a prefix of n */
+    node->child[ADDR_BIT(&n->prefix, len)] = n;
+    *link = node;
+  } else {
+    /* The route and n part at bit len */
+    branch = memb_alloc(&routenodememb);
+    if(branch == NULL) {
+      memb_free(&routenodememb, node);
+      return 0;
+    }
+    branch->route = NULL;
+    uip_ipaddr_copy(&branch->prefix, &route->ipaddr);
+    branch->length = len;
+    branch->child[ADDR_BIT(&route->ipaddr, len)] = node;
+    branch->child[ADDR_BIT(&n->prefix, len)] = n;
+    *link = branch;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+trie_remove(uip_ds6_route_t *route)
+{
+  struct route_node **link, **parent, *n;
+  uip_ds6_route_t *r;
+
+  parent = NULL;
+  for(link = &trie_root; (n = *link) != NULL && n->length < route->length;
+      link = &n->child[ADDR_BIT(&route->ipaddr, n->length)]) {
+    parent = link;
+  }
+  if(n == NULL || n->route != route) {
+    return;
+  }
+
+  /* Updating a route may have left another one with the same prefix */
+  for(r = list_head(routelist); r != NULL; r = list_item_next(r)) {
+    if(r != route && r->length == route->length &&
+       common_length(&r->ipaddr, &route->ipaddr, r->length) == r->length) {
+      n->route = r;
+      return;
+    }
+  }
+
+  n->route = NULL;
+  if(n->child[0] != NULL && n->child[1] != NULL) {
+    /* Still needed where its children part */
+    return;
+  }
+  *link = n->child[0] != NULL ? n->child[0] : n->child[1];
+  memb_free(&routenodememb, n);
+
+  /* A parent without route was only kept for the branch just removed */
+  if(*link == NULL && parent != NULL && (*parent)->route == NULL) {
+    n = *parent;
+    *parent = n->child[0] != NULL ? n->child[0] : n->child[1];
+    memb_free(&routenodememb, n);
+  }
+}
+#endif /* UIP_DS6_ROUTE_TRIE */
+/*---------------------------------------------------------------------------*/
 void
 uip_ds6_route_init(void)
 {
   memb_init(&routememb);
   list_init(routelist);
+#if UIP_DS6_ROUTE_TRIE
+  memb_init(&routenodememb);
+  trie_root = NULL;
+#endif /* UIP_DS6_ROUTE_TRIE */
 
   memb_init(&defaultroutermemb);
   list_init(defaultrouterlist);
@@ -120,15 +278,20 @@ uip_ds6_route_num_routes(void)
 uip_ds6_route_t *
 uip_ds6_route_lookup(uip_ipaddr_t *addr)
 {
+#if !UIP_DS6_ROUTE_TRIE
   uip_ds6_route_t *r;
-  uip_ds6_route_t *found_route;
   uint8_t longestmatch;
+#endif /* !UIP_DS6_ROUTE_TRIE */
+  uip_ds6_route_t *found_route;
 
   PRINTF("uip-ds6-route: Looking up route for ");
   PRINT6ADDR(addr);
   PRINTF("\n");
 
 
+#if UIP_DS6_ROUTE_TRIE
+  found_route = trie_lookup(addr);
+#else /* UIP_DS6_ROUTE_TRIE */
   found_route = NULL;
   longestmatch = 0;
   for(r = list_head(routelist);
@@ -141,6 +304,7 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
     }
 
   }
+#endif /* UIP_DS6_ROUTE_TRIE */
 
   if(found_route != NULL) {
     PRINTF("uip-ds6-route: Found route:");
@@ -169,6 +333,10 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
     PRINTF("uip_ds6_route_add: old route already found, updating this one instead: ");
     PRINT6ADDR(ipaddr);
     PRINTF("\n");
+#if UIP_DS6_ROUTE_TRIE
+    /* Its prefix may change */
+    trie_remove(r);
+#endif /* UIP_DS6_ROUTE_TRIE */
   } else {
     /* Allocate a routing entry and add the route to the list */
     r = memb_alloc(&routememb);
@@ -192,6 +360,15 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
   memset(&r->state, 0, sizeof(UIP_DS6_ROUTE_STATE_TYPE));
 #endif
 
+#if UIP_DS6_ROUTE_TRIE
+  if(!trie_insert(r)) {
+    PRINTF("uip_ds6_route_add: could not allocate trie node, dropping route\n");
+    list_remove(routelist, r);
+    memb_free(&routememb, r);
+    return NULL;
+  }
+#endif /* UIP_DS6_ROUTE_TRIE */
+
   PRINTF("uip_ds6_route_add: adding route: ");
   PRINT6ADDR(ipaddr);
   PRINTF(" via ");
@@ -217,6 +394,9 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
       r = list_item_next(r)) {
     if(r == route) {
       list_remove(routelist, route);
+#if UIP_DS6_ROUTE_TRIE
+      trie_remove(route);
+#endif /* UIP_DS6_ROUTE_TRIE */
       memb_free(&routememb, route);
 
       PRINTF("uip_ds6_route_rm num %d\n", list_length(routelist));
@@ -252,10 +432,14 @@ uip_ds6_route_rm_by_nexthop(uip_ipaddr_t *nexthop)
   while(r != NULL) {
     if(uip_ipaddr_cmp(&r->nexthop, nexthop)) {
       list_remove(routelist, r);
+#if UIP_DS6_ROUTE_TRIE
+      trie_remove(r);
+#endif /* UIP_DS6_ROUTE_TRIE */
 #if UIP_DS6_NOTIFICATIONS
       call_route_callback(UIP_DS6_NOTIFICATION_ROUTE_RM,
 			  &r->ipaddr, &r->nexthop);
 #endif
+      memb_free(&routememb, r);
       r = list_head(routelist);
     } else {
       r = list_item_next(r);
@@ -77,6 +77,15 @@ void uip_ds6_notification_rm(struct uip_ds6_notification *n);
 #define UIP_DS6_ROUTE_NB UIP_CONF_MAX_ROUTES
 #endif /* UIP_CONF_MAX_ROUTES */
 
+/* Look the routes up in a path compressed binary trie rather than by
+   scanning the routing table, at the cost of up to two trie nodes per
+   route */
+#ifdef UIP_CONF_DS6_ROUTE_TRIE
+#define UIP_DS6_ROUTE_TRIE UIP_CONF_DS6_ROUTE_TRIE
+#else /* UIP_CONF_DS6_ROUTE_TRIE */
+#define UIP_DS6_ROUTE_TRIE 0
+#endif /* UIP_CONF_DS6_ROUTE_TRIE */
+
 /** \brief define some additional RPL related route state and
  *  neighbor callback for RPL - if not a DS6_ROUTE_STATE is already set */
 #ifndef UIP_DS6_ROUTE_STATE_TYPE
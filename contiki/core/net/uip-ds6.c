@@ -98,6 +98,13 @@ static uip_ds6_prefix_t *locprefix;
 static uip_ds6_nbr_t *locnbr;
 static uip_ds6_defrt_t *locdefrt;
 
+#if UIP_DS6_NBR_HASH
+/* Neighbors in use, chained through their next field in the bucket of
+   their IP address, and the free entries of the cache */
+static uip_ds6_nbr_t *nbr_hash[UIP_DS6_NBR_HASH];
+static uip_ds6_nbr_t *nbr_free;
+#endif /* UIP_DS6_NBR_HASH */
+
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_init(void)
@@ -110,6 +117,16 @@ uip_ds6_init(void)
      UIP_DS6_NBR_NB, UIP_DS6_DEFRT_NB, UIP_DS6_PREFIX_NB, UIP_DS6_ROUTE_NB,
      UIP_DS6_ADDR_NB, UIP_DS6_MADDR_NB, UIP_DS6_AADDR_NB);
   memset(uip_ds6_nbr_cache, 0, sizeof(uip_ds6_nbr_cache));
+#if UIP_DS6_NBR_HASH
+  memset(nbr_hash, 0, sizeof(nbr_hash));
+  nbr_free = NULL;
+  for(locnbr = uip_ds6_nbr_cache + UIP_DS6_NBR_NB;
+      locnbr > uip_ds6_nbr_cache;) {
+    locnbr--;
+    locnbr->next = nbr_free;
+    nbr_free = locnbr;
+  }
+#endif /* UIP_DS6_NBR_HASH */
   //  memset(uip_ds6_defrt_list, 0, sizeof(uip_ds6_defrt_list));
   memset(uip_ds6_prefix_list, 0, sizeof(uip_ds6_prefix_list));
   memset(&uip_ds6_if, 0, sizeof(uip_ds6_if));
@@ -266,7 +283,7 @@ uip_ds6_periodic(void)
 
 /*---------------------------------------------------------------------------*/
 uint8_t
-uip_ds6_list_loop(uip_ds6_element_t *list, uint8_t size,
+uip_ds6_list_loop(uip_ds6_element_t *list, uint16_t size,
                   uint16_t elementsize, uip_ipaddr_t *ipaddr,
                   uint8_t ipaddrlen, uip_ds6_element_t **out_element)
 {
@@ -291,6 +308,32 @@ uip_ds6_list_loop(uip_ds6_element_t *list, uint8_t size,
   return *out_element != NULL ? FREESPACE : NOSPACE;
 }
 
+/*---------------------------------------------------------------------------*/
+#if UIP_DS6_NBR_HASH
+/* The interface identifier tells the neighbors apart, the prefix is
+   mostly the same for all of them */
+static uip_ds6_nbr_t **
+nbr_bucket(uip_ipaddr_t *ipaddr)
+{
+  uint16_t h;
+
+  h = ipaddr->u16[4] ^ ipaddr->u16[5] ^ ipaddr->u16[6] ^ ipaddr->u16[7];
+  return &nbr_hash[(h ^ (h >> 8)) % UIP_DS6_NBR_HASH];
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_nbr_t *
+nbr_hash_lookup(uip_ipaddr_t *ipaddr)
+{
+  uip_ds6_nbr_t *n;
+
+  for(n = *nbr_bucket(ipaddr); n != NULL; n = n->next) {
+    if(uip_ipaddr_cmp(&n->ipaddr, ipaddr)) {
+      return n;
+    }
+  }
+  return NULL;
+}
+#endif /* UIP_DS6_NBR_HASH */
 /*---------------------------------------------------------------------------*/
 uip_ds6_nbr_t *
 uip_ds6_nbr_add(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr,
@@ -298,14 +341,30 @@ uip_ds6_nbr_add(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr,
 {
   int r;
 
+#if UIP_DS6_NBR_HASH
+  if(nbr_hash_lookup(ipaddr) != NULL) {
+    r = FOUND;
+  } else if(nbr_free != NULL) {
+    locnbr = nbr_free;
+    nbr_free = locnbr->next;
+    r = FREESPACE;
+  } else {
+    r = NOSPACE;
+  }
+#else /* UIP_DS6_NBR_HASH */
   r = uip_ds6_list_loop
      ((uip_ds6_element_t *)uip_ds6_nbr_cache, UIP_DS6_NBR_NB,
       sizeof(uip_ds6_nbr_t), ipaddr, 128,
       (uip_ds6_element_t **)&locnbr);
+#endif /* UIP_DS6_NBR_HASH */
 
   if(r == FREESPACE) {
     locnbr->isused = 1;
     uip_ipaddr_copy(&locnbr->ipaddr, ipaddr);
+#if UIP_DS6_NBR_HASH
+    locnbr->next = *nbr_bucket(ipaddr);
+    *nbr_bucket(ipaddr) = locnbr;
+#endif /* UIP_DS6_NBR_HASH */
     if(lladdr != NULL) {
       memcpy(&locnbr->lladdr, lladdr, UIP_LLADDR_LEN);
     } else {
@@ -362,6 +421,16 @@ void
 uip_ds6_nbr_rm(uip_ds6_nbr_t *nbr)
 {
   if(nbr != NULL) {
+#if UIP_DS6_NBR_HASH
+    if(nbr->isused) {
+      uip_ds6_nbr_t **p;
+
+      for(p = nbr_bucket(&nbr->ipaddr); *p != nbr; p = &(*p)->next);
+      *p = nbr->next;
+      nbr->next = nbr_free;
+      nbr_free = nbr;
+    }
+#endif /* UIP_DS6_NBR_HASH */
     nbr->isused = 0;
 #if UIP_CONF_IPV6_QUEUE_PKT
     uip_packetqueue_free(&nbr->packethandle);
@@ -375,10 +444,14 @@ uip_ds6_nbr_rm(uip_ds6_nbr_t *nbr)
 uip_ds6_nbr_t *
 uip_ds6_nbr_lookup(uip_ipaddr_t *ipaddr)
 {
+#if UIP_DS6_NBR_HASH
+  if((locnbr = nbr_hash_lookup(ipaddr)) != NULL) {
+#else /* UIP_DS6_NBR_HASH */
   if(uip_ds6_list_loop
      ((uip_ds6_element_t *)uip_ds6_nbr_cache, UIP_DS6_NBR_NB,
       sizeof(uip_ds6_nbr_t), ipaddr, 128,
       (uip_ds6_element_t **)&locnbr) == FOUND) {
+#endif /* UIP_DS6_NBR_HASH */
     locnbr->last_lookup = clock_time();
     return locnbr;
   }
@@ -882,7 +955,7 @@ uip_ds6_nbr_t *
 uip_ds6_get_least_lifetime_neighbor(void)
 {
   uip_ds6_nbr_t *nbr_expiring = NULL;
-  uint8_t i;
+  uint16_t i;
   for(i = 0; i < UIP_DS6_NBR_NB; i++) {
     if(uip_ds6_nbr_cache[i].isused) {
       if(nbr_expiring != NULL) {
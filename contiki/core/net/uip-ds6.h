@@ -64,6 +64,13 @@
 #define UIP_DS6_NBR_NBU UIP_CONF_DS6_NBR_NBU
 #endif
 #define UIP_DS6_NBR_NB UIP_DS6_NBR_NBS + UIP_DS6_NBR_NBU
+/* Number of buckets of the hash index of the neighbor cache, 0 scans the
+   whole cache on every lookup instead */
+#ifndef UIP_CONF_DS6_NBR_HASH
+#define UIP_DS6_NBR_HASH 0
+#else
+#define UIP_DS6_NBR_HASH UIP_CONF_DS6_NBR_HASH
+#endif
 
 /* Default router list */
 #define UIP_DS6_DEFRT_NBS 0
@@ -170,6 +177,10 @@ typedef struct uip_ds6_nbr {
   struct uip_packetqueue_handle packethandle;
 #define UIP_DS6_NBR_PACKET_LIFETIME CLOCK_SECOND * 4
 #endif                          /*UIP_CONF_QUEUE_PKT */
+#if UIP_DS6_NBR_HASH
+  /* Next entry in the same hash bucket, or next free entry */
+  struct uip_ds6_nbr *next;
+#endif /* UIP_DS6_NBR_HASH */
 } uip_ds6_nbr_t;
 
 /** \brief A prefix list entry */
@@ -268,7 +279,7 @@ void uip_ds6_periodic(void);
 
 /** \brief Generic loop routine on an abstract data structure, which generalizes
  * all data structures used in DS6 */
-uint8_t uip_ds6_list_loop(uip_ds6_element_t *list, uint8_t size,
+uint8_t uip_ds6_list_loop(uip_ds6_element_t *list, uint16_t size,
                           uint16_t elementsize, uip_ipaddr_t *ipaddr,
                           uint8_t ipaddrlen,
                           uip_ds6_element_t **out_element);
@@ -1461,6 +1461,14 @@ struct uip_stats {
     uip_stats_t recv;     /**< Number of recived ND6 packets */
     uip_stats_t sent;     /**< Number of sent ND6 packets */
   } nd6;
+  struct {
+    uip_stats_t reass;    /**< Number of reassembled 6lowpan
+			     datagrams. */
+    uip_stats_t reassdrop; /**< Number of 6lowpan reassemblies given up,
+			     or fragments dropped, for lack of room. */
+    uip_stats_t reasstimeout; /**< Number of 6lowpan reassemblies that
+			     timed out. */
+  } sicslowpan;           /**< 6lowpan statistics. */
 #endif /*UIP_CONF_IPV6*/
 };
 
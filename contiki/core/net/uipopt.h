@@ -494,6 +494,17 @@
 #define SICSLOWPAN_CONF_FRAG  0
 #endif
 
+/**
+ * How many datagrams from different senders we reassemble at the
+ * same time (default: 1). Each one takes a buffer of UIP_BUFSIZE
+ * bytes.
+ */
+#ifdef SICSLOWPAN_CONF_REASS_CONTEXTS
+#define SICSLOWPAN_REASS_CONTEXTS (SICSLOWPAN_CONF_REASS_CONTEXTS)
+#else
+#define SICSLOWPAN_REASS_CONTEXTS 1
+#endif
+
 /** @} */
 
 /*------------------------------------------------------------------------------*/
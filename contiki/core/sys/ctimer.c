@@ -46,6 +46,9 @@
 #include "contiki.h"
 #include "lib/list.h"
 
+/* The pending ctimers. A timer event is only trusted for a ctimer that
+   is still in the list: the ctimer may have been stopped and its memory
+   reused after the event was posted. */
 LIST(ctimer_list);
 
 static char initialized;
@@ -74,15 +77,19 @@ PROCESS_THREAD(ctimer_process, ev, data)
     PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_TIMER);
     for(c = list_head(ctimer_list); c != NULL; c = c->next) {
       if(&c->etimer == data) {
-	list_remove(ctimer_list, c);
-	PROCESS_CONTEXT_BEGIN(c->p);
-	if(c->f != NULL) {
-	  c->f(c->ptr);
-	}
-	PROCESS_CONTEXT_END(c->p);
 	break;
       }
     }
+    /* A ctimer stopped or set again after its event was posted does
+       not fire */
+    if(c != NULL && etimer_expired(&c->etimer)) {
+      list_remove(ctimer_list, c);
+      PROCESS_CONTEXT_BEGIN(c->p);
+      if(c->f != NULL) {
+	c->f(c->ptr);
+      }
+      PROCESS_CONTEXT_END(c->p);
+    }
   }
   PROCESS_END();
 }
@@ -109,6 +116,7 @@ ctimer_set(struct ctimer *c, clock_time_t t,
     PROCESS_CONTEXT_END(&ctimer_process);
   } else {
     c->etimer.timer.interval = t;
+    c->etimer.p = PROCESS_NONE;
   }
 
   list_remove(ctimer_list, c);
@@ -53,6 +53,247 @@ static struct etimer *timerlist;
 static clock_time_t next_expiration;
 
 PROCESS(etimer_process, "Event timer");
+#if ETIMER_HEAP
+/*
+ * The heap is a complete binary tree linked through the timers
+ * themselves, timerlist being its root. Each timer on it keeps its
+ * position, counting from 1 in breadth-first order.
+ */
+static unsigned int nheap;
+/*---------------------------------------------------------------------------*/
+/* Timers are within half the clock range of each other, which orders
+   them even across clock wraps */
+static int
+expires_before(struct etimer *a, struct etimer *b)
+{
+  clock_time_t diff = etimer_expiration_time(b) - etimer_expiration_time(a);
+  clock_time_t half = ((clock_time_t)~(clock_time_t)0 >> 1) + 1;
+
+  return diff != 0 && diff < half;
+}
+/*---------------------------------------------------------------------------*/
+/* Swaps a timer with its parent */
+static void
+swap_up(struct etimer *parent, struct etimer *child)
+{
+  struct etimer *sibling, *grandparent = parent->parent;
+  struct etimer *left = child->left, *right = child->right;
+  unsigned int index;
+
+  if(parent->left == child) {
+    sibling = parent->right;
+    child->left = parent;
+    child->right = sibling;
+  } else {
+    sibling = parent->left;
+    child->left = sibling;
+    child->right = parent;
+  }
+  if(sibling != NULL) {
+    sibling->parent = child;
+  }
+  child->parent = grandparent;
+  if(grandparent == NULL) {
+    timerlist = child;
+  } else if(grandparent->left == parent) {
+    grandparent->left = child;
+  } else {
+    grandparent->right = child;
+  }
+  parent->parent = child;
+  index = child->index;
+  child->index = parent->index;
+  parent->index = index;
+  parent->left = left;
+  parent->right = right;
+  if(left != NULL) {
+    left->parent = parent;
+  }
+  if(right != NULL) {
+    right->parent = parent;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+sift(struct etimer *t)
+{
+  struct etimer *smallest;
+
+  while(t->parent != NULL && expires_before(t, t->parent)) {
+    swap_up(t->parent, t);
+  }
+  while(1) {
+    smallest = t;
+    if(t->left != NULL && expires_before(t->left, smallest)) {
+      smallest = t->left;
+    }
+    if(t->right != NULL && expires_before(t->right, smallest)) {
+      smallest = t->right;
+    }
+    if(smallest == t) {
+      break;
+    }
+    swap_up(t, smallest);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the link that holds, or will hold, the n-th node of the tree
+   counting from 1, and its parent */
+static struct etimer **
+heap_slot(unsigned int n, struct etimer **parent)
+{
+  struct etimer **slot = &timerlist;
+  unsigned int bit;
+
+  *parent = NULL;
+  for(bit = 1; bit <= n / 2; bit <<= 1);
+  for(bit >>= 1; bit > 0; bit >>= 1) {
+    *parent = *slot;
+    slot = (n & bit) ? &(*slot)->right : &(*slot)->left;
+  }
+  return slot;
+}
+/*---------------------------------------------------------------------------*/
+/* The position a timer keeps is only trusted if the heap holds the
+   timer there, as etimers whose memory was never cleared may be set or
+   stopped */
+static int
+on_heap(struct etimer *t)
+{
+  struct etimer *parent;
+
+  return t->index >= 1 && t->index <= nheap &&
+    *heap_slot(t->index, &parent) == t;
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_insert(struct etimer *t)
+{
+  struct etimer **slot = heap_slot(++nheap, &t->parent);
+
+  t->index = nheap;
+  t->left = t->right = NULL;
+  *slot = t;
+  sift(t);
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_remove(struct etimer *t)
+{
+  struct etimer *parent;
+  struct etimer **slot = heap_slot(nheap--, &parent);
+  struct etimer *last = *slot;
+
+  /* Unlink the last node and put it in the place of the removed one */
+  *slot = NULL;
+  if(last != t) {
+    last->left = t->left;
+    last->right = t->right;
+    last->parent = t->parent;
+    last->index = t->index;
+    if(last->left != NULL) {
+      last->left->parent = last;
+    }
+    if(last->right != NULL) {
+      last->right->parent = last;
+    }
+    if(t->parent == NULL) {
+      timerlist = last;
+    } else if(t->parent->left == t) {
+      t->parent->left = last;
+    } else {
+      t->parent->right = last;
+    }
+    sift(last);
+  }
+  t->left = t->right = t->parent = NULL;
+  t->index = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Chains the timers of a process in the subtree of t to found, through
+   their next field, which the heap does not use */
+static struct etimer *
+find_process(struct etimer *t, struct process *p, struct etimer *found)
+{
+  if(t != NULL) {
+    if(t->p == p) {
+      t->next = found;
+      found = t;
+    }
+    found = find_process(t->left, p, found);
+    found = find_process(t->right, p, found);
+  }
+  return found;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_time(void)
+{
+  next_expiration = timerlist == NULL ? 0 : etimer_expiration_time(timerlist);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(etimer_process, ev, data)
+{
+  struct etimer *t;
+
+  PROCESS_BEGIN();
+
+  timerlist = NULL;
+  nheap = 0;
+
+  while(1) {
+    PROCESS_YIELD();
+
+    if(ev == PROCESS_EVENT_EXITED) {
+      for(t = find_process(timerlist, data, NULL); t != NULL; t = t->next) {
+	heap_remove(t);
+      }
+      update_time();
+      continue;
+    } else if(ev != PROCESS_EVENT_POLL) {
+      continue;
+    }
+
+    /* The root of the heap expires first */
+    while(timerlist != NULL && timer_expired(&timerlist->timer)) {
+      t = timerlist;
+      if(process_post_priority(t->p, PROCESS_EVENT_TIMER, t,
+			       PROCESS_PRIORITY_HIGH) != PROCESS_ERR_OK) {
+	etimer_request_poll();
+	break;
+      }
+      /* Reset the process ID of the event timer, to signal that the
+	 etimer has expired. This is later checked in the
+	 etimer_expired() function. */
+      t->p = PROCESS_NONE;
+      heap_remove(t);
+    }
+    update_time();
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_request_poll(void)
+{
+  process_poll(&etimer_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_timer(struct etimer *timer)
+{
+  etimer_request_poll();
+
+  /* A timer already on the heap is moved to its new place */
+  if(on_heap(timer)) {
+    heap_remove(timer);
+  }
+  timer->p = PROCESS_CURRENT();
+  heap_insert(timer);
+  update_time();
+}
+#else /* ETIMER_HEAP */
 /*---------------------------------------------------------------------------*/
 static void
 update_time(void)
@@ -115,7 +356,8 @@ PROCESS_THREAD(etimer_process, ev, data)
     
     for(t = timerlist; t != NULL; t = t->next) {
       if(timer_expired(&t->timer)) {
-	if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
+	if(process_post_priority(t->p, PROCESS_EVENT_TIMER, t,
+				 PROCESS_PRIORITY_HIGH) == PROCESS_ERR_OK) {
 	  
 	  /* Reset the process ID of the event timer, to signal that the
 	     etimer has expired. This is later checked in the
@@ -172,6 +414,7 @@ add_timer(struct etimer *timer)
 
   update_time();
 }
+#endif /* ETIMER_HEAP */
 /*---------------------------------------------------------------------------*/
 void
 etimer_set(struct etimer *et, clock_time_t interval)
@@ -198,6 +441,11 @@ void
 etimer_adjust(struct etimer *et, int timediff)
 {
   et->timer.start += timediff;
+#if ETIMER_HEAP
+  if(on_heap(et)) {
+    sift(et);
+  }
+#endif /* ETIMER_HEAP */
   update_time();
 }
 /*---------------------------------------------------------------------------*/
@@ -234,6 +482,12 @@ etimer_next_expiration_time(void)
 void
 etimer_stop(struct etimer *et)
 {
+#if ETIMER_HEAP
+  if(on_heap(et)) {
+    heap_remove(et);
+    update_time();
+  }
+#else /* ETIMER_HEAP */
   struct etimer *t;
 
   /* First check if et is the first event timer on the list. */
@@ -254,6 +508,7 @@ etimer_stop(struct etimer *et)
       update_time();
     }
   }
+#endif /* ETIMER_HEAP */
 
   /* Remove the next pointer from the item to be removed. */
   et->next = NULL;
@@ -65,6 +65,20 @@
 #include "sys/timer.h"
 #include "sys/process.h"
 
+/*
+ * The pending event timers are kept in an unsorted list by default.
+ * With ETIMER_CONF_HEAP they are kept in a binary heap ordered by
+ * expiration time instead, so that setting a timer costs O(log n) and
+ * the next expiration is found in O(1), at the price of three more
+ * pointers and a position per timer. This pays off with hundreds of
+ * timers.
+ */
+#ifdef ETIMER_CONF_HEAP
+#define ETIMER_HEAP ETIMER_CONF_HEAP
+#else
+#define ETIMER_HEAP 0
+#endif
+
 /**
  * A timer.
  *
@@ -77,6 +91,10 @@ struct etimer {
   struct timer timer;
   struct etimer *next;
   struct process *p;
+#if ETIMER_HEAP
+  struct etimer *left, *right, *parent;
+  unsigned int index;
+#endif /* ETIMER_HEAP */
 };
 
 /**
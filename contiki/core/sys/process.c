@@ -44,6 +44,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "sys/process.h"
 #include "sys/arg.h"
@@ -57,19 +58,37 @@ struct process *process_current = NULL;
 static process_event_t lastevent;
 
 /*
- * Structure used for keeping the queue of active events.
+ * Structure used for keeping the queues of active events. The slots
+ * are shared by all priorities, each priority chains its own events
+ * from the oldest to the newest and the unused slots are chained in a
+ * free list.
  */
 struct event_data {
   process_event_t ev;
   process_data_t data;
   struct process *p;
+  process_num_events_t next;
 };
 
-static process_num_events_t nevents, fevent;
+#if PROCESS_CONF_NUMEVENTS > 255
+#error PROCESS_CONF_NUMEVENTS must be at most 255
+#endif
+#define NO_EVENT PROCESS_CONF_NUMEVENTS
+
+struct event_queue {
+  process_num_events_t head, tail, depth;
+};
+
+static process_num_events_t nevents, freeevent;
 static struct event_data events[PROCESS_CONF_NUMEVENTS];
+static struct event_queue queues[PROCESS_PRIORITIES];
 
 #if PROCESS_CONF_STATS
 process_num_events_t process_maxevents;
+struct process_stats process_stats;
+#define STATS_ADD(x) process_stats.x++
+#else
+#define STATS_ADD(x)
 #endif
 
 static volatile unsigned char poll_requested;
@@ -207,11 +226,22 @@ process_exit(struct process *p)
 void
 process_init(void)
 {
+  process_num_events_t i;
+
   lastevent = PROCESS_EVENT_MAX;
 
-  nevents = fevent = 0;
+  nevents = 0;
+  for(i = 0; i < PROCESS_CONF_NUMEVENTS; i++) {
+    events[i].next = i + 1;
+  }
+  freeevent = 0;
+  for(i = 0; i < PROCESS_PRIORITIES; i++) {
+    queues[i].head = queues[i].tail = NO_EVENT;
+    queues[i].depth = 0;
+  }
 #if PROCESS_CONF_STATS
   process_maxevents = 0;
+  memset(&process_stats, 0, sizeof(process_stats));
 #endif /* PROCESS_CONF_STATS */
 
   process_current = process_list = NULL;
@@ -237,6 +267,26 @@ do_poll(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Unlink the oldest event of a queue and put its slot back on the
+ * free list.
+ */
+static process_num_events_t
+dequeue(struct event_queue *q)
+{
+  process_num_events_t e = q->head;
+
+  q->head = events[e].next;
+  if(q->head == NO_EVENT) {
+    q->tail = NO_EVENT;
+  }
+  --q->depth;
+  --nevents;
+  events[e].next = freeevent;
+  freeevent = e;
+  return e;
+}
+/*---------------------------------------------------------------------------*/
 /*
  * Process the next event in the event queue and deliver it to
  * listening processes.
@@ -249,27 +299,27 @@ do_event(void)
   static process_data_t data;
   static struct process *receiver;
   static struct process *p;
+  static process_num_events_t e;
+  unsigned char prio;
   
   /*
-   * If there are any events in the queue, take the first one and walk
-   * through the list of processes to see if the event should be
-   * delivered to any of them. If so, we call the event handler
-   * function for the process. We only process one event at a time and
-   * call the poll handlers inbetween.
+   * If there are any events in the queue, take the first one of the
+   * highest priority and walk through the list of processes to see if
+   * the event should be delivered to any of them. If so, we call the
+   * event handler function for the process. We only process one event
+   * at a time and call the poll handlers inbetween.
    */
 
   if(nevents > 0) {
     
-    /* There are events that we should deliver. */
-    ev = events[fevent].ev;
-    
-    data = events[fevent].data;
-    receiver = events[fevent].p;
+    for(prio = 0; queues[prio].depth == 0; prio++);
 
-    /* Since we have seen the new event, we move pointer upwards
-       and decrese the number of events. */
-    fevent = (fevent + 1) % PROCESS_CONF_NUMEVENTS;
-    --nevents;
+    /* There are events that we should deliver. Since we have seen the
+       new event, we release its slot. */
+    e = dequeue(&queues[prio]);
+    ev = events[e].ev;
+    data = events[e].data;
+    receiver = events[e].p;
 
     /* If this is a broadcast event, we deliver it to all events, in
        order of their priority. */
@@ -301,13 +351,20 @@ do_event(void)
 int
 process_run(void)
 {
+  int i;
+
   /* Process poll events. */
   if(poll_requested) {
     do_poll();
   }
 
-  /* Process one event from the queue */
-  do_event();
+  /* Process a batch of events from the queue, polling in between */
+  for(i = 0; i < PROCESS_CONF_BATCH && nevents > 0; i++) {
+    if(i > 0 && poll_requested) {
+      do_poll();
+    }
+    do_event();
+  }
 
   return nevents + poll_requested;
 }
@@ -318,10 +375,39 @@ process_nevents(void)
   return nevents + poll_requested;
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Try to make room for an event that does not fit in the queue.
+ * Returns non-zero if a slot could be freed.
+ */
+static int
+make_room(unsigned char priority)
+{
+#if PROCESS_CONF_POLICY == PROCESS_POLICY_EVICT
+  if(priority != PROCESS_PRIORITY_LOW &&
+     queues[PROCESS_PRIORITY_LOW].depth > 0) {
+    /* Drop the oldest low priority event */
+    PRINTF("process_post: evicting event %d\n",
+	   events[queues[PROCESS_PRIORITY_LOW].head].ev);
+    dequeue(&queues[PROCESS_PRIORITY_LOW]);
+    STATS_ADD(evicted);
+    return 1;
+  }
+#endif /* PROCESS_CONF_POLICY == PROCESS_POLICY_EVICT */
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+process_num_events_t
+process_queue_depth(unsigned char priority)
+{
+  return priority < PROCESS_PRIORITIES ? queues[priority].depth : 0;
+}
+/*---------------------------------------------------------------------------*/
 int
-process_post(struct process *p, process_event_t ev, process_data_t data)
+process_post_priority(struct process *p, process_event_t ev,
+		      process_data_t data, unsigned char priority)
 {
   static process_num_events_t snum;
+  struct event_queue *q;
 
   if(PROCESS_CURRENT() == NULL) {
     PRINTF("process_post: NULL process posts event %d to process '%s', nevents %d\n",
@@ -332,7 +418,15 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
 	   p == PROCESS_BROADCAST? "<broadcast>": PROCESS_NAME_STRING(p), nevents);
   }
   
-  if(nevents == PROCESS_CONF_NUMEVENTS) {
+  if(priority >= PROCESS_PRIORITIES) {
+    priority = PROCESS_PRIORITY_LOW;
+  }
+
+  if((nevents >= PROCESS_CONF_NUMEVENTS ||
+      (priority != PROCESS_PRIORITY_HIGH &&
+       nevents >= PROCESS_CONF_HIGHWATER)) &&
+     !make_room(priority)) {
+    STATS_ADD(rejected[priority]);
 #if DEBUG
     if(p == PROCESS_BROADCAST) {
       printf("soft panic: event queue is full when broadcast event %d was posted from %s\n", ev, PROCESS_NAME_STRING(process_current));
@@ -343,13 +437,28 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
     return PROCESS_ERR_FULL;
   }
   
-  snum = (process_num_events_t)(fevent + nevents) % PROCESS_CONF_NUMEVENTS;
+  snum = freeevent;
+  freeevent = events[snum].next;
   events[snum].ev = ev;
   events[snum].data = data;
   events[snum].p = p;
+  events[snum].next = NO_EVENT;
+
+  q = &queues[priority];
+  if(q->tail == NO_EVENT) {
+    q->head = snum;
+  } else {
+    events[q->tail].next = snum;
+  }
+  q->tail = snum;
+  ++q->depth;
   ++nevents;
 
 #if PROCESS_CONF_STATS
+  STATS_ADD(posted[priority]);
+  if(q->depth > process_stats.maxdepth[priority]) {
+    process_stats.maxdepth[priority] = q->depth;
+  }
   if(nevents > process_maxevents) {
     process_maxevents = nevents;
   }
@@ -358,6 +467,12 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
   return PROCESS_ERR_OK;
 }
 /*---------------------------------------------------------------------------*/
+int
+process_post(struct process *p, process_event_t ev, process_data_t data)
+{
+  return process_post_priority(p, ev, data, PROCESS_PRIORITY_NORMAL);
+}
+/*---------------------------------------------------------------------------*/
 void
 process_post_synch(struct process *p, process_event_t ev, process_data_t data)
 {
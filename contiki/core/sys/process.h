@@ -88,6 +88,63 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/**
+ * \name Event priorities
+ *
+ * Queued events are delivered highest priority first, and in the
+ * order they were posted within a priority. Low priority events may
+ * be evicted from the queue to make room for more important ones, see
+ * PROCESS_CONF_POLICY.
+ * @{
+ */
+#define PROCESS_PRIORITY_HIGH   0
+#define PROCESS_PRIORITY_NORMAL 1
+#define PROCESS_PRIORITY_LOW    2
+#define PROCESS_PRIORITIES      3
+/* @} */
+
+/*
+ * Above the high water mark only high priority events are queued, the
+ * rest of the queue is kept for them. By default no room is kept: a
+ * platform whose interrupts post high priority events can reserve some
+ * by setting PROCESS_CONF_HIGHWATER below PROCESS_CONF_NUMEVENTS.
+ */
+#ifndef PROCESS_CONF_HIGHWATER
+#define PROCESS_CONF_HIGHWATER PROCESS_CONF_NUMEVENTS
+#endif /* PROCESS_CONF_HIGHWATER */
+
+/*
+ * What happens to an event that does not fit in the queue:
+ * PROCESS_POLICY_REJECT refuses it with PROCESS_ERR_FULL,
+ * PROCESS_POLICY_EVICT drops the oldest queued low priority event
+ * in its favour, if there is one, and refuses it otherwise.
+ */
+#define PROCESS_POLICY_REJECT 0
+#define PROCESS_POLICY_EVICT  1
+#ifndef PROCESS_CONF_POLICY
+#define PROCESS_CONF_POLICY PROCESS_POLICY_EVICT
+#endif /* PROCESS_CONF_POLICY */
+
+/*
+ * Largest number of events delivered by a single process_run() call.
+ */
+#ifndef PROCESS_CONF_BATCH
+#define PROCESS_CONF_BATCH 4
+#endif /* PROCESS_CONF_BATCH */
+
+#if PROCESS_CONF_STATS
+struct process_stats {
+  /* events queued and refused per priority, low priority events evicted */
+  unsigned long posted[PROCESS_PRIORITIES];
+  unsigned long rejected[PROCESS_PRIORITIES];
+  unsigned long evicted;
+  /* deepest each queue has been */
+  process_num_events_t maxdepth[PROCESS_PRIORITIES];
+};
+extern struct process_stats process_stats;
+extern process_num_events_t process_maxevents;
+#endif /* PROCESS_CONF_STATS */
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -364,6 +421,30 @@ CCIF void process_start(struct process *p, const char *arg);
  */
 CCIF int process_post(struct process *p, process_event_t ev, void* data);
 
+/**
+ * Post an asynchronous event with a priority.
+ *
+ * This function works as process_post(), which posts its events with
+ * PROCESS_PRIORITY_NORMAL.
+ *
+ * \param p The process to which the event should be posted, or
+ * PROCESS_BROADCAST if the event should be posted to all processes.
+ *
+ * \param ev The event to be posted.
+ *
+ * \param data The auxiliary data to be sent with the event
+ *
+ * \param priority One of the PROCESS_PRIORITY_ values. Low priority
+ * events may be dropped even after they were queued.
+ *
+ * \retval PROCESS_ERR_OK The event could be posted.
+ *
+ * \retval PROCESS_ERR_FULL The event queue was full, or above the high
+ * water mark for this priority, and the event could not be posted.
+ */
+CCIF int process_post_priority(struct process *p, process_event_t ev,
+			       void* data, unsigned char priority);
+
 /**
  * Post a synchronous event to a process.
  *
@@ -485,11 +566,12 @@ CCIF void process_poll(struct process *p);
 void process_init(void);
 
 /**
- * Run the system once - call poll handlers and process one event.
+ * Run the system once - call poll handlers and process events.
  *
  * This function should be called repeatedly from the main() program
  * to actually run the Contiki system. It calls the necessary poll
- * handlers, and processes one event. The function returns the number
+ * handlers, and processes up to PROCESS_CONF_BATCH events, calling
+ * the poll handlers in between. The function returns the number
  * of events that are waiting in the event queue so that the caller
  * may choose to put the CPU to sleep when there are no pending
  * events.
@@ -519,6 +601,13 @@ CCIF int process_is_running(struct process *p);
  */
 int process_nevents(void);
 
+/**
+ * Number of events waiting in the queue of a priority.
+ *
+ * \param priority One of the PROCESS_PRIORITY_ values.
+ */
+process_num_events_t process_queue_depth(unsigned char priority);
+
 /** @} */
 
 CCIF extern struct process *process_list;
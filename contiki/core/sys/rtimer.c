@@ -44,6 +44,8 @@
  *
  */
 
+#include <string.h>
+
 #include "sys/rtimer.h"
 #include "contiki.h"
 
@@ -55,53 +57,138 @@
 #define PRINTF(...)
 #endif
 
+/* The pending tasks, sorted by time. The hardware timer is always
+   scheduled for the first one. */
 static struct rtimer *next_rtimer;
+/* Set while rtimer_run_next() runs the tasks, it schedules the
+   hardware timer once they are done */
+static char running;
+
+#if RTIMER_CONF_STATS
+struct rtimer_stats rtimer_stats;
+#endif /* RTIMER_CONF_STATS */
 
 /*---------------------------------------------------------------------------*/
 void
 rtimer_init(void)
 {
+  next_rtimer = NULL;
+  running = 0;
+#if RTIMER_CONF_STATS
+  memset(&rtimer_stats, 0, sizeof(rtimer_stats));
+#endif /* RTIMER_CONF_STATS */
   rtimer_arch_init();
 }
 /*---------------------------------------------------------------------------*/
+/* Removes a task from the queue, returns non-zero if it was there */
+static int
+unlink_rtimer(struct rtimer *rtimer)
+{
+  struct rtimer **t;
+
+  for(t = &next_rtimer; *t != NULL; t = &(*t)->next) {
+    if(*t == rtimer) {
+      *t = rtimer->next;
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 int
 rtimer_set(struct rtimer *rtimer, rtimer_clock_t time,
 	   rtimer_clock_t duration,
 	   rtimer_callback_t func, void *ptr)
 {
-  int first = 0;
+  struct rtimer **t;
+  struct rtimer *first;
+  rtimer_clock_t first_time;
+  unsigned long s;
 
   PRINTF("rtimer_set time %d\n", time);
 
-  if(next_rtimer == NULL) {
-    first = 1;
-  }
+  RTIMER_ARCH_DISABLE(s);
+  first = next_rtimer;
+  first_time = first != NULL ? first->time : 0;
+
+  /* Setting a pending task again moves it */
+  unlink_rtimer(rtimer);
 
   rtimer->func = func;
   rtimer->ptr = ptr;
-
   rtimer->time = time;
-  next_rtimer = rtimer;
 
-  if(first == 1) {
-    rtimer_arch_schedule(time);
+#if RTIMER_CONF_STATS
+  if(RTIMER_CLOCK_LT(time, RTIMER_NOW())) {
+    rtimer_stats.overruns++;
+  }
+#endif /* RTIMER_CONF_STATS */
+
+  /* Tasks with the same time run in the order they were set */
+  for(t = &next_rtimer;
+      *t != NULL && !RTIMER_CLOCK_LT(time, (*t)->time);
+      t = &(*t)->next);
+  rtimer->next = *t;
+  *t = rtimer;
+
+  /* The first task may also stay first with a new time */
+  if((next_rtimer != first || next_rtimer->time != first_time) && !running) {
+    rtimer_arch_schedule(next_rtimer->time);
   }
+  RTIMER_ARCH_RESTORE(s);
   return RTIMER_OK;
 }
 /*---------------------------------------------------------------------------*/
+int
+rtimer_cancel(struct rtimer *rtimer)
+{
+  struct rtimer *first;
+  unsigned long s;
+  int pending;
+
+  RTIMER_ARCH_DISABLE(s);
+  first = next_rtimer;
+  pending = unlink_rtimer(rtimer);
+  /* The hardware timer may still fire for the cancelled task, which
+     rtimer_run_next() ignores */
+  if(next_rtimer != first && next_rtimer != NULL && !running) {
+    rtimer_arch_schedule(next_rtimer->time);
+  }
+  RTIMER_ARCH_RESTORE(s);
+  return pending;
+}
+/*---------------------------------------------------------------------------*/
 void
 rtimer_run_next(void)
 {
   struct rtimer *t;
-  if(next_rtimer == NULL) {
-    return;
+  rtimer_clock_t now;
+
+  /* Run every task that is due, the first one or those set for the
+     same time included */
+  running = 1;
+  while(next_rtimer != NULL) {
+    now = RTIMER_NOW();
+    if(RTIMER_CLOCK_LT(now, next_rtimer->time)) {
+      /* The hardware timer fired for a task that is gone */
+      break;
+    }
+    t = next_rtimer;
+    next_rtimer = t->next;
+#if RTIMER_CONF_STATS
+    rtimer_stats.runs++;
+    if((rtimer_clock_t)(now - t->time) > RTIMER_LATE_THRESHOLD) {
+      rtimer_stats.late++;
+    }
+    if((rtimer_clock_t)(now - t->time) > rtimer_stats.max_lateness) {
+      rtimer_stats.max_lateness = now - t->time;
+    }
+#endif /* RTIMER_CONF_STATS */
+    t->func(t, t->ptr);
   }
-  t = next_rtimer;
-  next_rtimer = NULL;
-  t->func(t, t->ptr);
+  running = 0;
   if(next_rtimer != NULL) {
     rtimer_arch_schedule(next_rtimer->time);
   }
-  return;
 }
 /*---------------------------------------------------------------------------*/
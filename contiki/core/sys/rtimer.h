@@ -61,6 +61,38 @@ typedef unsigned short rtimer_clock_t;
 
 #include "rtimer-arch.h"
 
+/*
+ * rtimer_run_next() takes the tasks off the pending list in the rtimer
+ * interrupt. rtimer_set() and rtimer_cancel() update the list between
+ * RTIMER_ARCH_DISABLE(s), which saves the interrupt state in the
+ * unsigned long s and masks the rtimer interrupt, and
+ * RTIMER_ARCH_RESTORE(s). Architectures that do not run the tasks from
+ * an interrupt need not define them.
+ */
+#ifndef RTIMER_ARCH_DISABLE
+#define RTIMER_ARCH_DISABLE(s) ((s) = 0)
+#define RTIMER_ARCH_RESTORE(s) ((void)(s))
+#endif /* RTIMER_ARCH_DISABLE */
+
+#if RTIMER_CONF_STATS
+/* A task that runs more than this many ticks after its time is late */
+#ifdef RTIMER_CONF_LATE_THRESHOLD
+#define RTIMER_LATE_THRESHOLD RTIMER_CONF_LATE_THRESHOLD
+#else
+#define RTIMER_LATE_THRESHOLD 1
+#endif
+
+struct rtimer_stats {
+  /* tasks run, and those of them that ran late */
+  unsigned long runs, late;
+  /* tasks posted for a time that had already passed */
+  unsigned long overruns;
+  /* the latest a task has run, in ticks */
+  rtimer_clock_t max_lateness;
+};
+extern struct rtimer_stats rtimer_stats;
+#endif /* RTIMER_CONF_STATS */
+
 /**
  * \brief      Initialize the real-time scheduler.
  *
@@ -84,6 +116,7 @@ struct rtimer {
   rtimer_clock_t time;
   rtimer_callback_t func;
   void *ptr;
+  struct rtimer *next;
 };
 
 enum {
@@ -100,16 +133,26 @@ enum {
  * \param duration Unused argument.
  * \param func A function to be called when the task is executed.
  * \param ptr An opaque pointer that will be supplied as an argument to the callback function.
- * \return     Non-zero (true) if the task could be scheduled, zero
- *             (false) if the task could not be scheduled.
+ * \return     RTIMER_OK
  *
  *             This function schedules a real-time task at a specified
- *             time in the future.
+ *             time in the future. Any number of tasks can be pending,
+ *             they run in the order of their time. Posting a task
+ *             that is already pending moves it to the new time.
+ *             Tasks may be posted from rtimer callbacks as well as
+ *             from processes.
  *
  */
 int rtimer_set(struct rtimer *task, rtimer_clock_t time,
 	       rtimer_clock_t duration, rtimer_callback_t func, void *ptr);
 
+/**
+ * \brief      Cancel a pending real-time task
+ * \param task The task
+ * \return     Non-zero if the task was pending
+ */
+int rtimer_cancel(struct rtimer *task);
+
 /**
  * \brief      Execute the next real-time task and schedule the next task, if any
  *
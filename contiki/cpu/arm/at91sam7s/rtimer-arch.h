@@ -8,6 +8,12 @@
 #ifndef __RTIMER_ARCH_H__
 #define __RTIMER_ARCH_H__
 
+/* The pending tasks are updated with IRQs disabled */
+#define RTIMER_ARCH_DISABLE(s) ((s) = disableIRQ())
+#define RTIMER_ARCH_RESTORE(s) restoreIRQ(s)
+
+#include "interrupt-utils.h"
+
 #include "sys/rtimer.h"
 
 #define RTIMER_ARCH_TIMER_ID AT91C_ID_TC1
@@ -33,6 +33,10 @@
 #ifndef __RTIMER_ARCH_H__
 #define __RTIMER_ARCH_H__
 
+/* The pending tasks are updated with the interrupts disabled */
+#define RTIMER_ARCH_DISABLE(s) do { (s) = SREG; cli(); } while(0)
+#define RTIMER_ARCH_RESTORE(s) (SREG = (s))
+
 #include <avr/interrupt.h>
 
 /* Nominal ARCH_SECOND is F_CPU/prescaler, e.g. 8000000/1024 = 7812
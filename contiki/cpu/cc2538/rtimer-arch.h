@@ -60,6 +60,13 @@
 #ifndef RTIMER_ARCH_H_
 #define RTIMER_ARCH_H_
 
+/* The pending tasks are updated with the interrupts disabled, s keeps
+   PRIMASK */
+#define RTIMER_ARCH_DISABLE(s) ((s) = cpu_cpsid())
+#define RTIMER_ARCH_RESTORE(s) do { if(!(s)) { cpu_cpsie(); } } while(0)
+
+#include "cpu.h"
+
 #include "contiki.h"
 #include "dev/gptimer.h"
 
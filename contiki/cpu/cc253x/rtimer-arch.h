@@ -44,6 +44,10 @@
 #ifndef __RTIMER_ARCH_H__
 #define __RTIMER_ARCH_H__
 
+/* The pending tasks are updated with the interrupts disabled */
+#define RTIMER_ARCH_DISABLE(s) do { (s) = EA; EA = 0; } while(0)
+#define RTIMER_ARCH_RESTORE(s) (EA = (s))
+
 #include "contiki-conf.h"
 #include "cc253x.h"
 
@@ -43,6 +43,11 @@
 #ifndef __RTIMER_ARCH_H__
 #define __RTIMER_ARCH_H__
 
+/* The pending tasks are updated with the interrupts disabled */
+#define RTIMER_ARCH_DISABLE(s) \
+  do { (s) = ITC->INTENABLE; ITC->INTENABLE = 0; } while(0)
+#define RTIMER_ARCH_RESTORE(s) (ITC->INTENABLE = (s))
+
 /* contiki */
 #include "sys/rtimer.h"
 
@@ -40,6 +40,12 @@
 #ifndef __RTIMER_ARCH_H__
 #define __RTIMER_ARCH_H__
 
+/* The pending tasks are updated with the interrupts disabled */
+#define RTIMER_ARCH_DISABLE(s) do { (s) = splhigh(); } while(0)
+#define RTIMER_ARCH_RESTORE(s) splx(s)
+
+#include "msp430def.h"
+
 #include "sys/rtimer.h"
 
 #ifdef RTIMER_CONF_SECOND
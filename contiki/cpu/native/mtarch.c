@@ -34,10 +34,30 @@
 
 #include "sys/mt.h"
 
+#if defined(__linux) && defined(__x86_64__) && !defined(MTARCH_CONF_UCONTEXT)
+/* Switch stacks with a few instructions instead of swapcontext(), which
+   also saves and restores the signal mask with a system call */
+#define MTARCH_FAST_SWITCH 1
+#else
+#define MTARCH_FAST_SWITCH 0
+#endif
+
 #ifndef MTARCH_STACKSIZE
+#if defined(__linux) || defined(__APPLE__)
+/* Only the pages a thread actually touches take up memory */
+#define MTARCH_STACKSIZE 65536
+#else
 #define MTARCH_STACKSIZE 4096
+#endif
 #endif /* MTARCH_STACKSIZE */
 
+/* Stacks of stopped threads kept for the next mt_start() */
+#ifdef MTARCH_CONF_POOLSIZE
+#define MTARCH_POOLSIZE MTARCH_CONF_POOLSIZE
+#else
+#define MTARCH_POOLSIZE 8
+#endif
+
 #if defined(_WIN32) || defined(__CYGWIN__)
 
 #define WIN32_LEAN_AND_MEAN
@@ -52,17 +72,153 @@ static void *main_fiber;
 #define _XOPEN_SOURCE
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#if !MTARCH_FAST_SWITCH
 #include <ucontext.h>
+#endif /* !MTARCH_FAST_SWITCH */
 
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_STACK
+#define MAP_STACK 0
+#endif
+
+/*
+ * Each thread gets its own mapping, with an inaccessible guard page at
+ * the bottom so that a stack overflow faults instead of corrupting the
+ * memory below it. The thread's state sits at the top of the mapping,
+ * above the stack.
+ */
 struct mtarch_t {
-  char stack[MTARCH_STACKSIZE];
+#if MTARCH_FAST_SWITCH
+  void *sp;
+#else /* MTARCH_FAST_SWITCH */
   ucontext_t context;
+#endif /* MTARCH_FAST_SWITCH */
+  struct mtarch_t *next;
 };
 
+static struct mtarch_t *pool;
+static int pooled;
+
+#if MTARCH_FAST_SWITCH
+static void *main_sp;
+static struct mtarch_t *running;
+
+void mtarch_switch(void **save_sp, void *sp);
+void mtarch_entry(void);
+
+/*
+ * mtarch_switch() saves the callee-saved registers and the floating
+ * point control words on the current stack, stores the stack pointer in
+ * *save_sp and resumes the stack found in sp. A new thread's stack is
+ * prepared to "return" into mtarch_entry(), which calls function(data)
+ * from r12 and r13, and then the exit function from r14.
+ */
+__asm__(
+  ".text\n"
+  ".globl mtarch_switch\n"
+  ".type mtarch_switch, @function\n"
+  "mtarch_switch:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  subq $8, %rsp\n"
+  "  stmxcsr (%rsp)\n"
+  "  fnstcw 4(%rsp)\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rsp\n"
+  "  ldmxcsr (%rsp)\n"
+  "  fldcw 4(%rsp)\n"
+  "  addq $8, %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+  ".size mtarch_switch, .-mtarch_switch\n"
+  ".globl mtarch_entry\n"
+  ".type mtarch_entry, @function\n"
+  "mtarch_entry:\n"
+  "  movq %r13, %rdi\n"
+  "  callq *%r12\n"
+  "  callq *%r14\n"
+  "  ud2\n"
+  ".size mtarch_entry, .-mtarch_entry\n");
+#else /* MTARCH_FAST_SWITCH */
 static ucontext_t main_context;
 static ucontext_t *running_context;
+#endif /* MTARCH_FAST_SWITCH */
+
+/*--------------------------------------------------------------------------*/
+static size_t
+stack_mapping(void)
+{
+  size_t page = sysconf(_SC_PAGESIZE);
+
+  return page + ((MTARCH_STACKSIZE + sizeof(struct mtarch_t) + page - 1) &
+                 ~(page - 1));
+}
+/*--------------------------------------------------------------------------*/
+static struct mtarch_t *
+stack_alloc(void)
+{
+  char *base;
+
+  if(pool != NULL) {
+    struct mtarch_t *t = pool;
+    pool = t->next;
+    pooled--;
+    return t;
+  }
+
+  base = mmap(NULL, stack_mapping(), PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if(base == MAP_FAILED) {
+    perror("mtarch: mmap");
+    abort();
+  }
+  /* Without its guard page, a stack overflow would silently corrupt
+     the memory below the stack */
+  if(mprotect(base, sysconf(_SC_PAGESIZE), PROT_NONE) != 0) {
+    perror("mtarch: mprotect");
+    munmap(base, stack_mapping());
+    abort();
+  }
+
+  return (struct mtarch_t *)(base + stack_mapping()) - 1;
+}
+/*--------------------------------------------------------------------------*/
+static void
+stack_free(struct mtarch_t *t)
+{
+  if(pooled < MTARCH_POOLSIZE) {
+    t->next = pool;
+    pool = t;
+    pooled++;
+  } else {
+    munmap((char *)(t + 1) - stack_mapping(), stack_mapping());
+  }
+}
+#if !MTARCH_FAST_SWITCH
+/*--------------------------------------------------------------------------*/
+/* The lowest address of the stack, just above the guard page */
+static char *
+stack_bottom(struct mtarch_t *t)
+{
+  return (char *)(t + 1) - stack_mapping() + sysconf(_SC_PAGESIZE);
+}
+#endif /* !MTARCH_FAST_SWITCH */
 
 #endif /* _WIN32 || __CYGWIN__ || __linux */
 
@@ -84,6 +240,15 @@ mtarch_remove(void)
 
   ConvertFiberToThread();
 
+#elif defined(__linux)
+
+  while(pool != NULL) {
+    struct mtarch_t *t = pool;
+    pool = t->next;
+    munmap((char *)(t + 1) - stack_mapping(), stack_mapping());
+  }
+  pooled = 0;
+
 #endif /* _WIN32 || __CYGWIN__ */
 }
 /*--------------------------------------------------------------------------*/
@@ -96,17 +261,40 @@ mtarch_start(struct mtarch_thread *thread,
 
   thread->mt_thread = CreateFiber(0, (LPFIBER_START_ROUTINE)function, data);
 
+#elif defined(__linux) && MTARCH_FAST_SWITCH
+
+  struct mtarch_t *t;
+  void **sp;
+
+  t = stack_alloc();
+  thread->mt_thread = t;
+
+  /* The frame mtarch_switch() pops, from the top of the stack down:
+     the return address, rbp, rbx, r12 to r15 and the control words.
+     The stack pointer is 16 bytes aligned when mtarch_entry() starts. */
+  sp = (void **)((unsigned long)t & ~15UL);
+  *--sp = (void *)mtarch_entry;
+  *--sp = NULL;                 /* rbp */
+  *--sp = NULL;                 /* rbx */
+  *--sp = (void *)function;     /* r12 */
+  *--sp = data;                 /* r13 */
+  *--sp = (void *)mt_exit;      /* r14 */
+  *--sp = NULL;                 /* r15 */
+  *--sp = (void *)0x037f00001f80UL; /* Default x87 control word and MXCSR */
+  t->sp = sp;
+
 #elif defined(__linux)
 
-  thread->mt_thread = malloc(sizeof(struct mtarch_t));
+  struct mtarch_t *t;
 
-  getcontext(&((struct mtarch_t *)thread->mt_thread)->context);
+  t = stack_alloc();
+  thread->mt_thread = t;
 
-  ((struct mtarch_t *)thread->mt_thread)->context.uc_link = NULL;
-  ((struct mtarch_t *)thread->mt_thread)->context.uc_stack.ss_sp = 
-			((struct mtarch_t *)thread->mt_thread)->stack;
-  ((struct mtarch_t *)thread->mt_thread)->context.uc_stack.ss_size = 
-			sizeof(((struct mtarch_t *)thread->mt_thread)->stack);
+  getcontext(&t->context);
+
+  t->context.uc_link = NULL;
+  t->context.uc_stack.ss_sp = stack_bottom(t);
+  t->context.uc_stack.ss_size = (char *)t - stack_bottom(t);
 
   /* Some notes:
      - If a CPU needs stronger alignment for the stack than malloc()
@@ -123,8 +311,7 @@ mtarch_start(struct mtarch_thread *thread,
        the only way to stay independent from the CPU architecture. But
        Solaris prior to release 10 interprets ss_sp as highest stack
        address thus requiring special handling. */
-  makecontext(&((struct mtarch_t *)thread->mt_thread)->context,
-	      (void (*)(void))function, 1, data);
+  makecontext(&t->context, (void (*)(void))function, 1, data);
 
 #endif /* _WIN32 || __CYGWIN__ || __linux */
 }
@@ -136,6 +323,10 @@ mtarch_yield(void)
 
   SwitchToFiber(main_fiber);
 
+#elif defined(__linux) && MTARCH_FAST_SWITCH
+
+  mtarch_switch(&running->sp, main_sp);
+
 #elif defined(__linux)
 
   swapcontext(running_context, &main_context);
@@ -150,6 +341,12 @@ mtarch_exec(struct mtarch_thread *thread)
 
   SwitchToFiber(thread->mt_thread);
 
+#elif defined(__linux) && MTARCH_FAST_SWITCH
+
+  running = thread->mt_thread;
+  mtarch_switch(&main_sp, running->sp);
+  running = NULL;
+
 #elif defined(__linux)
 
   running_context = &((struct mtarch_t *)thread->mt_thread)->context;
@@ -168,7 +365,7 @@ mtarch_stop(struct mtarch_thread *thread)
 
 #elif defined(linux) || defined(__linux)
 
-  free(thread->mt_thread);
+  stack_free(thread->mt_thread);
 
 #endif /* _WIN32 || __CYGWIN__ || __linux */
 }
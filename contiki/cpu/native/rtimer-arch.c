@@ -38,6 +38,7 @@
  */
 
 #include <signal.h>
+#include <time.h>
 #ifndef _WIN32
 #include <sys/time.h>
 #endif /* !_WIN32 */
@@ -46,6 +47,18 @@
 #include "sys/rtimer.h"
 #include "sys/clock.h"
 
+#ifdef RTIMER_ARCH_CONF_TIMERFD
+#define RTIMER_ARCH_TIMERFD RTIMER_ARCH_CONF_TIMERFD
+#else
+#define RTIMER_ARCH_TIMERFD 0
+#endif
+
+#if RTIMER_ARCH_TIMERFD
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#endif /* RTIMER_ARCH_TIMERFD */
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -54,8 +67,97 @@
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+rtimer_clock_t
+rtimer_arch_now(void)
+{
+#ifndef _WIN32
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (rtimer_clock_t)(ts.tv_sec * 1000000UL + ts.tv_nsec / 1000);
+#else /* !_WIN32 */
+  return (rtimer_clock_t)(clock_time() * (RTIMER_ARCH_SECOND / CLOCK_SECOND));
+#endif /* !_WIN32 */
+}
+/*---------------------------------------------------------------------------*/
+#if RTIMER_ARCH_TIMERFD
+static int timer_fd = -1;
+
+static int
+set_fd(fd_set *rset, fd_set *wset)
+{
+  FD_SET(timer_fd, rset);
+  return 1;
+}
 /*---------------------------------------------------------------------------*/
 static void
+handle_fd(fd_set *rset, fd_set *wset)
+{
+  uint64_t expirations;
+
+  if(FD_ISSET(timer_fd, rset) &&
+     read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+    rtimer_run_next();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct select_callback timer_callback = { set_fd, handle_fd };
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_init(void)
+{
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if(timer_fd < 0) {
+    perror("timerfd_create");
+    return;
+  }
+  select_set_callback(timer_fd, &timer_callback);
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_schedule(rtimer_clock_t t)
+{
+  struct itimerspec val;
+  struct timespec now;
+  int32_t c;
+
+  /* Extend t to the 64 bits monotonic clock and arm an absolute timer,
+     so that the time spent here does not delay it */
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  c = (int32_t)(t - (rtimer_clock_t)(now.tv_sec * 1000000UL +
+                                     now.tv_nsec / 1000));
+  if(c < 0) {
+    c = 0;
+  }
+
+  PRINTF("rtimer_arch_schedule time %lu in %ld us\n",
+         (unsigned long)t, (long)c);
+
+  val.it_value.tv_sec = now.tv_sec + c / 1000000;
+  val.it_value.tv_nsec = (now.tv_nsec / 1000 + c % 1000000) * 1000;
+  if(val.it_value.tv_nsec >= 1000000000L) {
+    val.it_value.tv_sec++;
+    val.it_value.tv_nsec -= 1000000000L;
+  }
+  val.it_interval.tv_sec = val.it_interval.tv_nsec = 0;
+  timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &val, NULL);
+}
+/*---------------------------------------------------------------------------*/
+/* The tasks run from the main loop, not from an interrupt */
+unsigned long
+rtimer_arch_disable(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_restore(unsigned long s)
+{
+}
+/*---------------------------------------------------------------------------*/
+#else /* RTIMER_ARCH_TIMERFD */
+static void
 interrupt(int sig)
 {
   signal(sig, interrupt);
@@ -75,18 +177,53 @@ rtimer_arch_schedule(rtimer_clock_t t)
 {
 #ifndef _WIN32
   struct itimerval val;
-  rtimer_clock_t c;
+  int32_t c;
+
+  c = (int32_t)(t - rtimer_arch_now());
+  /* A zero timer would be disarmed */
+  if(c < 1) {
+    c = 1;
+  }
 
-  c = t - (unsigned short)clock_time();
-  
-  val.it_value.tv_sec = c / 1000;
-  val.it_value.tv_usec = (c % 1000) * 1000;
+  val.it_value.tv_sec = c / 1000000;
+  val.it_value.tv_usec = c % 1000000;
 
-  PRINTF("rtimer_arch_schedule time %u %u in %d.%d seconds\n", t, c, c / 1000,
-	 (c % 1000) * 1000);
+  PRINTF("rtimer_arch_schedule time %lu in %ld us\n",
+         (unsigned long)t, (long)c);
 
   val.it_interval.tv_sec = val.it_interval.tv_usec = 0;
   setitimer(ITIMER_REAL, &val, NULL);
 #endif /* !_WIN32 */
 }
 /*---------------------------------------------------------------------------*/
+/* Blocks SIGALRM, returns non-zero if it was blocked already */
+unsigned long
+rtimer_arch_disable(void)
+{
+#ifndef _WIN32
+  sigset_t set, old;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGALRM);
+  sigprocmask(SIG_BLOCK, &set, &old);
+  return sigismember(&old, SIGALRM);
+#else /* !_WIN32 */
+  return 0;
+#endif /* !_WIN32 */
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_restore(unsigned long s)
+{
+#ifndef _WIN32
+  sigset_t set;
+
+  if(!s) {
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    sigprocmask(SIG_UNBLOCK, &set, NULL);
+  }
+#endif /* !_WIN32 */
+}
+#endif /* RTIMER_ARCH_TIMERFD */
+/*---------------------------------------------------------------------------*/
@@ -40,10 +40,21 @@
 #ifndef __RTIMER_ARCH_H__
 #define __RTIMER_ARCH_H__
 
+/* With a signal for the rtimer interrupt, the pending tasks are updated
+   with the signal blocked */
+#define RTIMER_ARCH_DISABLE(s) ((s) = rtimer_arch_disable())
+#define RTIMER_ARCH_RESTORE(s) rtimer_arch_restore(s)
+
 #include "contiki-conf.h"
 
-#define RTIMER_ARCH_SECOND CLOCK_CONF_SECOND
+/*
+ * Microsecond ticks of the host's monotonic clock. Platforms using this
+ * must make rtimer_clock_t 32 bits wide, 16 bits would wrap every 65 ms.
+ */
+#define RTIMER_ARCH_SECOND 1000000U
 
-#define rtimer_arch_now() clock_time()
+rtimer_clock_t rtimer_arch_now(void);
+unsigned long rtimer_arch_disable(void);
+void rtimer_arch_restore(unsigned long s);
 
 #endif /* __RTIMER_ARCH_H__ */
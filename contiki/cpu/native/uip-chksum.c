@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Internet checksum for uIP on the native platform
+ * \author
+ *         agent <agent@local>
+ *
+ *         The portable chksum() in uip.c and uip6.c adds 16 bits at a
+ *         time and handles the carry of each addition. Here the data
+ *         is summed 64 bits, or a whole SSE2 or AVX2 register, at a
+ *         time in the byte order of the CPU, with the carries left in
+ *         wider accumulators and folded once at the end. The one's
+ *         complement sum does not depend on the byte order as long as
+ *         the result is swapped back.
+ */
+
+#include "net/uip.h"
+#include "uip-chksum.h"
+
+#if UIP_ARCH_CHKSUM
+
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define CHKSUM_X86 1
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SWAP16(x) (x)
+#else
+#define SWAP16(x) ((uint16_t)(((x) << 8) | ((x) >> 8)))
+#endif
+
+#define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+/* Adds the 16-bit words of data to acc. At most 64 kB are summed at a
+   time, so neither the accumulators below nor acc can overflow. */
+typedef uint64_t (* sum_function)(uint64_t acc, const uint8_t *data,
+                                  uint16_t len);
+static sum_function sum_words;
+/*---------------------------------------------------------------------------*/
+static uint64_t
+sum_word(uint64_t acc, const uint8_t *data, uint16_t len)
+{
+#ifdef __SIZEOF_INT128__
+  unsigned __int128 wide = acc;
+  uint64_t w[4];
+
+  /* Add with carry into the upper half, four words per round */
+  while(len >= sizeof(w)) {
+    memcpy(w, data, sizeof(w));
+    wide += w[0];
+    wide += w[1];
+    wide += w[2];
+    wide += w[3];
+    data += sizeof(w);
+    len -= sizeof(w);
+  }
+  acc = (uint64_t)wide;
+  acc = (acc >> 32) + (uint32_t)acc + (uint64_t)(wide >> 64);
+#endif
+  while(len >= 4) {
+    uint32_t w32;
+
+    memcpy(&w32, data, sizeof(w32));
+    acc += w32;
+    data += 4;
+    len -= 4;
+  }
+  if(len >= 2) {
+    uint16_t w16;
+
+    memcpy(&w16, data, sizeof(w16));
+    acc += w16;
+    data += 2;
+    len -= 2;
+  }
+  if(len > 0) {
+    /* The last byte is the first one of a word padded with zero */
+    acc += SWAP16((uint16_t)(data[0] << 8));
+  }
+  return acc;
+}
+/*---------------------------------------------------------------------------*/
+#if CHKSUM_X86
+static uint64_t
+sum_sse2(uint64_t acc, const uint8_t *data, uint16_t len)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sum0 = zero, sum1 = zero;
+  __m128i v;
+  uint32_t lanes[4];
+
+  /* Widen the 16-bit words to 32 bits, a lane gets at most 4096 of
+     them. Two sums keep the additions independent. */
+  while(len >= 32) {
+    v = _mm_loadu_si128((const __m128i *)data);
+    sum0 = _mm_add_epi32(sum0, _mm_unpacklo_epi16(v, zero));
+    sum1 = _mm_add_epi32(sum1, _mm_unpackhi_epi16(v, zero));
+    v = _mm_loadu_si128((const __m128i *)(data + 16));
+    sum0 = _mm_add_epi32(sum0, _mm_unpacklo_epi16(v, zero));
+    sum1 = _mm_add_epi32(sum1, _mm_unpackhi_epi16(v, zero));
+    data += 32;
+    len -= 32;
+  }
+  if(len >= 16) {
+    v = _mm_loadu_si128((const __m128i *)data);
+    sum0 = _mm_add_epi32(sum0, _mm_unpacklo_epi16(v, zero));
+    sum1 = _mm_add_epi32(sum1, _mm_unpackhi_epi16(v, zero));
+    data += 16;
+    len -= 16;
+  }
+  _mm_storeu_si128((__m128i *)lanes, _mm_add_epi32(sum0, sum1));
+  acc += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  return sum_word(acc, data, len);
+}
+/*---------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static uint64_t
+sum_avx2(uint64_t acc, const uint8_t *data, uint16_t len)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i sum0 = zero, sum1 = zero;
+  __m256i v;
+  uint32_t lanes[8];
+  int i;
+
+  while(len >= 64) {
+    v = _mm256_loadu_si256((const __m256i *)data);
+    sum0 = _mm256_add_epi32(sum0, _mm256_unpacklo_epi16(v, zero));
+    sum1 = _mm256_add_epi32(sum1, _mm256_unpackhi_epi16(v, zero));
+    v = _mm256_loadu_si256((const __m256i *)(data + 32));
+    sum0 = _mm256_add_epi32(sum0, _mm256_unpacklo_epi16(v, zero));
+    sum1 = _mm256_add_epi32(sum1, _mm256_unpackhi_epi16(v, zero));
+    data += 64;
+    len -= 64;
+  }
+  _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi32(sum0, sum1));
+  for(i = 0; i < 8; i++) {
+    acc += lanes[i];
+  }
+  /* Not every optimization level clears the upper halves before the
+     SSE2 code, which then pays for saving them */
+  _mm256_zeroupper();
+  return sum_sse2(acc, data, len);
+}
+#endif /* CHKSUM_X86 */
+/*---------------------------------------------------------------------------*/
+int
+uip_chksum_arch_use(int impl)
+{
+  switch(impl) {
+  case UIP_CHKSUM_ARCH_WORD:
+    sum_words = sum_word;
+    return 1;
+#if CHKSUM_X86
+  case UIP_CHKSUM_ARCH_SSE2:
+    sum_words = sum_sse2;
+    return 1;
+  case UIP_CHKSUM_ARCH_AVX2:
+    if(__builtin_cpu_supports("avx2")) {
+      sum_words = sum_avx2;
+      return 1;
+    }
+    return 0;
+#endif /* CHKSUM_X86 */
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint64_t acc;
+
+  if(sum_words == NULL &&
+     !uip_chksum_arch_use(UIP_CHKSUM_ARCH_AVX2) &&
+     !uip_chksum_arch_use(UIP_CHKSUM_ARCH_SSE2)) {
+    uip_chksum_arch_use(UIP_CHKSUM_ARCH_WORD);
+  }
+
+  acc = sum_words(SWAP16(sum), data, len);
+
+  /* Fold the carries back in, the sum is zero only if all of the
+     words are */
+  acc = (acc >> 32) + (uint32_t)acc;
+  acc = (acc >> 32) + (uint32_t)acc;
+  acc = (acc >> 16) + (uint16_t)acc;
+  acc = (acc >> 16) + (uint16_t)acc;
+
+  /* Return sum in host byte order. */
+  return SWAP16((uint16_t)acc);
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_chksum(uint16_t *data, uint16_t len)
+{
+  return uip_htons(chksum(0, (uint8_t *)data, len));
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_ipchksum(void)
+{
+  uint16_t sum;
+
+  sum = chksum(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
+  return (sum == 0) ? 0xffff : uip_htons(sum);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+upper_layer_chksum(uint8_t proto)
+{
+  uint16_t upper_layer_len;
+  uint16_t sum;
+
+#if UIP_CONF_IPV6
+  upper_layer_len = (((uint16_t)(BUF->len[0]) << 8) + BUF->len[1]) - uip_ext_len;
+#else /* UIP_CONF_IPV6 */
+  upper_layer_len = (((uint16_t)(BUF->len[0]) << 8) + BUF->len[1]) - UIP_IPH_LEN;
+#endif /* UIP_CONF_IPV6 */
+
+  /* First sum pseudoheader. */
+
+  /* IP protocol and length fields. This addition cannot carry. */
+  sum = upper_layer_len + proto;
+  /* Sum IP source and destination addresses. */
+  sum = chksum(sum, (uint8_t *)&BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
+
+  /* Sum TCP header and data. */
+#if UIP_CONF_IPV6
+  sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + uip_ext_len],
+               upper_layer_len);
+#else /* UIP_CONF_IPV6 */
+  sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN],
+               upper_layer_len);
+#endif /* UIP_CONF_IPV6 */
+
+  return (sum == 0) ? 0xffff : uip_htons(sum);
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_CONF_IPV6
+uint16_t
+uip_icmp6chksum(void)
+{
+  return upper_layer_chksum(UIP_PROTO_ICMP6);
+}
+#endif /* UIP_CONF_IPV6 */
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP
+uint16_t
+uip_tcpchksum(void)
+{
+  return upper_layer_chksum(UIP_PROTO_TCP);
+}
+#endif /* UIP_TCP */
+/*---------------------------------------------------------------------------*/
+#if UIP_UDP_CHECKSUMS
+uint16_t
+uip_udpchksum(void)
+{
+  return upper_layer_chksum(UIP_PROTO_UDP);
+}
+#endif /* UIP_UDP_CHECKSUMS */
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_ARCH_CHKSUM */
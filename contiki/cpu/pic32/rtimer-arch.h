@@ -50,6 +50,12 @@
 #ifndef __RTIMER_ARCH_H__
 #define __RTIMER_ARCH_H__
 
+/* The pending tasks are updated with the interrupts disabled, di
+   returns the Status register whose bit 0 enables them */
+#define RTIMER_ARCH_DISABLE(s) asm volatile("di %0" : "=r" (s))
+#define RTIMER_ARCH_RESTORE(s) \
+  do { if((s) & 1) { asm volatile("ei"); } } while(0)
+
 #include "contiki-conf.h"
 
 #include <stdint.h>
@@ -45,6 +45,10 @@
 #ifndef __RTIMER_ARCH_H__
 #define __RTIMER_ARCH_H__
 
+/* The pending tasks are updated with the rtimer interrupt disabled */
+#define RTIMER_ARCH_DISABLE(s) do { (s) = 0; rtimer_arch_disable_irq(); } while(0)
+#define RTIMER_ARCH_RESTORE(s) rtimer_arch_enable_irq()
+
 #define RTIMER_ARCH_RES_341US 0
 #define RTIMER_ARCH_RES_171US 1
 #define RTIMER_ARCH_RES_85US  2
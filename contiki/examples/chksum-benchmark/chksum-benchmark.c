@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Checks the uIP checksum of the native platform against the
+ *         portable one from uip.c, and measures them on MTU sized
+ *         packets
+ * \author
+ *         agent <agent@local>
+ */
+
+#include "contiki.h"
+#include "net/uip.h"
+#include "uip-chksum.h"
+#include "lib/random.h"
+
+#include <stdio.h> /* For printf() */
+#include <string.h>
+#include <time.h>
+
+#define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+#define MAXLEN 1600
+#define ROUNDS 1000000UL
+
+static uint8_t data[MAXLEN + 64];
+static volatile uint16_t result;
+
+static const char *names[] = { "word", "sse2", "avx2" };
+/*---------------------------------------------------------------------------*/
+PROCESS(chksum_benchmark_process, "Checksum benchmark process");
+AUTOSTART_PROCESSES(&chksum_benchmark_process);
+/*---------------------------------------------------------------------------*/
+/* The portable chksum() of uip.c */
+static uint16_t
+chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint16_t t;
+  const uint8_t *dataptr;
+  const uint8_t *last_byte;
+
+  dataptr = data;
+  last_byte = data + len - 1;
+
+  while(dataptr < last_byte) {   /* At least two more bytes */
+    t = (dataptr[0] << 8) + dataptr[1];
+    sum += t;
+    if(sum < t) {
+      sum++;      /* carry */
+    }
+    dataptr += 2;
+  }
+
+  if(dataptr == last_byte) {
+    t = (dataptr[0] << 8) + 0;
+    sum += t;
+    if(sum < t) {
+      sum++;      /* carry */
+    }
+  }
+
+  /* Return sum in host byte order. */
+  return sum;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+reference(const uint8_t *data, uint16_t len)
+{
+  return uip_htons(chksum(0, data, len));
+}
+/*---------------------------------------------------------------------------*/
+static void
+fill(int pattern)
+{
+  int i;
+
+  for(i = 0; i < sizeof(data); i++) {
+    switch(pattern) {
+    case 0:
+      data[i] = random_rand();
+      break;
+    case 1:
+      data[i] = 0xff;
+      break;
+    case 2:
+      data[i] = 0;
+      break;
+    default:
+      data[i] = i & 1 ? 0x00 : 0xff;
+      break;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Every length and alignment of a few patterns, and the TCP checksum
+   of random packets, which starts from the pseudo header sum */
+static unsigned long
+check(unsigned long *cases)
+{
+  unsigned long errors = 0;
+  uint16_t len, offset, sum;
+  int pattern, i;
+
+  for(pattern = 0; pattern < 4; pattern++) {
+    fill(pattern);
+    for(offset = 0; offset < 64; offset += pattern == 0 ? 1 : 7) {
+      for(len = 0; len <= MAXLEN; len++) {
+        (*cases)++;
+        if(uip_chksum((uint16_t *)&data[offset], len) !=
+           reference(&data[offset], len)) {
+          errors++;
+        }
+      }
+    }
+  }
+
+  for(i = 0; i < 10000; i++) {
+    len = UIP_IPH_LEN + random_rand() % (UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPH_LEN);
+    for(offset = 0; offset < UIP_BUFSIZE; offset++) {
+      uip_buf[offset] = i & 1 ? random_rand() : 0xff;
+    }
+    len -= UIP_IPH_LEN;
+#if UIP_CONF_IPV6
+    /* The length field holds the payload length */
+    uip_ext_len = 0;
+    BUF->len[0] = len >> 8;
+    BUF->len[1] = len & 0xff;
+#else /* UIP_CONF_IPV6 */
+    BUF->len[0] = (len + UIP_IPH_LEN) >> 8;
+    BUF->len[1] = (len + UIP_IPH_LEN) & 0xff;
+#endif /* UIP_CONF_IPV6 */
+    sum = chksum(len + UIP_PROTO_TCP, (uint8_t *)&BUF->srcipaddr,
+                 2 * sizeof(uip_ipaddr_t));
+    sum = chksum(sum, &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN], len);
+    sum = (sum == 0) ? 0xffff : uip_htons(sum);
+    (*cases)++;
+    if(uip_tcpchksum() != sum) {
+      errors++;
+    }
+  }
+  return errors;
+}
+/*---------------------------------------------------------------------------*/
+static void
+measure(const char *name, uint16_t (* f)(const uint8_t *, uint16_t),
+        uint16_t len)
+{
+  clock_t start;
+  unsigned long i, ms;
+
+  start = clock();
+  for(i = 0; i < ROUNDS; i++) {
+    result = f(&data[i & 1], len);
+  }
+  ms = (clock() - start) * 1000UL / CLOCKS_PER_SEC;
+  printf("%-9s %4u bytes %6lu ms %8.1f ns each %8.0f MB/s\n", name, len, ms,
+         1e6 * ms / ROUNDS, ms > 0 ? (double)len * ROUNDS / ms / 1000 : 0.0);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+native(const uint8_t *data, uint16_t len)
+{
+  return uip_chksum((uint16_t *)data, len);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(chksum_benchmark_process, ev, data)
+{
+  static unsigned long cases, errors;
+  static int impl;
+
+  PROCESS_BEGIN();
+
+  for(impl = UIP_CHKSUM_ARCH_WORD; impl <= UIP_CHKSUM_ARCH_AVX2; impl++) {
+    if(!uip_chksum_arch_use(impl)) {
+      printf("%-9s not supported by this CPU\n", names[impl]);
+      continue;
+    }
+    cases = 0;
+    errors = check(&cases);
+    printf("%-9s %lu cases, %lu differ from the portable checksum\n",
+           names[impl], cases, errors);
+  }
+
+  fill(0);
+  measure("portable", reference, 1280);
+  measure("portable", reference, 1500);
+  for(impl = UIP_CHKSUM_ARCH_WORD; impl <= UIP_CHKSUM_ARCH_AVX2; impl++) {
+    if(uip_chksum_arch_use(impl)) {
+      measure(names[impl], native, 1280);
+      measure(names[impl], native, 1500);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
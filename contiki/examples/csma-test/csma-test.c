@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Sends packets through CSMA to neighbors that share one
+ *         channel, one of them slow and never acking, and checks how
+ *         CSMA spaces and completes the transmissions
+ * \author
+ *         agent <agent@local>
+ */
+
+#include "contiki.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "net/mac/csma.h"
+#include "lib/random.h"
+
+#include <stdio.h> /* For printf() */
+#include <string.h>
+
+#define NEIGHBORS 8
+/* The last neighbor never acks and takes this much longer to send to */
+#define BAD       (NEIGHBORS - 1)
+#define SLOWDOWN  4
+#define PACKETS   2000
+/* Clock ticks between two packets */
+#define INTERVAL  3
+/* The channel check interval of the RDC layer, which CSMA waits
+   between two frames to the same neighbor */
+#define TIMEBASE  2
+
+struct frame {
+  uint16_t seqno;
+  clock_time_t queued;
+};
+
+/* The frame on the channel, which is put back in packetbuf for the
+   callback as CSMA updates its queued copy from there */
+static struct ctimer channel_timer;
+static uint8_t busy, busy_neighbor;
+static mac_callback_t busy_sent;
+static void *busy_ptr;
+static uint8_t busy_data[PACKETBUF_SIZE];
+static uint16_t busy_len;
+static struct packetbuf_attr busy_attrs[PACKETBUF_NUM_ATTRS];
+static struct packetbuf_addr busy_addrs[PACKETBUF_NUM_ADDRS];
+
+static clock_time_t last_done[NEIGHBORS];
+static unsigned long delivered[NEIGHBORS], offered[NEIGHBORS];
+static unsigned long completed, too_early;
+/*---------------------------------------------------------------------------*/
+PROCESS(csma_test_process, "CSMA test process");
+AUTOSTART_PROCESSES(&csma_test_process);
+/*---------------------------------------------------------------------------*/
+static int
+neighbor(const rimeaddr_t *addr)
+{
+  return addr->u8[0] - 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+channel_done(void *ptr)
+{
+  int n = busy_neighbor;
+
+  busy = 0;
+  last_done[n] = clock_time();
+  if(n != BAD) {
+    delivered[n]++;
+  }
+  packetbuf_clear();
+  packetbuf_copyfrom(busy_data, busy_len);
+  packetbuf_attr_copyfrom(busy_attrs, busy_addrs);
+  mac_call_sent_callback(busy_sent, busy_ptr,
+                         n == BAD ? MAC_TX_NOACK : MAC_TX_OK, 1);
+}
+/*---------------------------------------------------------------------------*/
+/* An RDC layer on a single channel: a frame sent while another one is
+   on the air collides, the others are on the air for a tick */
+static void
+send(mac_callback_t sent, void *ptr)
+{
+  struct frame f;
+  int n = neighbor(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+
+  /* A frame that waited for the previous one must be spaced from it */
+  memcpy(&f, packetbuf_dataptr(), sizeof(f));
+  if(f.queued < last_done[n] &&
+     (clock_time_t)(clock_time() - last_done[n]) < TIMEBASE) {
+    too_early++;
+  }
+
+  if(busy) {
+    last_done[n] = clock_time();
+    mac_call_sent_callback(sent, ptr, MAC_TX_COLLISION, 1);
+    return;
+  }
+  busy = 1;
+  busy_neighbor = n;
+  busy_len = packetbuf_copyto(busy_data);
+  packetbuf_attr_copyto(busy_attrs, busy_addrs);
+  busy_sent = sent;
+  busy_ptr = ptr;
+  ctimer_set(&channel_timer, n == BAD ? SLOWDOWN : 1, channel_done, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *list)
+{
+  if(list != NULL) {
+    queuebuf_to_packetbuf(list->buf);
+    send(sent, ptr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+input(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+static int
+on(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+off(int keep_radio_on)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+channel_check_interval(void)
+{
+  return TIMEBASE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+const struct rdc_driver csma_test_rdc_driver = {
+  "csma-test",
+  init,
+  send,
+  send_list,
+  input,
+  on,
+  off,
+  channel_check_interval,
+};
+/*---------------------------------------------------------------------------*/
+static void
+packet_sent(void *ptr, int status, int num_tx)
+{
+  completed++;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(csma_test_process, ev, data)
+{
+  static struct etimer et;
+  static uint16_t seqno;
+  struct frame f;
+  rimeaddr_t addr;
+  unsigned long good_delivered, good_offered;
+  int n;
+
+  PROCESS_BEGIN();
+
+  printf("csma-test: %d neighbors, %d packets\n", NEIGHBORS, PACKETS);
+  csma_stats_reset();
+
+  for(seqno = 0; seqno < PACKETS; seqno++) {
+    n = random_rand() % NEIGHBORS;
+    offered[n]++;
+    memset(&addr, 0, sizeof(addr));
+    addr.u8[0] = n + 1;
+    f.seqno = seqno;
+    f.queued = clock_time();
+
+    packetbuf_clear();
+    packetbuf_copyfrom(&f, sizeof(f));
+    packetbuf_set_datalen(32);
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &addr);
+    NETSTACK_MAC.send(packet_sent, NULL);
+
+    etimer_set(&et, INTERVAL);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  }
+
+  /* Let the queues drain */
+  etimer_set(&et, 10 * CLOCK_SECOND);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  good_delivered = good_offered = 0;
+  for(n = 0; n < NEIGHBORS; n++) {
+    if(n != BAD) {
+      good_delivered += delivered[n];
+      good_offered += offered[n];
+    }
+  }
+  printf("csma-test: %lu of %lu packets on the good links delivered\n",
+         good_delivered, good_offered);
+#if CSMA_STATS
+  printf("csma-test: %lu dropped, %lu no buffer, %lu neighbor full, %lu collisions\n",
+         csma_stats.dropped, csma_stats.no_buffer, csma_stats.neighbor_full,
+         csma_stats.collisions);
+#endif /* CSMA_STATS */
+  if(completed != PACKETS || too_early > 0) {
+    printf("csma-test: FAIL, %lu of %d packets completed, %lu frames too early\n",
+           completed, PACKETS, too_early);
+  } else {
+    printf("csma-test: OK\n");
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Checks the route lookup of uip-ds6 against a scan of the
+ *         routing table, and measures neighbor and route lookups
+ * \author
+ *         agent <agent@local>
+ */
+
+#include "contiki.h"
+#include "net/tcpip.h"
+#include "net/uip.h"
+#include "net/uip-ds6.h"
+#include "lib/list.h"
+#include "lib/random.h"
+
+#include <stdio.h> /* For printf() */
+#include <time.h>
+#include <string.h>
+
+#define ENTRIES UIP_DS6_ROUTE_NB
+#define LOOKUPS 1024
+
+#if UIP_DS6_NBR_HASH
+#define NBR_NAME "hash"
+#else
+#define NBR_NAME "list"
+#endif
+#if UIP_DS6_ROUTE_TRIE
+#define ROUTE_NAME "trie"
+#else
+#define ROUTE_NAME "list"
+#endif
+
+static uip_ipaddr_t nbr_addr[LOOKUPS];
+static uip_ipaddr_t route_addr[LOOKUPS];
+static volatile void *result;
+/*---------------------------------------------------------------------------*/
+PROCESS(ds6_benchmark_process, "uip-ds6 benchmark process");
+AUTOSTART_PROCESSES(&ds6_benchmark_process);
+/*---------------------------------------------------------------------------*/
+/* The longest matching route, by scanning the routing table */
+static uip_ds6_route_t *
+reference(uip_ipaddr_t *addr)
+{
+  uip_ds6_route_t *r, *found_route;
+
+  found_route = NULL;
+  for(r = uip_ds6_route_list_head(); r != NULL; r = list_item_next(r)) {
+    if((found_route == NULL || r->length > found_route->length) &&
+       uip_ipaddr_prefixcmp(addr, &r->ipaddr, r->length)) {
+      found_route = r;
+    }
+  }
+  return found_route;
+}
+/*---------------------------------------------------------------------------*/
+/* Host routes, and every eighth entry a /64 within a /48 */
+static void
+fill(void)
+{
+  static uip_ipaddr_t nbrs[ENTRIES], hosts[ENTRIES];
+  uip_ipaddr_t addr, nexthop;
+  uint16_t i, nhosts;
+
+  uip_ip6addr(&nexthop, 0xfe80, 0, 0, 0, 0x0212, 0x7400, 0, 1);
+  nhosts = 0;
+  for(i = 0; i < ENTRIES; i++) {
+    uip_ip6addr(&addr, 0xfe80, 0, 0, 0, 0x0212, 0x7400, random_rand(), i);
+    uip_ds6_nbr_add(&addr, NULL, 0, NBR_REACHABLE);
+    uip_ipaddr_copy(&nbrs[i], &addr);
+
+    switch(i % 8) {
+    case 0:
+      /* Before the /48, or adding it would update the /48 instead */
+      uip_ip6addr(&addr, 0xcccc, i / 8, 1, 0, 0, 0, 0, 0);
+      uip_ds6_route_add(&addr, 64, &nexthop, 0);
+      break;
+    case 1:
+      uip_ip6addr(&addr, 0xcccc, i / 8, 0, 0, 0, 0, 0, 0);
+      uip_ds6_route_add(&addr, 48, &nexthop, 0);
+      break;
+    default:
+      uip_ip6addr(&addr, 0xaaaa, 0, 0, 0, 0x0212, 0x7400, random_rand(), i);
+      uip_ds6_route_add(&addr, 128, &nexthop, 0);
+      uip_ipaddr_copy(&hosts[nhosts++], &addr);
+      break;
+    }
+  }
+
+  /* Neighbors from all over the cache, a quarter of the routes looked
+     up within the prefixes and one in eight missing every route */
+  for(i = 0; i < LOOKUPS; i++) {
+    uip_ipaddr_copy(&nbr_addr[i], &nbrs[random_rand() % ENTRIES]);
+    switch(random_rand() % 8) {
+    case 0:
+    case 1:
+      uip_ip6addr(&route_addr[i], 0xcccc, random_rand() % (ENTRIES / 8 + 1),
+                  1 + random_rand() % 2, 0, 0, 0, 0, random_rand());
+      break;
+    case 2:
+      uip_ip6addr(&route_addr[i], 0xdddd, 0, 0, 0, 0, 0, 0, random_rand());
+      break;
+    default:
+      uip_ipaddr_copy(&route_addr[i], &hosts[random_rand() % nhosts]);
+      break;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void *
+nbr_lookup(uip_ipaddr_t *addr)
+{
+  return uip_ds6_nbr_lookup(addr);
+}
+/*---------------------------------------------------------------------------*/
+static void *
+route_lookup(uip_ipaddr_t *addr)
+{
+  return uip_ds6_route_lookup(addr);
+}
+/*---------------------------------------------------------------------------*/
+static void
+measure(const char *table, const char *name, void *(* f)(uip_ipaddr_t *),
+        uip_ipaddr_t *addr)
+{
+  clock_t start, time;
+  unsigned long i, n;
+
+  n = 0;
+  start = clock();
+  do {
+    for(i = 0; i < LOOKUPS; i++) {
+      result = f(&addr[i]);
+    }
+    n += LOOKUPS;
+    time = clock() - start;
+  } while(time < CLOCKS_PER_SEC / 2);
+  printf("%-6s %s %5u entries %10.1f ns each\n", table, name, ENTRIES,
+         1e9 * time / CLOCKS_PER_SEC / n);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ds6_benchmark_process, ev, data)
+{
+  static unsigned long errors, missing;
+  static uint16_t i;
+
+  PROCESS_BEGIN();
+
+  /* The tables are set up by uIP, which sofasim does not start */
+  if(!process_is_running(&tcpip_process)) {
+    uip_init();
+  }
+  fill();
+
+  errors = missing = 0;
+  for(i = 0; i < LOOKUPS; i++) {
+    if(uip_ds6_route_lookup(&route_addr[i]) != reference(&route_addr[i])) {
+      errors++;
+    }
+    if(uip_ds6_nbr_lookup(&nbr_addr[i]) == NULL) {
+      missing++;
+    }
+  }
+  printf("%u neighbors, %d routes, %lu of %u route lookups differ from "
+         "a scan, %lu neighbors not found\n",
+         ENTRIES, uip_ds6_route_num_routes(), errors, LOOKUPS, missing);
+
+  measure("nbr", NBR_NAME, nbr_lookup, nbr_addr);
+  measure("route", ROUTE_NAME, route_lookup, route_addr);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
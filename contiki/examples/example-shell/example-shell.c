@@ -83,6 +83,7 @@ PROCESS_THREAD(example_shell_process, ev, data)
   shell_run_init();
   shell_sendtest_init();
   /*shell_sky_init();*/
+  shell_sofa_init();
   shell_tcpsend_init();
   shell_text_init();
   shell_time_init();
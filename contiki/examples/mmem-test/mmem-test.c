@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Randomized test of the managed memory allocator: allocates,
+ *         frees and compacts blocks at random and checks that every
+ *         block keeps its contents wherever it is moved
+ * \author
+ *         agent <agent@local>
+ */
+
+#include "contiki.h"
+#include "lib/mmem.h"
+#include "lib/random.h"
+
+#include <stdio.h> /* For printf() */
+
+#ifdef MMEM_TEST_CONF_OPERATIONS
+#define OPERATIONS MMEM_TEST_CONF_OPERATIONS
+#else
+#define OPERATIONS 400000UL
+#endif
+
+#ifdef MMEM_CONF_FREELIST
+#define MODE (MMEM_CONF_FREELIST ? "free list" : "compacting")
+#else
+#define MODE "compacting"
+#endif
+
+#define BLOCKS     48
+#define MAX_SIZE   200
+/* Let the idle compaction run every this many operations */
+#define YIELD_EVERY 1000
+
+static struct mmem blocks[BLOCKS];
+static unsigned char tags[BLOCKS];
+static unsigned char used[BLOCKS];
+static unsigned long allocated, failed;
+/*---------------------------------------------------------------------------*/
+PROCESS(mmem_test_process, "Managed memory test process");
+AUTOSTART_PROCESSES(&mmem_test_process);
+/*---------------------------------------------------------------------------*/
+static void
+fill(int i)
+{
+  unsigned char *p = (unsigned char *)MMEM_PTR(&blocks[i]);
+  unsigned int j;
+
+  for(j = 0; j < blocks[i].size; j++) {
+    p[j] = tags[i] + j;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the index of the first block whose contents changed, or -1 */
+static int
+check(void)
+{
+  unsigned char *p;
+  unsigned int j;
+  int i;
+
+  for(i = 0; i < BLOCKS; i++) {
+    if(!used[i]) {
+      continue;
+    }
+    p = (unsigned char *)MMEM_PTR(&blocks[i]);
+    for(j = 0; j < blocks[i].size; j++) {
+      if(p[j] != (unsigned char)(tags[i] + j)) {
+        return i;
+      }
+    }
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(mmem_test_process, ev, data)
+{
+  static struct etimer et;
+  static unsigned long op;
+  struct mmem_stats stats;
+  int i, bad;
+
+  PROCESS_BEGIN();
+
+  mmem_init();
+  printf("mmem-test: %s mode, %lu operations\n", MODE, OPERATIONS);
+
+  for(op = 0; op < OPERATIONS; op++) {
+    i = random_rand() % BLOCKS;
+    if(used[i]) {
+      mmem_free(&blocks[i]);
+      used[i] = 0;
+    } else if(mmem_alloc(&blocks[i], 1 + random_rand() % MAX_SIZE)) {
+      used[i] = 1;
+      tags[i] = random_rand();
+      fill(i);
+      allocated++;
+    } else {
+      failed++;
+    }
+
+    if(random_rand() % 16 == 0) {
+      mmem_compact(random_rand() % (2 * MAX_SIZE));
+    }
+
+    if(op % YIELD_EVERY == 0) {
+      bad = check();
+      if(bad >= 0) {
+        printf("mmem-test: FAIL, block %d changed after %lu operations\n",
+               bad, op);
+        PROCESS_EXIT();
+      }
+      /* Give the idle compaction a chance to run */
+      etimer_set(&et, 1);
+      PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    }
+  }
+
+  bad = check();
+  mmem_stats(&stats);
+  if(bad >= 0) {
+    printf("mmem-test: FAIL, block %d changed\n", bad);
+  } else {
+    printf("mmem-test: OK, %lu allocations, %lu failed, %lu bytes moved\n",
+           allocated, failed, stats.moved);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Microbenchmark of the multi-threading library: switches
+ *         between a Contiki thread and the kernel, and starts and stops
+ *         many short-lived threads
+ * \author
+ *         agent <agent@local>
+ */
+
+#include "contiki.h"
+#include "sys/mt.h"
+
+#include <stdio.h> /* For printf() */
+
+#ifdef MT_BENCHMARK_CONF_SWITCHES
+#define SWITCHES MT_BENCHMARK_CONF_SWITCHES
+#else
+#define SWITCHES 2000000UL
+#endif
+
+#define THREADS 20000UL
+
+static unsigned long yields;
+/*---------------------------------------------------------------------------*/
+PROCESS(mt_benchmark_process, "Multi-threading benchmark process");
+AUTOSTART_PROCESSES(&mt_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static void
+yielding_thread(void *data)
+{
+  while(1) {
+    yields++;
+    mt_yield();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+short_thread(void *data)
+{
+  /* Touch some stack, as a real thread would */
+  volatile char buf[512];
+
+  buf[0] = buf[sizeof(buf) - 1] = 1;
+  mt_exit();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(mt_benchmark_process, ev, data)
+{
+  static struct mt_thread thread;
+  static clock_time_t start;
+  static unsigned long i;
+
+  PROCESS_BEGIN();
+
+  mt_init();
+
+  /* Each mt_exec() switches to the thread and its mt_yield() back */
+  mt_start(&thread, yielding_thread, NULL);
+  start = clock_time();
+  for(i = 0; i < SWITCHES; i++) {
+    mt_exec(&thread);
+  }
+  printf("exec+yield %lu pairs %lu ticks\n", yields,
+         (unsigned long)(clock_time() - start));
+  mt_stop(&thread);
+
+  /* Threads that run once, as protosocket handlers in the webserver do */
+  start = clock_time();
+  for(i = 0; i < THREADS; i++) {
+    mt_start(&thread, short_thread, NULL);
+    mt_exec(&thread);
+    mt_stop(&thread);
+  }
+  printf("start+stop %lu threads %lu ticks\n", THREADS,
+         (unsigned long)(clock_time() - start));
+
+  mt_remove();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
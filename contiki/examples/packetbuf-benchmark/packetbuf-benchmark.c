@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Forwards frames through the packetbuf and the queuebufs, and
+ *         counts the bytes copied per forwarded frame
+ * \author
+ *         agent <agent@local>
+ */
+
+#include "contiki.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+
+#include <stdio.h> /* For printf() */
+#include <time.h>
+#include <string.h>
+
+/* The forwarded frames are queued QUEUEBUF_NUM at a time and each is
+   sent TRANSMISSIONS times, as if the first ones were not acked */
+#define PAYLOAD       80
+#define HDR           4
+#define TRANSMISSIONS 3
+#define FRAMES        100000
+
+#if PACKETBUF_POOL
+#define NAME "pool"
+#else
+#define NAME "single"
+#endif
+
+static uint8_t rx[PACKETBUF_SIZE];
+static int rxlen;
+static struct queuebuf *queue[QUEUEBUF_NUM];
+static rimeaddr_t nexthop;
+/*---------------------------------------------------------------------------*/
+PROCESS(packetbuf_benchmark_process, "packetbuf benchmark process");
+AUTOSTART_PROCESSES(&packetbuf_benchmark_process);
+/*---------------------------------------------------------------------------*/
+/* The frame a neighbor sends us: an 802.15.4 header, a header with a
+   hop count and a payload */
+static void
+prepare(void)
+{
+  rimeaddr_t sender;
+  int i;
+
+  packetbuf_clear();
+  for(i = 0; i < PAYLOAD; i++) {
+    ((uint8_t *)packetbuf_dataptr())[i] = i;
+  }
+  packetbuf_set_datalen(PAYLOAD);
+  packetbuf_hdralloc(HDR);
+  memset(packetbuf_hdrptr(), 0, HDR);
+  memset(&sender, 2, sizeof(sender));
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &sender);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &rimeaddr_node_addr);
+  NETSTACK_FRAMER.create();
+  packetbuf_compact();
+  rxlen = packetbuf_totlen();
+  memcpy(rx, packetbuf_hdrptr(), rxlen);
+
+  memset(&nexthop, 3, sizeof(nexthop));
+}
+/*---------------------------------------------------------------------------*/
+/* Receive frame i and queue it for the next hop, like Rime forwarding
+   it through a MAC with a queue */
+static int
+forward(uint32_t i)
+{
+  uint8_t hops;
+
+  /* The radio driver reads the frame into the packetbuf */
+  packetbuf_clear();
+  memcpy(packetbuf_dataptr(), rx, rxlen);
+  memcpy((uint8_t *)packetbuf_dataptr() + rxlen - sizeof(i), &i, sizeof(i));
+  packetbuf_set_datalen(rxlen);
+
+  if(NETSTACK_FRAMER.parse() < 0) {
+    return 0;
+  }
+  hops = *(uint8_t *)packetbuf_dataptr();
+  packetbuf_hdrreduce(HDR);
+
+  packetbuf_hdralloc(HDR);
+  memset(packetbuf_hdrptr(), 0, HDR);
+  *(uint8_t *)packetbuf_hdrptr() = hops + 1;
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &nexthop);
+  packetbuf_compact();
+
+  queue[i % QUEUEBUF_NUM] = queuebuf_new_from_packetbuf();
+  return queue[i % QUEUEBUF_NUM] != NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Send the queued frame i, as the MAC does on every transmission */
+static int
+transmit(uint32_t i)
+{
+  uint8_t *frame;
+  int len, hdrlen, j;
+
+  queuebuf_to_packetbuf(queue[i % QUEUEBUF_NUM]);
+  hdrlen = NETSTACK_FRAMER.create();
+  if(hdrlen < 0) {
+    return 0;
+  }
+
+  /* The radio driver sends the frame from the packetbuf */
+  frame = packetbuf_hdrptr();
+  len = packetbuf_totlen();
+  if(len != hdrlen + HDR + PAYLOAD || frame[hdrlen] != 1 ||
+     memcmp(frame + len - sizeof(i), &i, sizeof(i)) != 0) {
+    return 0;
+  }
+  for(j = 0; j < PAYLOAD - (int)sizeof(i); j++) {
+    if(frame[hdrlen + HDR + j] != j) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(packetbuf_benchmark_process, ev, data)
+{
+  static clock_t start, time;
+  static uint32_t i, j, k;
+  static unsigned long errors;
+
+  PROCESS_BEGIN();
+
+  prepare();
+
+  errors = 0;
+  packetbuf_stats_reset();
+  start = clock();
+  for(i = 0; i < FRAMES; i += QUEUEBUF_NUM) {
+    for(j = i; j < i + QUEUEBUF_NUM; j++) {
+      if(!forward(j)) {
+        errors++;
+      }
+    }
+    /* Interleave the transmissions of the queued frames */
+    for(k = 0; k < TRANSMISSIONS; k++) {
+      for(j = i; j < i + QUEUEBUF_NUM; j++) {
+        if(queue[j % QUEUEBUF_NUM] != NULL && !transmit(j)) {
+          errors++;
+        }
+      }
+    }
+    for(j = i; j < i + QUEUEBUF_NUM; j++) {
+      if(queue[j % QUEUEBUF_NUM] != NULL) {
+        queuebuf_free(queue[j % QUEUEBUF_NUM]);
+      }
+    }
+  }
+  time = clock() - start;
+
+  printf("%s: %u frames of %u bytes, %u transmissions each, %lu errors\n",
+         NAME, FRAMES, rxlen, TRANSMISSIONS, errors);
+  printf("%s: per forwarded frame %.1f bytes copied, %.1f moved, "
+         "%.1f attribute bytes copied, %.2f frames copied, %.1f ns\n", NAME,
+         (double)packetbuf_stats.copied / FRAMES,
+         (double)packetbuf_stats.moved / FRAMES,
+         (double)packetbuf_stats.attr_copied / FRAMES,
+         (double)packetbuf_stats.unshared / FRAMES,
+         1e9 * time / CLOCKS_PER_SEC / FRAMES);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
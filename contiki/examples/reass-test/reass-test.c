@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Feeds the fragments of datagrams from several senders at once
+ *         to the 6LoWPAN layer, reordered and duplicated, and checks
+ *         the datagrams it reassembles
+ * \author
+ *         agent <agent@local>
+ */
+
+#include "contiki.h"
+#include "net/uip.h"
+#include "net/rime.h"
+#include "net/netstack.h"
+#include "net/sicslowpan.h"
+#include "lib/random.h"
+
+#include <stdio.h> /* For printf() */
+#include <string.h>
+
+#define SENDERS   10
+#define DATAGRAMS 20
+
+/* The first fragment holds the IPv6 header and 8 bytes of payload */
+#define FIRST_LEN 48
+#define FRAG_LEN  24
+#define MIN_SIZE  (FIRST_LEN + 1)
+#define MAX_SIZE  (UIP_BUFSIZE - UIP_LLH_LEN)
+#define MAX_FRAGS (1 + (MAX_SIZE - FIRST_LEN + FRAG_LEN - 1) / FRAG_LEN)
+
+struct sender {
+  /* The datagram being sent, its fragments in the order they are sent */
+  uint8_t datagram;
+  uint8_t order[MAX_FRAGS + 1];
+  uint8_t nfrags, next;
+};
+
+static struct sender senders[SENDERS];
+static uint8_t delivered[SENDERS][DATAGRAMS];
+static unsigned long received, corrupt, duplicate;
+
+static uint8_t expected[MAX_SIZE];
+static uint32_t gen_state;
+/*---------------------------------------------------------------------------*/
+PROCESS(reass_test_process, "6LoWPAN reassembly test process");
+AUTOSTART_PROCESSES(&reass_test_process);
+/*---------------------------------------------------------------------------*/
+static uint8_t
+gen_byte(void)
+{
+  gen_state = gen_state * 1103515245UL + 12345;
+  return gen_state >> 16;
+}
+/*---------------------------------------------------------------------------*/
+/* Both sides generate datagram d of sender s the same way */
+static uint16_t
+gen_datagram(int s, int d, uint8_t *buf)
+{
+  uint16_t size, i;
+
+  gen_state = s * DATAGRAMS + d + 1;
+  size = MIN_SIZE + gen_byte() % (MAX_SIZE - MIN_SIZE + 1);
+  for(i = 0; i < size; i++) {
+    buf[i] = gen_byte();
+  }
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_sender(int s)
+{
+  rimeaddr_t addr;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.u8[0] = s + 1;
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &addr);
+}
+/*---------------------------------------------------------------------------*/
+/* Called by sicslowpan with each datagram it reassembled in uip_buf */
+static void
+datagram_input(void)
+{
+  const rimeaddr_t *addr = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  int s, d;
+  uint16_t size;
+
+  /* It is completed by a fragment of the datagram its sender sends */
+  s = addr->u8[0] - 1;
+  d = senders[s].datagram;
+  size = gen_datagram(s, d, expected);
+  if(uip_len != size || memcmp(&uip_buf[UIP_LLH_LEN], expected, size) != 0) {
+    corrupt++;
+  } else if(delivered[s][d]) {
+    duplicate++;
+  } else {
+    delivered[s][d] = 1;
+    received++;
+  }
+}
+RIME_SNIFFER(reass_sniffer, datagram_input, NULL);
+/*---------------------------------------------------------------------------*/
+/* Shuffles the fragments of the next datagram and sends one twice now
+   and then */
+static void
+start_datagram(struct sender *sender)
+{
+  uint16_t size;
+  uint8_t i, j, t;
+
+  size = gen_datagram(sender - senders, sender->datagram, expected);
+  sender->nfrags = 1 + (size - FIRST_LEN + FRAG_LEN - 1) / FRAG_LEN;
+  for(i = 0; i < sender->nfrags; i++) {
+    sender->order[i] = i;
+  }
+  if(random_rand() % 8 == 0) {
+    sender->order[sender->nfrags] = random_rand() % sender->nfrags;
+    sender->nfrags++;
+  }
+  for(i = sender->nfrags - 1; i > 0; i--) {
+    j = random_rand() % (i + 1);
+    t = sender->order[i];
+    sender->order[i] = sender->order[j];
+    sender->order[j] = t;
+  }
+  sender->next = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Hands fragment f of the current datagram of sender s to sicslowpan as
+   the MAC would */
+static void
+send_fragment(int s, int f)
+{
+  uint8_t frame[SICSLOWPAN_FRAGN_HDR_LEN + 1 + FIRST_LEN];
+  uint8_t *p = frame;
+  uint16_t size, offset, len;
+
+  size = gen_datagram(s, senders[s].datagram, expected);
+  offset = f == 0 ? 0 : FIRST_LEN + (f - 1) * FRAG_LEN;
+  len = f == 0 ? FIRST_LEN : FRAG_LEN;
+  if(offset + len > size) {
+    len = size - offset;
+  }
+
+  /* The tag is the same for every sender */
+  *p++ = (f == 0 ? SICSLOWPAN_DISPATCH_FRAG1 : SICSLOWPAN_DISPATCH_FRAGN) |
+    (size >> 8);
+  *p++ = size & 0xff;
+  *p++ = senders[s].datagram >> 8;
+  *p++ = senders[s].datagram & 0xff;
+  if(f == 0) {
+    *p++ = SICSLOWPAN_DISPATCH_IPV6;
+  } else {
+    *p++ = offset >> 3;
+  }
+  memcpy(p, &expected[offset], len);
+
+  packetbuf_clear();
+  packetbuf_copyfrom(frame, p - frame + len);
+  set_sender(s);
+  sicslowpan_driver.input();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(reass_test_process, ev, data)
+{
+  static struct etimer et;
+  static int active;
+  struct sender *sender;
+  int s;
+
+  PROCESS_BEGIN();
+
+  printf("reass-test: %d senders, %d datagrams each, %d reassemblies\n",
+         SENDERS, DATAGRAMS, SICSLOWPAN_REASS_CONTEXTS);
+  rime_sniffer_add(&reass_sniffer);
+
+  for(s = 0; s < SENDERS; s++) {
+    start_datagram(&senders[s]);
+  }
+
+  /* One fragment from a random sender per clock tick */
+  for(active = SENDERS; active > 0;) {
+    s = random_rand() % SENDERS;
+    sender = &senders[s];
+    if(sender->datagram == DATAGRAMS) {
+      continue;
+    }
+    send_fragment(s, sender->order[sender->next++]);
+    if(sender->next == sender->nfrags) {
+      if(++sender->datagram == DATAGRAMS) {
+        active--;
+      } else {
+        start_datagram(sender);
+      }
+    }
+    etimer_set(&et, 1);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  }
+
+  if(corrupt > 0 || duplicate > 0) {
+    printf("reass-test: FAIL, %lu corrupt and %lu duplicate datagrams\n",
+           corrupt, duplicate);
+  } else {
+    printf("reass-test: OK, %lu of %d datagrams delivered\n",
+           received, SENDERS * DATAGRAMS);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
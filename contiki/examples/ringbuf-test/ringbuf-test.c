@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Randomized test of the single-producer/single-consumer ring
+ *         buffer and of the serial-line and SLIP drivers built on it
+ * \author
+ *         agent <agent@local>
+ */
+
+#include "contiki.h"
+#include "lib/ringbuf.h"
+#include "lib/random.h"
+#include "dev/serial-line.h"
+#include "dev/slip.h"
+#include "net/uip.h"
+
+#include <stdio.h> /* For printf() */
+#include <string.h>
+
+#ifdef RINGBUF_TEST_CONF_OPERATIONS
+#define OPERATIONS RINGBUF_TEST_CONF_OPERATIONS
+#else
+#define OPERATIONS 400000UL
+#endif
+
+#define PACKETS 2000UL
+#define LINES   5000UL
+
+#define RING_SIZE 64
+/* Longest block moved at once, more than fits in the ring */
+#define MAX_BULK  80
+
+#define SLIP_END     0300
+#define SLIP_ESC     0333
+#define SLIP_ESC_END 0334
+#define SLIP_ESC_ESC 0335
+
+#define PACKET_MAX (UIP_BUFSIZE - UIP_LLH_LEN)
+
+#ifdef SERIAL_LINE_CONF_BUFSIZE
+#define LINE_BUFSIZE SERIAL_LINE_CONF_BUFSIZE
+#else
+#define LINE_BUFSIZE 128
+#endif
+#define LINE_MAX (LINE_BUFSIZE - 1)
+
+enum {
+  GOOD,
+  BAD_ESCAPE,
+  TOO_LONG,
+};
+
+/* The bytes sent on the line, encoded from a packet or a line */
+static uint8_t stream[2 * (PACKET_MAX + 16) + 3];
+static uint16_t stream_len, stream_pos;
+
+/* Packets and lines sent in full, and the next one expected */
+static unsigned long tx_done, rx_next;
+static unsigned long received, lost, corrupt, good_sent;
+static uint8_t strict;
+
+static uint8_t expected[PACKET_MAX + 16];
+static uint32_t gen_state;
+/*---------------------------------------------------------------------------*/
+PROCESS(ringbuf_test_process, "Ring buffer test process");
+PROCESS(line_check_process, "Serial line check process");
+AUTOSTART_PROCESSES(&ringbuf_test_process);
+/*---------------------------------------------------------------------------*/
+/* Nothing is ever sent back on the line */
+void
+slip_arch_writeb(unsigned char c)
+{
+}
+/*---------------------------------------------------------------------------*/
+/* Both sides generate packet or line number k the same way */
+static uint8_t
+gen_byte(void)
+{
+  gen_state = gen_state * 1103515245UL + 12345;
+  return gen_state >> 16;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the length of packet k, 5% of which are broken */
+static uint16_t
+gen_packet(unsigned long k, uint8_t *buf, uint8_t *kind)
+{
+  uint16_t len, i;
+  uint8_t r;
+
+  gen_state = k;
+  r = gen_byte() % 40;
+  *kind = r == 0 ? BAD_ESCAPE : r == 1 ? TOO_LONG : GOOD;
+  if(*kind == TOO_LONG) {
+    len = PACKET_MAX + 1 + gen_byte() % 16;
+  } else {
+    len = 1 + (gen_byte() | gen_byte() << 8) % PACKET_MAX;
+  }
+
+  /* Never "CLIENT", which the driver answers itself */
+  buf[0] = 0x60;
+  for(i = 1; i < len; i++) {
+    buf[i] = gen_byte();
+    if(gen_byte() % 8 == 0) {
+      buf[i] = buf[i] & 1 ? SLIP_END : SLIP_ESC;
+    }
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+gen_line(unsigned long k, uint8_t *buf)
+{
+  uint16_t len, i;
+
+  gen_state = k;
+  len = gen_byte() % (LINE_MAX + 1);
+  for(i = 0; i < len; i++) {
+    buf[i] = ' ' + gen_byte() % 95;
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static void
+encode_packet(unsigned long k)
+{
+  uint8_t packet[PACKET_MAX + 16];
+  uint8_t kind;
+  uint16_t len, i;
+
+  len = gen_packet(k, packet, &kind);
+  if(kind == GOOD) {
+    good_sent++;
+  }
+
+  stream_len = 0;
+  for(i = 0; i < len; i++) {
+    if(kind == BAD_ESCAPE && i == len / 2) {
+      stream[stream_len++] = SLIP_ESC;
+      stream[stream_len++] = 0x01;
+    }
+    if(packet[i] == SLIP_END) {
+      stream[stream_len++] = SLIP_ESC;
+      stream[stream_len++] = SLIP_ESC_END;
+    } else if(packet[i] == SLIP_ESC) {
+      stream[stream_len++] = SLIP_ESC;
+      stream[stream_len++] = SLIP_ESC_ESC;
+    } else {
+      stream[stream_len++] = packet[i];
+    }
+  }
+  stream[stream_len++] = SLIP_END;
+  stream_pos = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Lines come with the carriage returns the driver ignores */
+static void
+encode_line(unsigned long k)
+{
+  uint8_t line[LINE_MAX];
+  uint16_t len, i;
+
+  len = gen_line(k, line);
+  stream_len = 0;
+  for(i = 0; i < len; i++) {
+    if(random_rand() % 16 == 0) {
+      stream[stream_len++] = '\r';
+    }
+    stream[stream_len++] = line[i];
+  }
+  stream[stream_len++] = '\n';
+  stream_pos = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Feeds up to max bytes to the driver like its interrupt handler would,
+   returns zero once the last packet or line has been sent */
+static int
+feed(int (*input_byte)(unsigned char), void (*encode)(unsigned long),
+     unsigned long count, uint16_t max)
+{
+  uint16_t n;
+
+  for(n = 1 + random_rand() % max; n > 0; n--) {
+    input_byte(stream[stream_pos++]);
+    if(stream_pos == stream_len) {
+      if(++tx_done == count) {
+        return 0;
+      }
+      encode(tx_done);
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+slip_packet_input(void)
+{
+  uint8_t kind;
+  uint16_t len;
+
+  /* Packets may be dropped, but never reordered or changed */
+  for(; rx_next < tx_done; rx_next++) {
+    len = gen_packet(rx_next, expected, &kind);
+    if(kind != GOOD) {
+      continue;
+    }
+    if(len == uip_len && memcmp(expected, &uip_buf[UIP_LLH_LEN], len) == 0) {
+      rx_next++;
+      received++;
+      return;
+    }
+    if(strict) {
+      break;
+    }
+    lost++;
+  }
+  corrupt++;
+}
+/*---------------------------------------------------------------------------*/
+static int
+ringbuf_test(void)
+{
+  static struct ringbuf_spsc r;
+  static uint8_t data[RING_SIZE];
+  static uint8_t model[RING_SIZE], buf[MAX_BULK];
+  uint16_t head = 0, count = 0, n, i;
+  unsigned long op;
+  uint8_t next = 0;
+  int c;
+
+  ringbuf_spsc_init(&r, data, sizeof(data));
+
+  /* The indices wrap around many times */
+  for(op = 0; op < OPERATIONS; op++) {
+    n = random_rand() % (MAX_BULK + 1);
+    switch(random_rand() % 5) {
+    case 0:
+      c = ringbuf_spsc_put(&r, next);
+      if(c != (count < RING_SIZE)) {
+        return 0;
+      }
+      if(c) {
+        model[(head + count++) % RING_SIZE] = next++;
+      }
+      break;
+    case 1:
+      for(i = 0; i < n; i++) {
+        buf[i] = next + i;
+      }
+      i = ringbuf_spsc_put_bulk(&r, buf, n);
+      if(i != (n < RING_SIZE - count ? n : RING_SIZE - count)) {
+        return 0;
+      }
+      for(n = i, i = 0; i < n; i++) {
+        model[(head + count++) % RING_SIZE] = next++;
+      }
+      break;
+    case 2:
+      c = ringbuf_spsc_get(&r);
+      if(count == 0) {
+        if(c != -1) {
+          return 0;
+        }
+      } else {
+        if(c != model[head]) {
+          return 0;
+        }
+        head = (head + 1) % RING_SIZE;
+        count--;
+      }
+      break;
+    case 3:
+      i = ringbuf_spsc_peek_bulk(&r, buf, n);
+      if(i != (n < count ? n : count)) {
+        return 0;
+      }
+      for(n = 0; n < i; n++) {
+        if(buf[n] != model[(head + n) % RING_SIZE]) {
+          return 0;
+        }
+      }
+      break;
+    case 4:
+      i = ringbuf_spsc_get_bulk(&r, buf, n);
+      if(i != (n < count ? n : count)) {
+        return 0;
+      }
+      for(n = 0; n < i; n++) {
+        if(buf[n] != model[head]) {
+          return 0;
+        }
+        head = (head + 1) % RING_SIZE;
+        count--;
+      }
+      break;
+    }
+    if(ringbuf_spsc_elements(&r) != count ||
+       ringbuf_spsc_space(&r) != RING_SIZE - count) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ringbuf_test_process, ev, data)
+{
+  static struct etimer et;
+
+  PROCESS_BEGIN();
+
+  printf("ringbuf-test: %lu ring buffer operations\n", OPERATIONS);
+  if(!ringbuf_test()) {
+    printf("ringbuf-test: FAIL, ring buffer differs from its model\n");
+    PROCESS_EXIT();
+  }
+  printf("ringbuf-test: ring buffer OK\n");
+
+  /* Let the driver catch up after every burst, nothing may be lost */
+  process_start(&slip_process, NULL);
+  slip_set_input_callback(slip_packet_input);
+  strict = 1;
+  tx_done = rx_next = 0;
+  encode_packet(0);
+  do {
+    etimer_set(&et, 1);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  } while(feed(slip_input_byte, encode_packet, PACKETS, 100));
+  etimer_set(&et, 1);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  if(received != good_sent || corrupt > 0) {
+    printf("ringbuf-test: FAIL, slip delivered %lu of %lu packets, %lu corrupt\n",
+           received, good_sent, corrupt);
+    PROCESS_EXIT();
+  }
+  printf("ringbuf-test: slip OK, %lu of %lu packets\n", received, good_sent);
+
+  /* Bursts larger than the ring: packets get dropped, but whole */
+  strict = 0;
+  tx_done = rx_next = 0;
+  received = good_sent = 0;
+  encode_packet(0);
+  do {
+    process_post(PROCESS_CURRENT(), PROCESS_EVENT_CONTINUE, NULL);
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE);
+  } while(feed(slip_input_byte, encode_packet, PACKETS, 400));
+  etimer_set(&et, 1);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  if(corrupt > 0) {
+    printf("ringbuf-test: FAIL, slip delivered %lu corrupt packets\n",
+           corrupt);
+    PROCESS_EXIT();
+  }
+  printf("ringbuf-test: slip overflow OK, %lu of %lu packets, %lu lost\n",
+         received, good_sent, good_sent - received);
+
+  /* The driver wakes up its process once the ring is half full, which
+     has to run before the next half arrives */
+  serial_line_init();
+  process_start(&line_check_process, NULL);
+  tx_done = rx_next = 0;
+  received = 0;
+  encode_line(0);
+  do {
+    etimer_set(&et, 1);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  } while(feed(serial_line_input_byte, encode_line, LINES, LINE_BUFSIZE / 2));
+  etimer_set(&et, 1);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  if(received != LINES || corrupt > 0) {
+    printf("ringbuf-test: FAIL, serial-line delivered %lu of %lu lines, %lu corrupt\n",
+           received, LINES, corrupt);
+    PROCESS_EXIT();
+  }
+  printf("ringbuf-test: serial-line OK, %lu lines\n", received);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(line_check_process, ev, data)
+{
+  uint16_t len;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == serial_line_event_message);
+    len = gen_line(rx_next++, expected);
+    if(len == strlen((char *)data) && memcmp(expected, data, len) == 0) {
+      received++;
+    } else {
+      corrupt++;
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
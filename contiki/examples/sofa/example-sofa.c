@@ -7,6 +7,7 @@
 #include "lib/print-stats.h"
 
 #include <stdio.h>
+#include <string.h>
 #define DEBUG 0
 #if DEBUG
 #define PRINTF(...) printf(__VA_ARGS__)
@@ -14,11 +15,32 @@
 #define PRINTF(...)
 #endif
 
+#ifndef MIN
+#define MIN(a, b) ((a) < (b)? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b)? (a) : (b))
+#endif
+
 // GLOBAL VARIABLES
 //  Timer
 static struct etimer et;
-// Gossip Values
-uint16_t received_value,node_value;
+// Gossip Values: all of them travel in a single SOFA exchange
+struct gossip_values {
+  uint16_t avg;
+  uint16_t min;
+  uint16_t max;
+};
+struct gossip_values node_values;
+// the values received during the current exchange, there may be several
+// responders: the averages are summed up until the exchange is over.
+// Each responder only averages with us, so with several responders the
+// sum of the averages changes at every exchange and the nodes converge
+// near the true mean, not to it. Only with one responder, the default of
+// SOFAMAC_CONF_MAX_RESPONDERS, is the sum kept, up to rounding.
+uint32_t received_sum;
+uint16_t received_min, received_max;
+uint8_t received;
 // Process definition
 PROCESS(sofa_process, "Sofa example process");
 AUTOSTART_PROCESSES(&sofa_process);
@@ -26,42 +48,73 @@ AUTOSTART_PROCESSES(&sofa_process);
 // FUNCTIONS DEFINITION
 
 // This function is called when a message is received
-static void sofa_rx(uint16_t rx_value){
-PRINTF("Received value %d\n",rx_value);
-received_value = rx_value;
+static void sofa_rx(const rimeaddr_t *from, const void *payload, uint8_t len){
+if(len != sizeof(struct gossip_values)) {
+  PRINTF("Unexpected payload length %u\n",len);
+  return;
+}
+struct gossip_values values;
+memcpy(&values, payload, len);
+if(received == 0) {
+  received_sum = 0;
+  received_min = values.min;
+  received_max = values.max;
+}
+received_sum += values.avg;
+received_min = MIN(received_min, values.min);
+received_max = MAX(received_max, values.max);
+received++;
+PRINTF("Received avg %u min %u max %u from %d.%d\n",values.avg,values.min,values.max,from->u8[0],from->u8[1]);
 }
 
-// This function is called when a message exchange terminates
-static void sofa_result(uint16_t ret_value){
+// This function is called when a message exchange terminates. The handle
+// is the one returned by sofamac_tx(), or SOFA_HANDLE_NONE when a neighbor
+// initiated the exchange
+static void sofa_result(sofa_handle_t handle, uint16_t ret_value){
 switch ( ret_value ) {
 case SOFA_SUCCESS:
+case SOFA_PARTIAL:
+  // the values of the responders that did not answer are simply left out
   PRINTF("SofaApp: Successful message exchange\n");
-  // since the data exchange was successful, we can aggregate the values (in this case, we average)
-  node_value = (node_value + received_value)/2;
-  printf("%d\n",node_value);
+  if(!received) {
+    break;
+  }
+  // since the data exchange was successful, we can aggregate the values (average, min and max)
+  node_values.avg = (node_values.avg + received_sum)/(received + 1);
+  node_values.min = MIN(node_values.min, received_min);
+  node_values.max = MAX(node_values.max, received_max);
+  received = 0;
+  printf("%u %u %u\n",node_values.avg,node_values.min,node_values.max);
   break;
 case SOFA_ERROR:
-  // since the data exchange was not successful, we clear the recevied value
-  received_value = 0;
+  // since the data exchange was not successful, we clear the recevied values
+  received = 0;
   PRINTF("SofaApp: Message exchange failed\n");
   break;
 case SOFA_BUSY:
   PRINTF("SofaApp: Message exchange rejected (busy channel)\n");
   break;
+case SOFA_NOACK:
+  PRINTF("SofaApp: No neighbor woke up during the strobe train\n");
+  break;
 default:
   PRINTF("SofaApp: Unexpected return value from sofa's exchange!! \n");
   break;
 }
 }
 
-// Get node's gossip value 
+// Get node's gossip values
 // This function can also be called by SOFA's pull mechanism
-static uint16_t get_tx_value(){
-return node_value;
+static uint8_t get_tx_values(void *payload, uint8_t maxlen){
+if(maxlen < sizeof(node_values)) {
+  return 0;
+}
+memcpy(payload, &node_values, sizeof(node_values));
+return sizeof(node_values);
 }
 
 // Register callbacks
-struct sofa_callback sofa_callbacks = {sofa_rx, get_tx_value, sofa_result};
+struct sofa_callback sofa_callbacks = {sofa_rx, get_tx_values, sofa_result};
 
 // Main process
 PROCESS_THREAD(sofa_process, ev, data)
@@ -69,15 +122,18 @@ PROCESS_THREAD(sofa_process, ev, data)
 
     PROCESS_BEGIN();
     sofa_register(&sofa_callbacks);
-    node_value = (rimeaddr_node_addr.u8[0])*10;
-    received_value =0;
+    node_values.avg = (rimeaddr_node_addr.u8[0])*10;
+    node_values.min = node_values.max = node_values.avg;
+    received = 0;
     while(1)
 	{
 	// wait for ~1.5 seconds
 	etimer_set(&et,CLOCK_SECOND+(random_rand()%CLOCK_SECOND));
 	PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
-	// try to send a packet
-	sofamac_tx(get_tx_value());
+	// try to send a packet, its payload is pulled when the exchange starts
+	if(sofamac_tx(NULL, 0) == SOFA_HANDLE_NONE) {
+	  PRINTF("SofaApp: exchange queue full\n");
+	}
 	}
     PROCESS_END();
     }
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Microbenchmark of the event timer backends: sets, moves and
+ *         dispatches many callback timers and reports how long it took
+ * \author
+ *         agent <agent@local>
+ */
+
+#include "contiki.h"
+#include "sys/ctimer.h"
+#include "lib/random.h"
+
+#include <stdio.h> /* For printf() */
+
+#ifdef TIMER_BENCHMARK_CONF_TIMERS
+#define TIMERS TIMER_BENCHMARK_CONF_TIMERS
+#else
+#define TIMERS 2000
+#endif
+
+/* Each test is repeated to measure more than a few clock ticks */
+#define ROUNDS 20
+/* Timers moved to a new expiration time, as connection timers are */
+#define MOVES (100 * TIMERS)
+
+static struct ctimer timers[TIMERS];
+static unsigned long fired;
+/*---------------------------------------------------------------------------*/
+PROCESS(timer_benchmark_process, "Timer benchmark process");
+AUTOSTART_PROCESSES(&timer_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static void
+callback(void *ptr)
+{
+  fired++;
+}
+/*---------------------------------------------------------------------------*/
+/* A timeout far enough for the timers not to expire during the test */
+static clock_time_t
+timeout(void)
+{
+  return 60 * CLOCK_SECOND + random_rand() % (60 * CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(const char *what, unsigned long n, const char *unit,
+       clock_time_t time)
+{
+  unsigned long ms = (time * 1000UL) / CLOCK_SECOND;
+
+  printf("%-10s %7lu %-6s %6lu ms %8.3f us each\n", what, n, unit, ms,
+         n > 0 ? 1000.0 * ms / n : 0.0);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(timer_benchmark_process, ev, data)
+{
+  static clock_time_t start, set_time, stop_time, expire_time;
+  static unsigned long i;
+  static int round;
+
+  PROCESS_BEGIN();
+
+  printf("%s backend, %u timers\n", ETIMER_HEAP ? "heap" : "list", TIMERS);
+
+  for(round = 0; round < ROUNDS; round++) {
+    start = clock_time();
+    for(i = 0; i < TIMERS; i++) {
+      ctimer_set(&timers[i], timeout(), callback, NULL);
+    }
+    set_time += clock_time() - start;
+
+    start = clock_time();
+    for(i = 0; i < TIMERS; i++) {
+      ctimer_stop(&timers[i]);
+    }
+    stop_time += clock_time() - start;
+  }
+  report("set", ROUNDS * TIMERS, "timers", set_time);
+  report("stop", ROUNDS * TIMERS, "timers", stop_time);
+
+  for(i = 0; i < TIMERS; i++) {
+    ctimer_set(&timers[i], timeout(), callback, NULL);
+  }
+  start = clock_time();
+  for(i = 0; i < MOVES; i++) {
+    ctimer_set(&timers[random_rand() % TIMERS], timeout(), callback, NULL);
+  }
+  report("move", MOVES, "timers", clock_time() - start);
+
+  /* Let the etimer process look at the pending timers */
+  start = clock_time();
+  for(i = 0; i < ROUNDS * 10; i++) {
+    etimer_request_poll();
+    PROCESS_PAUSE();
+  }
+  report("idle poll", ROUNDS * 10, "polls", clock_time() - start);
+
+  /* All timers expire at once and are dispatched */
+  fired = 0;
+  for(round = 0; round < ROUNDS / 4; round++) {
+    for(i = 0; i < TIMERS; i++) {
+      ctimer_set(&timers[i], 0, callback, NULL);
+    }
+    start = clock_time();
+    while(fired < (round + 1) * TIMERS) {
+      etimer_request_poll();
+      PROCESS_PAUSE();
+    }
+    expire_time += clock_time() - start;
+  }
+  report("expire", fired, "timers", expire_time);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -173,6 +173,10 @@ typedef unsigned short uip_stats_t;
 
 typedef unsigned long clock_time_t;
 #define CLOCK_CONF_SECOND 1000
+
+/* The native rtimer counts microseconds, see cpu/native/rtimer-arch.h */
+typedef uint32_t rtimer_clock_t;
+#define RTIMER_CLOCK_LT(a,b)     ((int32_t)((a)-(b)) < 0)
 #define INFINITE_TIME ULONG_MAX
 
 #define LOG_CONF_ENABLED 1
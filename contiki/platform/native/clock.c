@@ -39,27 +39,30 @@
 
 #include "sys/clock.h"
 #include <time.h>
-#include <sys/time.h>
 
+/*
+ * The monotonic clock does not jump when the wall clock is set, so
+ * timers neither fire early nor hang after an NTP step.
+ */
 /*---------------------------------------------------------------------------*/
 clock_time_t
 clock_time(void)
 {
-  struct timeval tv;
+  struct timespec ts;
 
-  gettimeofday(&tv, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &ts);
 
-  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  return ts.tv_sec * CLOCK_SECOND + ts.tv_nsec / (1000000000L / CLOCK_SECOND);
 }
 /*---------------------------------------------------------------------------*/
 unsigned long
 clock_seconds(void)
 {
-  struct timeval tv;
+  struct timespec ts;
 
-  gettimeofday(&tv, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &ts);
 
-  return tv.tv_sec;
+  return ts.tv_sec;
 }
 /*---------------------------------------------------------------------------*/
 void
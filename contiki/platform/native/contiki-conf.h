@@ -114,6 +114,10 @@ typedef unsigned short uip_stats_t;
 #define SICSLOWPAN_CONF_FRAG                    1
 #define SICSLOWPAN_CONF_MAXAGE                  8
 #endif /* SICSLOWPAN_CONF_FRAG */
+/* A border router reassembles datagrams from many nodes at once */
+#ifndef SICSLOWPAN_CONF_REASS_CONTEXTS
+#define SICSLOWPAN_CONF_REASS_CONTEXTS          16
+#endif /* SICSLOWPAN_CONF_REASS_CONTEXTS */
 #define SICSLOWPAN_CONF_CONVENTIONAL_MAC	1
 #define SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS       2
 #ifndef SICSLOWPAN_CONF_MAX_MAC_TRANSMISSIONS
@@ -136,6 +140,13 @@ typedef unsigned short uip_stats_t;
 #ifndef UIP_CONF_MAX_ROUTES
 #define UIP_CONF_MAX_ROUTES   30
 #endif /* UIP_CONF_MAX_ROUTES */
+/* A border router may be configured with thousands of both */
+#ifndef UIP_CONF_DS6_NBR_HASH
+#define UIP_CONF_DS6_NBR_HASH    32
+#endif /* UIP_CONF_DS6_NBR_HASH */
+#ifndef UIP_CONF_DS6_ROUTE_TRIE
+#define UIP_CONF_DS6_ROUTE_TRIE  1
+#endif /* UIP_CONF_DS6_ROUTE_TRIE */
 
 #define UIP_CONF_ND6_SEND_RA		0
 #define UIP_CONF_ND6_REACHABLE_TIME     600000
@@ -244,6 +255,32 @@ typedef unsigned long clock_time_t;
 
 #define CLOCK_CONF_SECOND 1000
 
+/* The native rtimer counts microseconds, see cpu/native/rtimer-arch.h */
+typedef uint32_t rtimer_clock_t;
+#define RTIMER_CLOCK_LT(a,b)     ((int32_t)((a)-(b)) < 0)
+
+/* Drive the rtimer with a timerfd watched by the main loop */
+#ifdef __linux__
+#ifndef RTIMER_ARCH_CONF_TIMERFD
+#define RTIMER_ARCH_CONF_TIMERFD 1
+#endif
+#endif /* __linux__ */
+
+/* Gateways run many timers, keep them in a heap */
+#ifndef ETIMER_CONF_HEAP
+#define ETIMER_CONF_HEAP 1
+#endif
+
+/* and large pools, allocate from free lists */
+#ifndef MEMB_CONF_FREELIST
+#define MEMB_CONF_FREELIST 1
+#endif
+
+/* and large managed memory, which is only compacted when idle */
+#ifndef MMEM_CONF_FREELIST
+#define MMEM_CONF_FREELIST 1
+#endif
+
 #define LOG_CONF_ENABLED 1
 
 #define PROGRAM_HANDLER_CONF_MAX_NUMDSCS 10
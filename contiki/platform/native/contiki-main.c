@@ -31,7 +31,10 @@
  *
  */
 
+#include <errno.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/select.h>
@@ -60,50 +63,158 @@
 
 #include "net/rime.h"
 
-#ifdef SELECT_CONF_MAX
-#define SELECT_MAX SELECT_CONF_MAX
+/*
+ * File descriptors are watched with epoll on Linux and with select()
+ * elsewhere. The epoll backend has no limit of its own, but the
+ * callbacks still describe their descriptors with fd_sets, so these
+ * have to stay below FD_SETSIZE.
+ */
+#ifdef SELECT_CONF_EPOLL
+#define SELECT_EPOLL SELECT_CONF_EPOLL
+#elif defined(__linux__)
+#define SELECT_EPOLL 1
 #else
-#define SELECT_MAX 8
+#define SELECT_EPOLL 0
 #endif
 
-static const struct select_callback *select_callback[SELECT_MAX];
-static int select_max = 0;
+#if SELECT_EPOLL
+#include <poll.h>
+#include <sys/epoll.h>
+#endif /* SELECT_EPOLL */
+
+/* Number of epoll events taken per wake-up, the others wait for the next */
+#ifdef SELECT_CONF_EVENTS
+#define SELECT_EVENTS SELECT_CONF_EVENTS
+#else
+#define SELECT_EVENTS 16
+#endif
+
+#define SELECT_READ  1
+#define SELECT_WRITE 2
+
+struct select_fd {
+  const struct select_callback *callback;
+  /* What set_fd() asked for in this round */
+  unsigned char want;
+  /* Readiness reported by epoll and not yet consumed by handle_fd() */
+  unsigned char ready;
+};
+
+/* Indexed by file descriptor, grown on demand */
+static struct select_fd *select_fds;
+static int select_size;
+static int select_max = -1;
+
+#if SELECT_EPOLL
+static int epoll_fd = -1;
+/* Descriptors handed to callbacks in this round, checked again afterwards */
+static struct pollfd *select_handled;
+#endif /* SELECT_EPOLL */
 
 SENSORS(&pir_sensor, &vib_sensor, &button_sensor);
 
 static uint8_t serial_id[] = {0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08};
 static uint16_t node_id = 0x0102;
 /*---------------------------------------------------------------------------*/
+static int
+select_grow(int fd)
+{
+  struct select_fd *fds;
+  int size;
+
+  size = select_size > 0 ? select_size : 8;
+  while(size <= fd) {
+    size *= 2;
+  }
+  fds = realloc(select_fds, size * sizeof(struct select_fd));
+  if(fds == NULL) {
+    return 0;
+  }
+  memset(&fds[select_size], 0, (size - select_size) * sizeof(struct select_fd));
+  select_fds = fds;
+#if SELECT_EPOLL
+  {
+    struct pollfd *handled;
+    handled = realloc(select_handled, size * sizeof(struct pollfd));
+    if(handled == NULL) {
+      return 0;
+    }
+    select_handled = handled;
+  }
+#endif /* SELECT_EPOLL */
+  select_size = size;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 int
 select_set_callback(int fd, const struct select_callback *callback)
 {
   int i;
-  if(fd >= 0 && fd < SELECT_MAX) {
-    /* Check that the callback functions are set */
-    if(callback != NULL &&
-       (callback->set_fd == NULL || callback->handle_fd == NULL)) {
-      callback = NULL;
-    }
 
-    select_callback[fd] = callback;
+  if(fd < 0 || fd >= FD_SETSIZE) {
+    return 0;
+  }
 
-    /* Update fd max */
-    if(callback != NULL) {
-      if(fd > select_max) {
-        select_max = fd;
-      }
-    } else {
-      select_max = 0;
-      for(i = SELECT_MAX - 1; i > 0; i--) {
-        if(select_callback[i] != NULL) {
-          select_max = i;
-          break;
-        }
+  /* Check that the callback functions are set */
+  if(callback != NULL &&
+     (callback->set_fd == NULL || callback->handle_fd == NULL)) {
+    callback = NULL;
+  }
+
+  if(fd >= select_size) {
+    if(callback == NULL) {
+      return 1;
+    }
+    if(!select_grow(fd)) {
+      return 0;
+    }
+  }
+
+#if SELECT_EPOLL
+  if(epoll_fd < 0) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(epoll_fd < 0) {
+      perror("epoll_create1");
+      return 0;
+    }
+  }
+  if(callback != NULL && select_fds[fd].callback == NULL) {
+    struct epoll_event ev;
+
+    /* Edge-triggered: the kernel reports each descriptor once per change
+       and the main loop keeps track of what is still ready */
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    ev.data.fd = fd;
+    select_fds[fd].ready = 0;
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      if(errno != EPERM) {
+        perror("epoll_ctl");
+        return 0;
       }
+      /* Regular files cannot be watched but never block either */
+      select_fds[fd].ready = SELECT_READ | SELECT_WRITE;
     }
-    return 1;
+  } else if(callback == NULL && select_fds[fd].callback != NULL) {
+    /* The descriptor may already be closed, which removed it */
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    select_fds[fd].ready = 0;
   }
-  return 0;
+#endif /* SELECT_EPOLL */
+
+  select_fds[fd].callback = callback;
+  select_fds[fd].want = 0;
+
+  /* Update fd max */
+  if(callback != NULL) {
+    if(fd > select_max) {
+      select_max = fd;
+    }
+  } else if(fd == select_max) {
+    for(i = fd - 1; i >= 0 && select_fds[i].callback == NULL; i--);
+    select_max = i;
+  }
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -154,6 +265,199 @@ set_rime_addr(void)
 }
 
 
+/*---------------------------------------------------------------------------*/
+/*
+ * How long select() may sleep: not at all when there is work left,
+ * until the next event timer otherwise. Without pending timers only
+ * the file descriptors, the rtimer included, wake us up.
+ */
+static struct timespec *
+select_timeout(int pending, struct timespec *ts)
+{
+  clock_time_t now, next;
+
+  if(pending) {
+    ts->tv_sec = 0;
+    ts->tv_nsec = 0;
+    return ts;
+  }
+  if(!etimer_pending()) {
+#if WITH_GUI
+    /* Look for console resizes every now and then */
+    ts->tv_sec = 1;
+    ts->tv_nsec = 0;
+    return ts;
+#else /* WITH_GUI */
+    return NULL;
+#endif /* WITH_GUI */
+  }
+  now = clock_time();
+  next = etimer_next_expiration_time();
+  if((long)(next - now) <= 0) {
+    next = now;
+  }
+  ts->tv_sec = (next - now) / CLOCK_SECOND;
+  ts->tv_nsec = ((next - now) % CLOCK_SECOND) * (1000000000L / CLOCK_SECOND);
+  return ts;
+}
+/*---------------------------------------------------------------------------*/
+#if SELECT_EPOLL
+/*
+ * Epoll only reports changes, so the readiness it reports is kept per
+ * descriptor until handle_fd() has had a go at it. Afterwards poll()
+ * tells whether the callback consumed everything or needs another round.
+ */
+static void
+select_wait(int pending, const sigset_t *mask)
+{
+  struct epoll_event events[SELECT_EVENTS];
+  struct timespec ts, *timeout;
+  fd_set fdr;
+  fd_set fdw;
+  int fd;
+  int i;
+  int n;
+  int handled;
+  int bits;
+
+  /* Ask the callbacks what they wait for */
+  for(fd = 0; fd <= select_max; fd++) {
+    if(select_fds[fd].callback == NULL) {
+      continue;
+    }
+    FD_ZERO(&fdr);
+    FD_ZERO(&fdw);
+    select_fds[fd].want = 0;
+    if(select_fds[fd].callback->set_fd(&fdr, &fdw)) {
+      if(FD_ISSET(fd, &fdr)) {
+        select_fds[fd].want |= SELECT_READ;
+      }
+      if(FD_ISSET(fd, &fdw)) {
+        select_fds[fd].want |= SELECT_WRITE;
+      }
+    }
+    if(select_fds[fd].want & select_fds[fd].ready) {
+      pending = 1;
+    }
+  }
+
+  timeout = select_timeout(pending, &ts);
+  n = epoll_pwait(epoll_fd, events, SELECT_EVENTS,
+                  timeout == NULL ? -1 : timeout->tv_sec * 1000 +
+                  (timeout->tv_nsec + 999999) / 1000000, mask);
+  if(n < 0) {
+    if(errno != EINTR) {
+      perror("epoll_pwait");
+    }
+    return;
+  }
+  for(i = 0; i < n; i++) {
+    fd = events[i].data.fd;
+    if(fd > select_max || select_fds[fd].callback == NULL) {
+      continue;
+    }
+    /* Errors and hang-ups are left to the callback's read() or write() */
+    if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+      select_fds[fd].ready |= SELECT_READ;
+    }
+    if(events[i].events & (EPOLLOUT | EPOLLERR)) {
+      select_fds[fd].ready |= SELECT_WRITE;
+    }
+  }
+
+  /* A callback may add or remove descriptors, so nothing is cached
+     across handle_fd() */
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  handled = 0;
+  for(fd = 0; fd <= select_max; fd++) {
+    if(select_fds[fd].callback == NULL) {
+      continue;
+    }
+    bits = select_fds[fd].want & select_fds[fd].ready;
+    if(bits == 0) {
+      continue;
+    }
+    if(bits & SELECT_READ) {
+      FD_SET(fd, &fdr);
+    }
+    if(bits & SELECT_WRITE) {
+      FD_SET(fd, &fdw);
+    }
+    select_fds[fd].callback->handle_fd(&fdr, &fdw);
+    FD_CLR(fd, &fdr);
+    FD_CLR(fd, &fdw);
+    select_handled[handled].fd = fd;
+    select_handled[handled].events = ((bits & SELECT_READ) ? POLLIN : 0) |
+      ((bits & SELECT_WRITE) ? POLLOUT : 0);
+    select_handled[handled].revents = 0;
+    handled++;
+  }
+
+  if(handled == 0) {
+    return;
+  }
+  if(poll(select_handled, handled, 0) < 0) {
+    for(i = 0; i < handled; i++) {
+      select_handled[i].revents = 0;
+    }
+  }
+  for(i = 0; i < handled; i++) {
+    fd = select_handled[i].fd;
+    if(fd > select_max || select_fds[fd].callback == NULL) {
+      continue;
+    }
+    if(select_handled[i].events & POLLIN) {
+      select_fds[fd].ready &= ~SELECT_READ;
+      if(select_handled[i].revents & (POLLIN | POLLERR | POLLHUP)) {
+        select_fds[fd].ready |= SELECT_READ;
+      }
+    }
+    if(select_handled[i].events & POLLOUT) {
+      select_fds[fd].ready &= ~SELECT_WRITE;
+      if(select_handled[i].revents & (POLLOUT | POLLERR)) {
+        select_fds[fd].ready |= SELECT_WRITE;
+      }
+    }
+  }
+}
+#else /* SELECT_EPOLL */
+static void
+select_wait(int pending, const sigset_t *mask)
+{
+  fd_set fdr;
+  fd_set fdw;
+  int maxfd;
+  int fd;
+  int retval;
+  struct timespec ts;
+
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  maxfd = 0;
+  for(fd = 0; fd <= select_max; fd++) {
+    if(select_fds[fd].callback != NULL &&
+       select_fds[fd].callback->set_fd(&fdr, &fdw)) {
+      maxfd = fd;
+    }
+  }
+
+  retval = pselect(maxfd + 1, &fdr, &fdw, NULL,
+                   select_timeout(pending, &ts), mask);
+  if(retval < 0) {
+    if(errno != EINTR) {
+      perror("select");
+    }
+  } else if(retval > 0) {
+    /* timeout => retval == 0 */
+    for(fd = 0; fd <= maxfd && fd <= select_max; fd++) {
+      if(select_fds[fd].callback != NULL) {
+        select_fds[fd].callback->handle_fd(&fdr, &fdw);
+      }
+    }
+  }
+}
+#endif /* SELECT_EPOLL */
 /*---------------------------------------------------------------------------*/
 int contiki_argc = 0;
 char **contiki_argv;
@@ -161,6 +465,8 @@ char **contiki_argv;
 int
 main(int argc, char **argv)
 {
+  sigset_t alarm_mask, wait_mask;
+
 #if UIP_CONF_IPV6
 #if UIP_CONF_IPV6_RPL
   printf(CONTIKI_VERSION_STRING " started with IPV6, RPL\n");
@@ -190,6 +496,7 @@ main(int argc, char **argv)
   process_init();
   process_start(&etimer_process, NULL);
   ctimer_init();
+  rtimer_init();
 
 #if WITH_GUI
   process_start(&ctk_process, NULL);
@@ -234,43 +541,27 @@ main(int argc, char **argv)
   /* Make standard output unbuffered. */
   setvbuf(stdout, (char *)NULL, _IONBF, 0);
 
+  /* Where the rtimer runs on SIGALRM, the signal is only taken while
+     waiting for file descriptors, so that a process it polls cannot be
+     missed right before we sleep */
+  sigemptyset(&alarm_mask);
+  sigaddset(&alarm_mask, SIGALRM);
+  sigprocmask(SIG_BLOCK, &alarm_mask, &wait_mask);
+  sigdelset(&wait_mask, SIGALRM);
+
   select_set_callback(STDIN_FILENO, &stdin_fd);
   while(1) {
-    fd_set fdr;
-    fd_set fdw;
-    int maxfd;
-    int i;
     int retval;
-    struct timeval tv;
 
     retval = process_run();
 
-    tv.tv_sec = 0;
-    tv.tv_usec = retval ? 1 : 1000;
+    select_wait(retval, &wait_mask);
 
-    FD_ZERO(&fdr);
-    FD_ZERO(&fdw);
-    maxfd = 0;
-    for(i = 0; i <= select_max; i++) {
-      if(select_callback[i] != NULL && select_callback[i]->set_fd(&fdr, &fdw)) {
-        maxfd = i;
-      }
-    }
-
-    retval = select(maxfd + 1, &fdr, &fdw, NULL, &tv);
-    if(retval < 0) {
-      perror("select");
-    } else if(retval > 0) {
-      /* timeout => retval == 0 */
-      for(i = 0; i <= maxfd; i++) {
-        if(select_callback[i] != NULL) {
-          select_callback[i]->handle_fd(&fdr, &fdw);
-        }
-      }
+    if(etimer_pending() &&
+       (long)(etimer_next_expiration_time() - clock_time()) <= 0) {
+      etimer_request_poll();
     }
 
-    etimer_request_poll();
-
 #if WITH_GUI
     if(console_resize()) {
        ctk_restore();
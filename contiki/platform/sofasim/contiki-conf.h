@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Configuration of the headless SOFA simulation platform
+ * \author
+ *         agent <agent@local>
+ */
+
+#ifndef __CONTIKI_CONF_H__
+#define __CONTIKI_CONF_H__
+
+#include <inttypes.h>
+
+#define PROFILE_CONF_ON 0
+#define ENERGEST_CONF_ON 0
+#define LOG_CONF_ENABLED 1
+
+/* Network stack, the application picks the RDC and MAC layers */
+#ifndef NETSTACK_CONF_NETWORK
+#define NETSTACK_CONF_NETWORK rime_driver
+#endif /* NETSTACK_CONF_NETWORK */
+#ifndef NETSTACK_CONF_MAC
+#define NETSTACK_CONF_MAC     nullmac_driver
+#endif /* NETSTACK_CONF_MAC */
+#ifndef NETSTACK_CONF_RDC
+#define NETSTACK_CONF_RDC     sofamac_driver
+#endif /* NETSTACK_CONF_RDC */
+#define NETSTACK_CONF_RADIO   sofasim_radio_driver
+#define NETSTACK_CONF_FRAMER  framer_802154
+
+/* The simulator reads the SOFA statistics of every node */
+#ifndef SOFAMAC_CONF_STATS
+#define SOFAMAC_CONF_STATS 1
+#endif /* SOFAMAC_CONF_STATS */
+
+#define PACKETBUF_CONF_ATTRS_INLINE 1
+#define QUEUEBUF_CONF_NUM 8
+
+#define CC_CONF_REGISTER_ARGS          1
+#define CC_CONF_FUNCTION_POINTER_ARGS  1
+#define CC_CONF_FASTCALL
+#define CC_CONF_VA_ARGS                1
+#define CC_CONF_INLINE inline
+
+#define CCIF
+#define CLIF
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int32_t s32_t;
+typedef unsigned short uip_stats_t;
+
+/* Same timer resolution as the Tmote Sky, rtimer_clock_t is 16 bits */
+#define CLOCK_CONF_SECOND 128L
+typedef unsigned long clock_time_t;
+
+#define UIP_CONF_LLH_LEN         0
+#define UIP_CONF_BUFFER_SIZE     140
+#define UIP_CONF_RECEIVE_WINDOW  48
+#define UIP_CONF_TCP_MSS         48
+#define UIP_CONF_MAX_CONNECTIONS 4
+#define UIP_CONF_MAX_LISTENPORTS 8
+#define UIP_CONF_UDP_CONNS       12
+#define UIP_CONF_FWCACHE_SIZE    30
+#define UIP_CONF_BROADCAST       1
+#define UIP_CONF_UDP             1
+#define UIP_CONF_UDP_CHECKSUMS   1
+#define UIP_CONF_LOGGING         0
+
+#define CFS_CONF_OFFSET_TYPE	long
+
+/* PROJECT_CONF_H might be defined in the project Makefile */
+#ifdef PROJECT_CONF_H
+#include PROJECT_CONF_H
+#endif /* PROJECT_CONF_H */
+
+#endif /* __CONTIKI_CONF_H__ */
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Node side of the headless SOFA simulation: boots Contiki and runs
+ *         it on behalf of the simulator
+ * \author
+ *         agent <agent@local>
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "contiki.h"
+#include "sys/autostart.h"
+#include "sys/node-id.h"
+#include "lib/random.h"
+#include "net/netstack.h"
+#include "net/rime.h"
+#include "dev/sofasim-radio.h"
+#include "sofasim.h"
+
+unsigned short node_id;
+
+/*---------------------------------------------------------------------------*/
+static void
+set_rime_addr(void)
+{
+  rimeaddr_t addr;
+
+  memset(&addr, 0, sizeof(rimeaddr_t));
+  addr.u8[0] = node_id & 0xff;
+  addr.u8[1] = node_id >> 8;
+  rimeaddr_set_node_addr(&addr);
+}
+/*---------------------------------------------------------------------------*/
+void
+sofasim_node_init(uint16_t id)
+{
+  node_id = id;
+  random_init(id);
+
+  process_init();
+  process_start(&etimer_process, NULL);
+  rtimer_init();
+  ctimer_init();
+
+  set_rime_addr();
+  queuebuf_init();
+  netstack_init();
+
+  autostart_start(autostart_processes);
+}
+/*---------------------------------------------------------------------------*/
+void
+sofasim_node_rtimer(void)
+{
+  rtimer_run_next();
+}
+/*---------------------------------------------------------------------------*/
+void
+sofasim_node_input(const void *payload, unsigned short len)
+{
+  sofasim_radio_input(payload, len);
+}
+/*---------------------------------------------------------------------------*/
+int
+sofasim_node_run(uint32_t *t)
+{
+  etimer_request_poll();
+  while(process_run() > 0);
+  if(etimer_pending()) {
+    *t = etimer_next_expiration_time();
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+node_id_restore(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+log_message(char *m1, char *m2)
+{
+  printf("%s%s\n", m1, m2);
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_log(char *m)
+{
+  printf("%s\n", m);
+}
+/*---------------------------------------------------------------------------*/
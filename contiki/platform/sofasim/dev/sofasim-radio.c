@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Radio of the headless SOFA simulation platform. Collisions,
+ *         losses and airtime are handled by the simulator.
+ * \author
+ *         agent <agent@local>
+ */
+
+#include <string.h>
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/netstack.h"
+#include "dev/sofasim-radio.h"
+#include "sofasim.h"
+
+static const void *pending_data;
+static unsigned short pending_len;
+
+static const void *tx_payload;
+static unsigned short tx_len;
+
+/*---------------------------------------------------------------------------*/
+static int
+init(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+prepare(const void *payload, unsigned short payload_len)
+{
+  tx_payload = payload;
+  tx_len = payload_len;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+transmit(unsigned short transmit_len)
+{
+  return sofasim_radio_send(tx_payload, transmit_len) ? RADIO_TX_OK : RADIO_TX_ERR;
+}
+/*---------------------------------------------------------------------------*/
+static int
+send(const void *payload, unsigned short payload_len)
+{
+  prepare(payload, payload_len);
+  return transmit(payload_len);
+}
+/*---------------------------------------------------------------------------*/
+static int
+read(void *buf, unsigned short buf_len)
+{
+  unsigned short len = pending_len;
+
+  if(pending_data == NULL || len > buf_len) {
+    return 0;
+  }
+  memcpy(buf, pending_data, len);
+  pending_data = NULL;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static int
+channel_clear(void)
+{
+  return !sofasim_radio_receiving();
+}
+/*---------------------------------------------------------------------------*/
+static int
+receiving_packet(void)
+{
+  return sofasim_radio_receiving();
+}
+/*---------------------------------------------------------------------------*/
+static int
+pending_packet(void)
+{
+  return pending_data != NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+on(void)
+{
+  sofasim_radio_on(1);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+off(void)
+{
+  sofasim_radio_on(0);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+sofasim_radio_input(const void *payload, unsigned short len)
+{
+  pending_data = payload;
+  pending_len = len;
+  packetbuf_clear();
+  len = read(packetbuf_dataptr(), PACKETBUF_SIZE);
+  if(len > 0) {
+    packetbuf_set_datalen(len);
+    NETSTACK_RDC.input();
+  }
+}
+/*---------------------------------------------------------------------------*/
+const struct radio_driver sofasim_radio_driver =
+  {
+    init,
+    prepare,
+    transmit,
+    send,
+    read,
+    channel_clear,
+    receiving_packet,
+    pending_packet,
+    on,
+    off,
+  };
+/*---------------------------------------------------------------------------*/
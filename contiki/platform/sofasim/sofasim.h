@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Interface between the nodes of the headless SOFA simulation
+ *         and the simulator (tools/sofasim) that runs them
+ * \author
+ *         agent <agent@local>
+ *
+ *         The application is built as a shared library that the simulator
+ *         loads once. The simulator keeps a copy of the writable memory of
+ *         the library for each virtual node and swaps it in before running
+ *         the node, much like COOJA does for its motes.
+ */
+
+#ifndef __SOFASIM_H__
+#define __SOFASIM_H__
+
+#include <stdint.h>
+
+/* Simulated time, in rtimer ticks */
+#define SOFASIM_SECOND 32768UL
+/* Ticks of simulated time per clock tick */
+#define SOFASIM_CLOCK_TICK (SOFASIM_SECOND / 128)
+
+/*
+ * Implemented by the simulator, called by the running node.
+ */
+
+/* Returns the simulated time. Each call costs one tick of CPU time so
+   that busy waits on the rtimer terminate. Otherwise the simulated time
+   stands still while a node runs: code that times itself, such as the
+   benchmarks in examples/, uses the processor time of the host, clock(). */
+uint32_t sofasim_rtimer_now(void);
+uint32_t sofasim_clock_time(void);
+void sofasim_rtimer_schedule(uint32_t t);
+
+/* Sends a frame, returns after its airtime has elapsed */
+int sofasim_radio_send(const void *payload, unsigned short len);
+void sofasim_radio_on(int on);
+int sofasim_radio_receiving(void);
+
+/* The printf() and rand() of the nodes are redirected to these */
+int sofasim_printf(const char *fmt, ...);
+int sofasim_puts(const char *s);
+int sofasim_putchar(int c);
+int sofasim_rand(void);
+void sofasim_srand(unsigned int seed);
+
+/*
+ * Implemented by the node, called by the simulator.
+ */
+
+/* Boots the node with the given id */
+void sofasim_node_init(uint16_t id);
+/* Runs the rtimer that expired */
+void sofasim_node_rtimer(void);
+/* Hands over a frame received by the radio */
+void sofasim_node_input(const void *payload, unsigned short len);
+/* Runs the processes that have something to do. Returns 1 and sets t to
+   the clock time of the next etimer, if any. */
+int sofasim_node_run(uint32_t *t);
+
+#endif /* __SOFASIM_H__ */
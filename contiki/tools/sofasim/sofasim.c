@@ -0,0 +1,753 @@
+/*
+ * Copyright (c) 2026, agent <agent@local>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Headless discrete-event simulator for SOFA. Runs many virtual
+ *         nodes of an application built with TARGET=sofasim in a single
+ *         process and reports convergence time, exchange rate and radio
+ *         duty cycle.
+ * \author
+ *         agent <agent@local>
+ *
+ *         The application is loaded once as a shared library. Each node
+ *         owns a copy of the writable segment of the library, which is
+ *         swapped in before the node runs. Nodes sit on a grid and hear
+ *         the nodes within the radio range. A frame is lost when two
+ *         frames overlap at a receiver, when the receiver transmits or
+ *         turns its radio off during the frame, or at random with the
+ *         configured loss rate.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <limits.h>
+#include <link.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "sofasim.h"
+#include "net/mac/sofamac.h"
+
+#define MAX_FRAME 128
+/* Bytes of preamble, SFD and length sent before each frame */
+#define PHY_OVERHEAD 6
+/* At 250 kbit/s a byte takes 32 us, about one tick */
+#define AIRTIME(len) ((len) + PHY_OVERHEAD)
+
+enum {
+  EV_BOOT,
+  EV_RTIMER,
+  EV_ETIMER,
+  EV_RX_END,
+  EV_SAMPLE,
+};
+
+struct event {
+  uint64_t time;
+  uint32_t seq;
+  uint32_t gen;
+  uint32_t node;
+  uint8_t type;
+};
+
+struct node {
+  uint16_t id;
+  uint8_t *image;
+  /* local time, never behind the events the node handles */
+  uint64_t now;
+  uint32_t rtimer_gen, etimer_gen, rx_gen;
+  uint32_t rng;
+
+  int radio_on;
+  uint64_t on_since, on_time;
+  uint64_t tx_until;
+  /* energy on the channel, sensed by channel_clear() */
+  uint64_t busy_from, busy_until;
+  /* frame being received */
+  int rx_active, rx_corrupt;
+  uint64_t rx_end;
+  unsigned short rx_len;
+  uint8_t rx_buf[MAX_FRAME];
+
+  uint32_t *neighbors;
+  int nneighbors;
+
+  /* last values reported by the application */
+  int reported;
+  unsigned avg, min, max;
+  char line[128];
+  int linelen;
+};
+
+static struct node *nodes;
+static int nnodes = 100;
+static struct node *cur, *loaded;
+
+static uint8_t *segment;
+static size_t segment_size;
+static uint8_t *pristine;
+static const char *library;
+
+static void (*node_init)(uint16_t id);
+static void (*node_rtimer)(void);
+static void (*node_input)(const void *payload, unsigned short len);
+static int (*node_run)(uint32_t *t);
+static uint8_t *stats_sym;
+
+static struct event *heap;
+static size_t heap_len, heap_size;
+static uint32_t seq;
+
+static uint64_t sim_now;
+static uint32_t global_rng = 1;
+static unsigned seed = 1;
+static double loss;
+static double range = 1.5;
+/* largest spread of the averages, in percent of max - min */
+static double tolerance = 10;
+static int stop_on_convergence;
+static int verbose;
+
+static int dirty;
+static uint64_t converged_at;
+static int converged;
+
+static unsigned long frames_sent, frames_delivered, frames_collided;
+static unsigned long frames_lost, frames_missed;
+static unsigned long events;
+
+/*---------------------------------------------------------------------------*/
+static uint32_t
+xorshift(uint32_t *s)
+{
+  uint32_t x = *s;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *s = x;
+}
+/*---------------------------------------------------------------------------*/
+static int
+heap_less(const struct event *a, const struct event *b)
+{
+  return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+/*---------------------------------------------------------------------------*/
+static void
+push(uint64_t time, struct node *n, uint8_t type, uint32_t gen)
+{
+  size_t i;
+  struct event e;
+
+  if(heap_len == heap_size) {
+    heap_size = heap_size ? heap_size * 2 : 1024;
+    heap = realloc(heap, heap_size * sizeof(struct event));
+    if(heap == NULL) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+  e.time = time;
+  e.seq = seq++;
+  e.gen = gen;
+  e.node = n != NULL ? n - nodes : 0;
+  e.type = type;
+  for(i = heap_len++; i > 0 && heap_less(&e, &heap[(i - 1) / 2]); i = (i - 1) / 2) {
+    heap[i] = heap[(i - 1) / 2];
+  }
+  heap[i] = e;
+}
+/*---------------------------------------------------------------------------*/
+static struct event
+pop(void)
+{
+  struct event top = heap[0];
+  struct event last = heap[--heap_len];
+  size_t i = 0, child;
+
+  while((child = 2 * i + 1) < heap_len) {
+    if(child + 1 < heap_len && heap_less(&heap[child + 1], &heap[child])) {
+      child++;
+    }
+    if(!heap_less(&heap[child], &last)) {
+      break;
+    }
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = last;
+  return top;
+}
+/*---------------------------------------------------------------------------*/
+/* Swaps the memory of the node in and makes it the running one */
+static void
+enter(struct node *n, uint64_t time)
+{
+  if(loaded != n) {
+    if(loaded != NULL) {
+      memcpy(loaded->image, segment, segment_size);
+    }
+    memcpy(segment, n->image, segment_size);
+    loaded = n;
+  }
+  if(n->now < time) {
+    n->now = time;
+  }
+  cur = n;
+}
+/*---------------------------------------------------------------------------*/
+/* Runs the pending processes and reschedules the next etimer */
+static void
+leave(void)
+{
+  uint32_t t;
+  uint64_t next;
+
+  if(node_run(&t)) {
+    next = (uint64_t)t * SOFASIM_CLOCK_TICK;
+    if(next < cur->now) {
+      next = cur->now;
+    }
+    push(next, cur, EV_ETIMER, ++cur->etimer_gen);
+  } else {
+    cur->etimer_gen++;
+  }
+  cur = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static const uint8_t *
+node_memory(struct node *n, const uint8_t *sym)
+{
+  return (n == loaded ? segment : n->image) + (sym - segment);
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+sofasim_rtimer_now(void)
+{
+  return (uint32_t)cur->now++;
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+sofasim_clock_time(void)
+{
+  return (uint32_t)(cur->now / SOFASIM_CLOCK_TICK);
+}
+/*---------------------------------------------------------------------------*/
+void
+sofasim_rtimer_schedule(uint32_t t)
+{
+  int32_t delta = (int32_t)(t - (uint32_t)cur->now);
+
+  push(delta > 0 ? cur->now + delta : cur->now, cur, EV_RTIMER,
+       ++cur->rtimer_gen);
+}
+/*---------------------------------------------------------------------------*/
+static void
+account_radio(struct node *n, uint64_t now)
+{
+  if(n->radio_on && now > n->on_since) {
+    n->on_time += now - n->on_since;
+  }
+  n->on_since = now;
+}
+/*---------------------------------------------------------------------------*/
+void
+sofasim_radio_on(int on)
+{
+  account_radio(cur, cur->now);
+  cur->radio_on = on;
+  if(!on && cur->rx_active) {
+    cur->rx_corrupt = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+sofasim_radio_receiving(void)
+{
+  return cur->radio_on && cur->busy_from <= cur->now &&
+    cur->now < cur->busy_until;
+}
+/*---------------------------------------------------------------------------*/
+int
+sofasim_radio_send(const void *payload, unsigned short len)
+{
+  struct node *n;
+  uint64_t start = cur->now;
+  uint64_t end = start + AIRTIME(len);
+  int i;
+
+  if(len > MAX_FRAME) {
+    return 0;
+  }
+  frames_sent++;
+  /* half duplex: what we were receiving is gone */
+  if(cur->rx_active) {
+    cur->rx_corrupt = 1;
+  }
+  for(i = 0; i < cur->nneighbors; i++) {
+    n = &nodes[cur->neighbors[i]];
+    if(n->busy_until <= start || n->busy_from > start) {
+      n->busy_from = start;
+    }
+    if(n->busy_until < end) {
+      n->busy_until = end;
+    }
+    if(!n->radio_on) {
+      continue;
+    }
+    if(n->tx_until > start) {
+      frames_missed++;
+      continue;
+    }
+    if(n->rx_active) {
+      /* overlapping frames corrupt each other */
+      if(!n->rx_corrupt) {
+        frames_collided++;
+      }
+      frames_collided++;
+      n->rx_corrupt = 1;
+      if(n->rx_end < end) {
+        n->rx_end = end;
+        push(end, n, EV_RX_END, ++n->rx_gen);
+      }
+      continue;
+    }
+    n->rx_active = 1;
+    n->rx_corrupt = 0;
+    n->rx_end = end;
+    n->rx_len = len;
+    memcpy(n->rx_buf, payload, len);
+    push(end, n, EV_RX_END, ++n->rx_gen);
+  }
+  cur->tx_until = end;
+  cur->now = end;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+output(const char *s, size_t len)
+{
+  struct node *n = cur;
+  unsigned avg, min, max;
+  char extra;
+
+  for(; len > 0; s++, len--) {
+    if(*s != '\n') {
+      if(n->linelen < (int)sizeof(n->line) - 1) {
+        n->line[n->linelen++] = *s;
+      }
+      continue;
+    }
+    n->line[n->linelen] = '\0';
+    n->linelen = 0;
+    if(verbose) {
+      printf("%.6f %u: %s\n", (double)n->now / SOFASIM_SECOND, n->id, n->line);
+    }
+    /* the application reports its gossip values as "avg min max" */
+    if(sscanf(n->line, "%u %u %u %c", &avg, &min, &max, &extra) == 3) {
+      n->reported = 1;
+      n->avg = avg;
+      n->min = min;
+      n->max = max;
+      dirty = 1;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+sofasim_printf(const char *fmt, ...)
+{
+  char buf[256];
+  va_list ap;
+  int len;
+
+  va_start(ap, fmt);
+  len = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if(len > 0) {
+    output(buf, len < (int)sizeof(buf) ? (size_t)len : sizeof(buf) - 1);
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+int
+sofasim_puts(const char *s)
+{
+  output(s, strlen(s));
+  output("\n", 1);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+sofasim_putchar(int c)
+{
+  char ch = c;
+
+  output(&ch, 1);
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+int
+sofasim_rand(void)
+{
+  return xorshift(&cur->rng) & RAND_MAX;
+}
+/*---------------------------------------------------------------------------*/
+void
+sofasim_srand(unsigned int s)
+{
+  cur->rng = (s * 2654435761u) ^ (seed * 40503u);
+  if(cur->rng == 0) {
+    cur->rng = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_convergence(void)
+{
+  unsigned lo, hi;
+  int i;
+
+  dirty = 0;
+  for(i = 0; i < nnodes; i++) {
+    if(!nodes[i].reported) {
+      return;
+    }
+  }
+  lo = hi = nodes[0].avg;
+  for(i = 1; i < nnodes; i++) {
+    if(nodes[i].min != nodes[0].min || nodes[i].max != nodes[0].max) {
+      return;
+    }
+    lo = nodes[i].avg < lo ? nodes[i].avg : lo;
+    hi = nodes[i].avg > hi ? nodes[i].avg : hi;
+  }
+  if(hi - lo <= tolerance / 100 * (nodes[0].max - nodes[0].min)) {
+    converged = 1;
+    converged_at = sim_now;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+find_segment(struct dl_phdr_info *info, size_t size, void *data)
+{
+  const void *sym = data;
+  uintptr_t start, end;
+  int i;
+
+  for(i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+
+    if(ph->p_type != PT_LOAD || !(ph->p_flags & PF_W)) {
+      continue;
+    }
+    start = info->dlpi_addr + ph->p_vaddr;
+    end = start + ph->p_memsz;
+    if((uintptr_t)sym >= start && (uintptr_t)sym < end) {
+      segment = (uint8_t *)start;
+      segment_size = ph->p_memsz;
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void *
+lookup(void *lib, const char *name, int required)
+{
+  void *sym = dlsym(lib, name);
+
+  if(sym == NULL && required) {
+    fprintf(stderr, "%s: %s not found\n", library, name);
+    exit(1);
+  }
+  return sym;
+}
+/*---------------------------------------------------------------------------*/
+static void
+load(void)
+{
+  char path[PATH_MAX];
+  void *lib;
+  void *node_id;
+
+  /* dlopen() looks up names without a slash in the library path */
+  snprintf(path, sizeof(path), "%s%s", strchr(library, '/') ? "" : "./",
+           library);
+  lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+
+  if(lib == NULL) {
+    fprintf(stderr, "%s\n", dlerror());
+    exit(1);
+  }
+  node_init = (void (*)(uint16_t))lookup(lib, "sofasim_node_init", 1);
+  node_rtimer = (void (*)(void))lookup(lib, "sofasim_node_rtimer", 1);
+  node_input = (void (*)(const void *, unsigned short))
+    lookup(lib, "sofasim_node_input", 1);
+  node_run = (int (*)(uint32_t *))lookup(lib, "sofasim_node_run", 1);
+  node_id = lookup(lib, "node_id", 1);
+  stats_sym = lookup(lib, "sofamac_stats", 0);
+
+  if(dl_iterate_phdr(find_segment, node_id) == 0) {
+    fprintf(stderr, "%s: no writable segment\n", library);
+    exit(1);
+  }
+  pristine = malloc(segment_size);
+  memcpy(pristine, segment, segment_size);
+}
+/*---------------------------------------------------------------------------*/
+static void
+setup(void)
+{
+  int side = (int)ceil(sqrt(nnodes));
+  int reach = (int)floor(range);
+  int i, x, y, dx, dy, j;
+  struct node *n;
+
+  nodes = calloc(nnodes, sizeof(struct node));
+  for(i = 0; i < nnodes; i++) {
+    n = &nodes[i];
+    n->id = i + 1;
+    n->image = malloc(segment_size);
+    memcpy(n->image, pristine, segment_size);
+    n->neighbors = malloc((2 * reach + 1) * (2 * reach + 1) * sizeof(uint32_t));
+    x = i % side;
+    y = i / side;
+    for(dy = -reach; dy <= reach; dy++) {
+      for(dx = -reach; dx <= reach; dx++) {
+        j = (y + dy) * side + x + dx;
+        if((dx == 0 && dy == 0) || x + dx < 0 || x + dx >= side ||
+           y + dy < 0 || j >= nnodes || dx * dx + dy * dy > range * range) {
+          continue;
+        }
+        n->neighbors[n->nneighbors++] = j;
+      }
+    }
+    /* boot at random times so that the nodes do not wake up together */
+    push(xorshift(&global_rng) % SOFASIM_SECOND, n, EV_BOOT, 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle(const struct event *e)
+{
+  struct node *n = &nodes[e->node];
+
+  switch(e->type) {
+  case EV_BOOT:
+    enter(n, e->time);
+    node_init(n->id);
+    leave();
+    break;
+  case EV_RTIMER:
+    if(e->gen != n->rtimer_gen) {
+      return;
+    }
+    enter(n, e->time);
+    node_rtimer();
+    leave();
+    break;
+  case EV_ETIMER:
+    if(e->gen != n->etimer_gen) {
+      return;
+    }
+    enter(n, e->time);
+    leave();
+    break;
+  case EV_RX_END:
+    if(e->gen != n->rx_gen) {
+      return;
+    }
+    n->rx_active = 0;
+    if(n->rx_corrupt || !n->radio_on) {
+      return;
+    }
+    if(loss > 0 && xorshift(&global_rng) < loss * 4294967296.0) {
+      frames_lost++;
+      return;
+    }
+    frames_delivered++;
+    enter(n, e->time);
+    node_input(n->rx_buf, n->rx_len);
+    leave();
+    break;
+  case EV_SAMPLE:
+    if(dirty && !converged) {
+      check_convergence();
+    }
+    push(e->time + SOFASIM_CLOCK_TICK, NULL, EV_SAMPLE, 0);
+    break;
+  }
+  events++;
+}
+/*---------------------------------------------------------------------------*/
+static double
+wall_time(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(double seconds, double wall)
+{
+  const struct sofamac_stats *st;
+  unsigned long exchanges = 0, success = 0, noack = 0, busy = 0;
+  unsigned long error = 0, strobes = 0;
+  uint64_t on_time = 0;
+  int i;
+
+  for(i = 0; i < nnodes; i++) {
+    account_radio(&nodes[i], sim_now);
+    on_time += nodes[i].on_time;
+    if(stats_sym != NULL) {
+      st = (const struct sofamac_stats *)node_memory(&nodes[i], stats_sym);
+      exchanges += st->exchanges;
+      success += st->success;
+      noack += st->noack;
+      busy += st->busy;
+      error += st->error;
+      strobes += st->strobes;
+    }
+  }
+
+  printf("nodes %d range %.2f loss %.2f seed %u time %.1f s\n",
+         nnodes, range, loss, seed, seconds);
+  if(converged) {
+    printf("convergence %.3f s\n", (double)converged_at / SOFASIM_SECOND);
+  } else {
+    printf("convergence none\n");
+  }
+  if(stats_sym != NULL) {
+    printf("exchanges %lu success %lu noack %lu busy %lu error %lu strobes %lu\n",
+           exchanges, success, noack, busy, error, strobes);
+    printf("exchanges/s %.2f (%.4f per node)\n", success / seconds,
+           success / seconds / nnodes);
+  } else {
+    printf("exchanges/s unknown, build with SOFAMAC_CONF_STATS\n");
+  }
+  printf("duty cycle %.3f %%\n",
+         100.0 * on_time / ((double)sim_now * nnodes));
+  printf("frames sent %lu delivered %lu collided %lu lost %lu missed %lu\n",
+         frames_sent, frames_delivered, frames_collided, frames_lost,
+         frames_missed);
+  printf("wall %.2f s, %.0f events/s, %.1fx real time\n",
+         wall, events / wall, seconds / wall);
+}
+/*---------------------------------------------------------------------------*/
+static void
+usage(const char *prog)
+{
+  fprintf(stderr, "usage: %s [-n nodes] [-t seconds] [-r range] [-l loss]"
+          " [-s seed] [-c percent] [-x] [-v] app.sofasim\n", prog);
+  exit(1);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  double seconds = 60, start;
+  uint64_t end;
+  struct event e;
+  int c;
+
+  while((c = getopt(argc, argv, "n:t:r:l:s:c:xv")) != -1) {
+    switch(c) {
+    case 'n':
+      nnodes = atoi(optarg);
+      break;
+    case 't':
+      seconds = atof(optarg);
+      break;
+    case 'r':
+      range = atof(optarg);
+      break;
+    case 'l':
+      loss = atof(optarg);
+      break;
+    case 's':
+      seed = strtoul(optarg, NULL, 0);
+      break;
+    case 'c':
+      tolerance = atof(optarg);
+      break;
+    case 'x':
+      stop_on_convergence = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if(optind != argc - 1 || nnodes < 1 || nnodes > 65534 || seconds <= 0 ||
+     range < 1 || loss < 0 || loss > 1 || tolerance < 0) {
+    usage(argv[0]);
+  }
+  library = argv[optind];
+  global_rng = seed * 2654435761u;
+  if(global_rng == 0) {
+    global_rng = 1;
+  }
+
+  load();
+  setup();
+  push(SOFASIM_CLOCK_TICK, NULL, EV_SAMPLE, 0);
+
+  start = wall_time();
+  end = (uint64_t)(seconds * SOFASIM_SECOND);
+  while(heap_len > 0 && heap[0].time < end) {
+    e = pop();
+    sim_now = e.time;
+    handle(&e);
+    if(converged && stop_on_convergence) {
+      break;
+    }
+  }
+  if(!converged || !stop_on_convergence) {
+    sim_now = end;
+  }
+  report((double)sim_now / SOFASIM_SECOND, wall_time() - start);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/